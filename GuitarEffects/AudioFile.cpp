@@ -0,0 +1,368 @@
+#include "AudioFile.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const uint16_t kWavePcm = 1;
+const uint16_t kWaveFloat = 3;
+const uint16_t kWaveExtensible = 0xFFFE;
+
+uint16_t Read16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t Read32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void Put16(uint8_t* p, uint16_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+void Put32(uint8_t* p, uint32_t value) {
+    for (int i = 0; i < 4; ++i) p[i] = (uint8_t)(value >> (8 * i));
+}
+
+void Put64(uint8_t* p, uint64_t value) {
+    for (int i = 0; i < 8; ++i) p[i] = (uint8_t)(value >> (8 * i));
+}
+
+uint64_t Read64(const uint8_t* p) {
+    return (uint64_t)Read32(p) | ((uint64_t)Read32(p + 4) << 32);
+}
+
+// RF64 keeps the real sizes in a ds64 chunk: RIFF size, data size, sample
+// count and an empty table
+const uint32_t kDs64Bytes = 28;
+const uint32_t kSizeInDs64 = 0xFFFFFFFFu;
+
+// WAVE_FORMAT_EXTENSIBLE where the format needs it: more than two channels,
+// or PCM deeper than 16 bits (the only way to say 24 valid bits in 32)
+bool UseExtensible(int channels, SampleFormat format) {
+    return channels > 2 || (format != SampleFormat::Float32 && format != SampleFormat::Int16);
+}
+
+// RIFF, JUNK (the ds64 placeholder), fmt (16 or 40 bytes), fact, data.
+// Either way the samples start 4-byte aligned, so a reader can use float
+// data in place.
+size_t HeaderBytes(int channels, SampleFormat format) {
+    return 12 + (8 + kDs64Bytes) + (8 + (UseExtensible(channels, format) ? 40 : 16)) + 12 + 8;
+}
+
+void BuildHeader(std::vector<uint8_t>& header, float sampleRate, int channels, SampleFormat format,
+    uint64_t dataBytes) {
+    const bool extensible = UseExtensible(channels, format);
+    header.assign(HeaderBytes(channels, format), 0);
+    const uint16_t bytes = (uint16_t)SampleFormatBytes(format);
+    const uint32_t blockAlign = bytes * channels;
+    const uint32_t rate = (uint32_t)(sampleRate + 0.5f);
+    const uint64_t frames = dataBytes / blockAlign;
+    const uint64_t riffBytes = header.size() - 8 + dataBytes + (dataBytes & 1);
+    const bool rf64 = riffBytes > 0xFFFFFFFFull;
+
+    uint8_t* p = header.data();
+    memcpy(p, rf64 ? "RF64" : "RIFF", 4);
+    Put32(p + 4, rf64 ? kSizeInDs64 : (uint32_t)riffBytes);
+    memcpy(p + 8, "WAVE", 4);
+    p += 12;
+    memcpy(p, rf64 ? "ds64" : "JUNK", 4);
+    Put32(p + 4, kDs64Bytes);
+    if (rf64) {
+        Put64(p + 8, riffBytes);
+        Put64(p + 16, dataBytes);
+        Put64(p + 24, frames);
+    }
+    p += 8 + kDs64Bytes;
+
+    const uint16_t tag = (format == SampleFormat::Float32) ? kWaveFloat : kWavePcm;
+    memcpy(p, "fmt ", 4);
+    Put32(p + 4, extensible ? 40 : 16);
+    Put16(p + 8, extensible ? kWaveExtensible : tag);
+    Put16(p + 10, (uint16_t)channels);
+    Put32(p + 12, rate);
+    Put32(p + 16, rate * blockAlign);
+    Put16(p + 20, (uint16_t)blockAlign);
+    Put16(p + 22, (uint16_t)(bytes * 8));
+    if (extensible) {
+        // cbSize, valid bits, speaker mask, then the SubFormat GUID: the
+        // format tag followed by the fixed KSDATAFORMAT_SUBTYPE suffix
+        static const uint8_t kGuidSuffix[14] = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00,
+            0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+        Put16(p + 24, 22);
+        Put16(p + 26, (uint16_t)(format == SampleFormat::Int24In32 ? 24 : bytes * 8));
+        Put32(p + 28, channels == 1 ? 0x4 : (channels == 2 ? 0x3 : 0));
+        Put16(p + 32, tag);
+        memcpy(p + 34, kGuidSuffix, sizeof(kGuidSuffix));
+    }
+    p += 8 + (extensible ? 40 : 16);
+
+    memcpy(p, "fact", 4);
+    Put32(p + 4, 4);
+    Put32(p + 8, rf64 ? kSizeInDs64 : (uint32_t)frames);
+    p += 12;
+    memcpy(p, "data", 4);
+    Put32(p + 4, rf64 ? kSizeInDs64 : (uint32_t)dataBytes);
+}
+
+} // namespace
+
+MappedFile::MappedFile() : data(nullptr), size(0), mapping(nullptr) {
+}
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+bool MappedFile::Open(const char* path) {
+    Close();
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(handle);
+        return false;
+    }
+    HANDLE map = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);  // the mapping keeps the file open
+    if (!map) return false;
+    const void* view = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(map);
+        return false;
+    }
+    mapping = map;
+    size = (uint64_t)fileSize.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+    // Read front to back: let the kernel read ahead aggressively
+    madvise(view, (size_t)info.st_size, MADV_SEQUENTIAL);
+    size = (uint64_t)info.st_size;
+#endif
+    data = (const uint8_t*)view;
+    return true;
+}
+
+void MappedFile::Close() {
+    if (!data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle((HANDLE)mapping);
+#else
+    munmap((void*)data, (size_t)size);
+#endif
+    data = nullptr;
+    size = 0;
+    mapping = nullptr;
+}
+
+bool WavReader::Open(const char* path) {
+    format = SampleFormat::Unknown;
+    if (!file.Open(path)) return false;
+    const uint8_t* base = file.Data();
+    const uint64_t size = file.Size();
+    if (size < 12 || memcmp(base + 8, "WAVE", 4) != 0) return false;
+    const bool rf64 = memcmp(base, "RF64", 4) == 0 || memcmp(base, "BW64", 4) == 0;
+    if (!rf64 && memcmp(base, "RIFF", 4) != 0) return false;
+
+    bool haveFormat = false;
+    uint64_t dataOffset = 0, dataBytes = 0, ds64DataBytes = 0;
+    int blockAlign = 0;
+    for (uint64_t offset = 12; offset + 8 <= size;) {
+        const uint8_t* chunk = base + offset;
+        uint64_t bytes = Read32(chunk + 4);
+        const uint64_t available = size - offset - 8;
+        if (memcmp(chunk, "ds64", 4) == 0 && bytes >= 24 && bytes <= available) {
+            ds64DataBytes = Read64(chunk + 16);
+        }
+        else if (memcmp(chunk, "fmt ", 4) == 0 && bytes >= 16 && bytes <= available) {
+            uint16_t tag = Read16(chunk + 8);
+            channels = Read16(chunk + 10);
+            sampleRate = (float)Read32(chunk + 12);
+            blockAlign = Read16(chunk + 20);
+            int containerBits = Read16(chunk + 22);
+            int validBits = containerBits;
+            if (tag == kWaveExtensible && bytes >= 40) {
+                validBits = Read16(chunk + 26);
+                tag = Read16(chunk + 32);  // first two bytes of the SubFormat GUID
+            }
+            format = ResolveSampleFormat(tag == kWaveFloat, tag == kWavePcm, containerBits, validBits);
+            haveFormat = true;
+        }
+        else if (memcmp(chunk, "data", 4) == 0) {
+            if (rf64 && bytes == kSizeInDs64) bytes = ds64DataBytes;
+            dataOffset = offset + 8;
+            // Writers that never patched the size leave it 0 or too large
+            dataBytes = (bytes == 0 || bytes > available) ? available : bytes;
+        }
+        offset += 8 + bytes + (bytes & 1);  // chunks are word aligned
+    }
+    if (!haveFormat || format == SampleFormat::Unknown || channels <= 0 || dataOffset == 0 ||
+        blockAlign != SampleFormatBytes(format) * channels) {
+        format = SampleFormat::Unknown;
+        return false;
+    }
+    samples = base + dataOffset;
+    frames = dataBytes / blockAlign;
+    return true;
+}
+
+void WavReader::Read(uint64_t frame, uint32_t count, float* out) const {
+    uint32_t valid = 0;
+    if (frame < frames) valid = (frames - frame < count) ? (uint32_t)(frames - frame) : count;
+    if (valid > 0) {
+        const size_t frameBytes = (size_t)SampleFormatBytes(format) * channels;
+        ConvertToFloat(format, samples + frame * frameBytes, out, (size_t)valid * channels);
+    }
+    if (valid < count) memset(out + (size_t)valid * channels, 0, (size_t)(count - valid) * channels * sizeof(float));
+}
+
+const float* WavReader::View(uint64_t frame, uint32_t count, float* scratch) const {
+    const float* all = FloatSamples();
+    if (all && frame <= frames && count <= frames - frame) return all + frame * channels;
+    Read(frame, count, scratch);
+    return scratch;
+}
+
+const float* WavReader::FloatSamples() const {
+    if (format != SampleFormat::Float32 || ((uintptr_t)samples & (alignof(float) - 1)) != 0) return nullptr;
+    return (const float*)samples;
+}
+
+WavWriter::WavWriter() : file(nullptr), sampleRate(0.0f), channels(0), format(SampleFormat::Float32),
+dataBytes(0), active(0), filled(0), writing(0), writingBytes(0), failed(false),
+stopping(false) {
+}
+
+WavWriter::~WavWriter() {
+    Close();
+}
+
+bool WavWriter::Create(const char* path, float rate, int numChannels, SampleFormat sampleFormat) {
+    Close();
+    if (numChannels <= 0 || SampleFormatBytes(sampleFormat) == 0) return false;
+    file = fopen(path, "wb");
+    if (!file) return false;
+    // Everything goes out in whole buffers; stdio buffering would only copy
+    setvbuf(file, nullptr, _IONBF, 0);
+    sampleRate = rate;
+    channels = numChannels;
+    format = sampleFormat;
+    dataBytes = 0;
+    const size_t frameBytes = (size_t)SampleFormatBytes(format) * channels;
+    for (std::vector<uint8_t>& buffer : buffers) buffer.resize(kBufferBytes / frameBytes * frameBytes);
+    active = 0;
+    filled = 0;
+    writingBytes = 0;
+    failed = false;
+    stopping = false;
+
+    // Rewritten with the real sizes by Close()
+    std::vector<uint8_t> header;
+    BuildHeader(header, sampleRate, channels, format, 0);
+    if (fwrite(header.data(), 1, header.size(), file) != header.size()) {
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+    worker = std::thread(&WavWriter::Run, this);
+    return true;
+}
+
+bool WavWriter::Write(const float* interleaved, uint32_t frames) {
+    if (!file) return false;
+    const size_t frameBytes = (size_t)SampleFormatBytes(format) * channels;
+    const size_t capacity = buffers[0].size();
+    for (uint32_t done = 0; done < frames;) {
+        const uint32_t count = (uint32_t)std::min<size_t>((capacity - filled) / frameBytes, frames - done);
+        const float* src = interleaved + (size_t)done * channels;
+        uint8_t* dst = buffers[active].data() + filled;
+        if (format == SampleFormat::Float32) memcpy(dst, src, count * frameBytes);
+        else ConvertFromFloat(format, src, dst, (size_t)count * channels, &dither);
+        filled += count * frameBytes;
+        done += count;
+        if (filled == capacity && !Flush()) return false;
+    }
+    dataBytes += (uint64_t)frameBytes * frames;
+    std::lock_guard<std::mutex> lock(mutex);
+    return !failed;
+}
+
+// Hands the filled buffer to the writer thread, once it is done with the other
+bool WavWriter::Flush() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] { return writingBytes == 0; });
+        if (failed) return false;
+        writing = active;
+        writingBytes = filled;
+    }
+    wake.notify_all();
+    active ^= 1;
+    filled = 0;
+    return true;
+}
+
+void WavWriter::Run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return writingBytes > 0 || stopping; });
+        if (writingBytes == 0) return;
+        const std::vector<uint8_t>& buffer = buffers[writing];
+        const size_t bytes = writingBytes;
+        lock.unlock();
+        const bool ok = fwrite(buffer.data(), 1, bytes, file) == bytes;
+        lock.lock();
+        if (!ok) failed = true;
+        writingBytes = 0;
+        wake.notify_all();
+    }
+}
+
+bool WavWriter::Close() {
+    if (!file) return false;
+    bool ok = filled == 0 || Flush();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] { return writingBytes == 0; });
+        stopping = true;
+        ok = ok && !failed;
+    }
+    wake.notify_all();
+    worker.join();
+    if (ok && (dataBytes & 1)) {
+        // A word-aligned data chunk needs a pad byte at the end
+        const uint8_t pad = 0;
+        ok = fwrite(&pad, 1, 1, file) == 1;
+    }
+    if (ok) {
+        std::vector<uint8_t> header;
+        BuildHeader(header, sampleRate, channels, format, dataBytes);
+        // Same size as the placeholder; past 4 GB the JUNK chunk becomes ds64
+        ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(header.data(), 1, header.size(), file) == header.size();
+    }
+    ok = fclose(file) == 0 && ok;
+    file = nullptr;
+    return ok;
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "SampleFormat.h"
+
+// Streaming WAV and RF64 (the 64-bit WAV for files over 4 GB) for the
+// offline tools. Portable: memory mapping through Win32 file mappings or
+// POSIX mmap, writes through stdio.
+
+// A whole file mapped read-only
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool Open(const char* path);
+    void Close();
+    const uint8_t* Data() const { return data; }
+    uint64_t Size() const { return size; }
+
+private:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data;
+    uint64_t size;
+    void* mapping;  // Windows mapping handle
+};
+
+// Reads WAV, RF64 and BW64 with PCM (16, 24, 32 bit, 24-in-32) or float32
+// samples, including WAVE_FORMAT_EXTENSIBLE. The data chunk is used in place
+// in the mapping: pages come in as they are read, nothing is copied up front.
+// Const members are safe to call from several threads at once.
+class WavReader {
+public:
+    bool Open(const char* path);
+    void Close() { file.Close(); }
+
+    int Channels() const { return channels; }
+    float SampleRate() const { return sampleRate; }
+    uint64_t Frames() const { return frames; }
+    SampleFormat Format() const { return format; }
+
+    // Frames [frame, frame + count) as interleaved float; past the end reads
+    // as silence
+    void Read(uint64_t frame, uint32_t count, float* out) const;
+    // The same frames without a copy where possible: float32 data is
+    // returned straight from the mapping, anything else is converted into
+    // scratch (count * Channels() floats), which is then returned
+    const float* View(uint64_t frame, uint32_t count, float* scratch) const;
+    // All of the samples in place, if they are float32 (and 4-byte aligned,
+    // as some writers leave them unaligned); nullptr otherwise
+    const float* FloatSamples() const;
+
+private:
+    MappedFile file;
+    const uint8_t* samples = nullptr;
+    uint64_t frames = 0;
+    int channels = 0;
+    float sampleRate = 0.0f;
+    SampleFormat format = SampleFormat::Unknown;
+};
+
+// Writes WAV, switching to RF64 on Close() if the file went past 4 GB.
+// Float32 output is WAVE_FORMAT_IEEE_FLOAT; 16- and 24-bit output is TPDF
+// dithered. Samples are converted into one of two large buffers while a
+// background thread writes out the other, so the caller only waits for the
+// disk when it is the bottleneck.
+class WavWriter {
+public:
+    WavWriter();
+    ~WavWriter();
+
+    bool Create(const char* path, float sampleRate, int channels, SampleFormat format = SampleFormat::Float32);
+    bool Write(const float* interleaved, uint32_t frames);
+    // Writes out the rest and fills in the sizes; false if anything failed
+    bool Close();
+
+private:
+    WavWriter(const WavWriter&) = delete;
+    WavWriter& operator=(const WavWriter&) = delete;
+
+    static const size_t kBufferBytes = 4 << 20;
+
+    bool Flush();
+    void Run();
+
+    FILE* file;
+    float sampleRate;
+    int channels;
+    SampleFormat format;
+    uint64_t dataBytes;
+    TpdfDither dither;
+
+    // Caller side
+    std::vector<uint8_t> buffers[2];
+    int active;         // buffer being filled
+    size_t filled;      // bytes in it
+
+    // Shared with the writer thread, under mutex
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    int writing;            // buffer being written out
+    size_t writingBytes;    // bytes of it still to write; 0 when idle
+    bool failed;
+    bool stopping;
+};
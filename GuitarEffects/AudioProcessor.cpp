@@ -1,4 +1,6 @@
 #include "AudioProcessor.h"
+#include "Logger.h"
+#include "Trace.h"
 #include <cmath>
 #include <thread>
 #include <vector>
@@ -6,12 +8,6 @@
 #include <atomic>
 #include <chrono>
 #include <comdef.h>
-#include <iostream>
-
-// Constants
-const float PI = 3.14159265358979323846f;
-const float WAH_FREQ_MIN = 200.0f;   // Minimum wah frequency
-const float WAH_FREQ_MAX = 3000.0f;  // Maximum wah frequency
 
 // Add COM GUIDs used for device activation (define if not present)
 const CLSID CLSID_MMDeviceEnumerator = { 0xbcde0395, 0xe52f, 0x467c, {0x8e, 0x3d, 0xc4, 0x57, 0x92, 0x91, 0x69, 0x2e} };
@@ -19,24 +15,71 @@ const IID IID_IMMDeviceEnumerator = { 0xa95664d2, 0x9614, 0x4f35, {0xa7, 0x46, 0
 const IID IID_IAudioClient = { 0x1cb9ad4c, 0xdbfa, 0x4c32, {0xb1, 0x78, 0xc2, 0xf5, 0x68, 0xa7, 0x03, 0xb2} };
 const IID IID_IAudioCaptureClient = { 0xc8adbd64, 0xe71e, 0x48a0, {0xa4, 0xde, 0x18, 0x5c, 0x39, 0x5c, 0xd3, 0x17} };
 const IID IID_IAudioRenderClient = { 0xf294acfc, 0x3146, 0x4483, {0xa7, 0xbf, 0xad, 0xdc, 0xa7, 0xc2, 0x60, 0xe2} };
+const IID IID_IAudioClient3 = { 0x7ed4ee07, 0x8e67, 0x4cd4, {0x8c, 0x1a, 0x2b, 0x7a, 0x59, 0x87, 0xad, 0x42} };
+// WAVEFORMATEXTENSIBLE subformats (KSDATAFORMAT_SUBTYPE_PCM / _IEEE_FLOAT)
+static const GUID kSubtypePcm = { 0x00000001, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71} };
+static const GUID kSubtypeFloat = { 0x00000003, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71} };
+
+// The loop polls every millisecond, so device periods shorter than this glitch
+static const float kMinStablePeriodMs = 2.0f;
+
+// Live stats are published this often; short enough for a dashboard,
+// long enough that peak and RMS mean something
+static const uint64_t kStatsWindowNs = 250000000;
+
+static void AccumulateLevels(const float* data, size_t samples, float& peak, double& squares) {
+    for (size_t i = 0; i < samples; ++i) {
+        const float magnitude = fabsf(data[i]);
+        if (magnitude > peak) peak = magnitude;
+        squares += (double)data[i] * data[i];
+    }
+}
+
+// Shared-mode mix formats are usually WAVEFORMATEXTENSIBLE, where the tag
+// only says "extensible" and the real type and valid bits are in the extension
+static SampleFormat DetectSampleFormat(const WAVEFORMATEX* format) {
+    bool isFloat = format->wFormatTag == WAVE_FORMAT_IEEE_FLOAT;
+    bool isPcm = format->wFormatTag == WAVE_FORMAT_PCM;
+    int validBits = format->wBitsPerSample;
+    if (format->wFormatTag == WAVE_FORMAT_EXTENSIBLE &&
+        format->cbSize >= sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX)) {
+        const WAVEFORMATEXTENSIBLE* ext = (const WAVEFORMATEXTENSIBLE*)format;
+        isFloat = IsEqualGUID(ext->SubFormat, kSubtypeFloat) != 0;
+        isPcm = IsEqualGUID(ext->SubFormat, kSubtypePcm) != 0;
+        validBits = ext->Samples.wValidBitsPerSample;
+    }
+    return ResolveSampleFormat(isFloat, isPcm, format->wBitsPerSample, validBits);
+}
 
 AudioProcessor::AudioProcessor() : deviceEnumerator(NULL), captureDevice(NULL),
 renderDevice(NULL), captureClient(NULL),
 renderClient(NULL), captureInterface(NULL),
 renderInterface(NULL), captureFormat(NULL),
 renderFormat(NULL), running(false),
-tremoloEnabled(false), tremoloRate(5.0f),
-tremoloDepth(0.5f), tremoloPhase(0.0f), sampleRate(44100),
+sampleRate(44100), mainVolume(1.0f),
+captureSampleFormat(SampleFormat::Unknown), renderSampleFormat(SampleFormat::Unknown),
+resamplerQuality(Resampler::Quality::Medium), driftCompensation(true), bridged(false),
+captureStreamMs(0.0), renderStreamMs(0.0), devicePeriodMs(0.0), renderQueuedFrames(0),
+targetLatencyMs(10.0f), renderDepthFrames(0), statsGlitches(0), statsLatencyMs(0.0),
 captureBufferFrames(0), renderBufferFrames(0) {
+    // Manual reset: stays signalled until the next StartProcessing
+    stopEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
 }
 
 AudioProcessor::~AudioProcessor() {
     Cleanup();
+    if (stopEvent) CloseHandle(stopEvent);
 }
 
 HRESULT AudioProcessor::Initialize() {
     HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
     if (FAILED(hr)) return hr;
+    // Best effort: the buffers are locked one by one as they're prepared
+    LockProcessMemory();
+    // Also best effort; without it the engine just isn't monitorable
+    if (!statsPublisher.IsOpen() && !statsPublisher.Open(kStatsSegmentName)) {
+        LOG_WARNING(LogEvent::StatsSegmentUnavailable);
+    }
     hr = CoCreateInstance(CLSID_MMDeviceEnumerator, NULL,
         CLSCTX_ALL, IID_IMMDeviceEnumerator,
         (void**)&deviceEnumerator);
@@ -102,14 +145,45 @@ HRESULT AudioProcessor::SetupAudio(const std::wstring& captureDeviceId) {
     hr = renderClient->GetMixFormat(&renderFormat); // use renderClient (IAudioClient) instead of IMMDevice
     if (FAILED(hr) || !renderFormat) return hr;
     sampleRate = static_cast<float>(captureFormat->nSamplesPerSec);
-    hr = captureClient->Initialize(AUDCLNT_SHAREMODE_SHARED, 0, 10000000, 0, captureFormat, NULL);
+    UINT32 capturePeriod = 0, renderPeriod = 0;
+    hr = InitializeStream(captureClient, captureFormat, capturePeriod);
     if (FAILED(hr)) return hr;
-    hr = renderClient->Initialize(AUDCLNT_SHAREMODE_SHARED, 0, 10000000, 0, renderFormat, NULL);
+    hr = InitializeStream(renderClient, renderFormat, renderPeriod);
     if (FAILED(hr)) return hr;
     hr = captureClient->GetBufferSize(&captureBufferFrames);
     if (FAILED(hr)) return hr;
     hr = renderClient->GetBufferSize(&renderBufferFrames);
     if (FAILED(hr)) return hr;
+    // A capture packet never exceeds the capture buffer
+    engine.Prepare(sampleRate, captureBufferFrames, captureFormat->nChannels);
+    captureSampleFormat = DetectSampleFormat(captureFormat);
+    renderSampleFormat = DetectSampleFormat(renderFormat);
+    scratchLocks.Release();
+    captureScratch.assign((size_t)captureBufferFrames * captureFormat->nChannels, 0.0f);
+    renderScratch.assign((size_t)captureBufferFrames * renderFormat->nChannels, 0.0f);
+    scratchLocks.Lock(captureScratch);
+    scratchLocks.Lock(renderScratch);
+    REFERENCE_TIME captureLatency = 0, renderLatency = 0;
+    captureClient->GetStreamLatency(&captureLatency);
+    renderClient->GetStreamLatency(&renderLatency);
+    // REFERENCE_TIME is in 100 ns units
+    captureStreamMs = captureLatency / 10000.0;
+    renderStreamMs = renderLatency / 10000.0;
+    devicePeriodMs = capturePeriod * 1000.0 / captureFormat->nSamplesPerSec;
+
+    // Audio queued ahead of the render device: the target, but never less
+    // than two periods (one playing, one being written)
+    renderDepthFrames = (UINT32)(renderFormat->nSamplesPerSec * targetLatencyMs / 1000.0f);
+    if (renderDepthFrames < 2 * renderPeriod) renderDepthFrames = 2 * renderPeriod;
+    // Two devices mean two clocks, so even equal rates drift apart over time
+    bridged = (driftCompensation || captureFormat->nSamplesPerSec != renderFormat->nSamplesPerSec) &&
+        captureSampleFormat != SampleFormat::Unknown && renderSampleFormat != SampleFormat::Unknown;
+    if (bridged) {
+        clockBridge.Prepare(captureFormat->nSamplesPerSec, renderFormat->nSamplesPerSec,
+            renderFormat->nChannels, resamplerQuality, captureBufferFrames, renderDepthFrames);
+        bridgeScratch.assign((size_t)renderBufferFrames * renderFormat->nChannels, 0.0f);
+        scratchLocks.Lock(bridgeScratch);
+    }
     hr = captureClient->GetService(IID_IAudioCaptureClient, (void**)&captureInterface);
     if (FAILED(hr) || !captureInterface) return hr;
     hr = renderClient->GetService(IID_IAudioRenderClient, (void**)&renderInterface);
@@ -117,718 +191,199 @@ HRESULT AudioProcessor::SetupAudio(const std::wstring& captureDeviceId) {
     return S_OK;
 }
 
-void AudioProcessor::ApplyTremolo(float* buffer, UINT32 numFrames) {
-    if (!tremoloEnabled || !buffer || !captureFormat) return;
-    float rate = tremoloRate;
-    float depth = tremoloDepth;
-    for (UINT32 i = 0; i < numFrames; i++) {
-        float tremolo = 1.0f + depth * sinf(tremoloPhase);
-        for (int ch = 0; ch < (int)captureFormat->nChannels; ch++) {
-            buffer[i * captureFormat->nChannels + ch] *= tremolo;
-        }
-        tremoloPhase += 2.0f * PI * rate / this->sampleRate;
-        if (tremoloPhase > 2.0f * PI) {
-            tremoloPhase -= 2.0f * PI;
+// Shared-mode stream sized for the latency target rather than a fixed
+// second. IAudioClient3 (Windows 10) can run the engine below its default
+// 10 ms period: take the smallest period the device allows that the polling
+// loop can keep up with. Otherwise ask for a buffer of the target duration,
+// which the engine rounds up to what it supports.
+HRESULT AudioProcessor::InitializeStream(IAudioClient* client, WAVEFORMATEX* format, UINT32& periodFrames) {
+    const UINT32 rate = format->nSamplesPerSec;
+    IAudioClient3* client3 = NULL;
+    if (SUCCEEDED(client->QueryInterface(IID_IAudioClient3, (void**)&client3)) && client3) {
+        UINT32 defaultPeriod = 0, fundamental = 0, minPeriod = 0, maxPeriod = 0;
+        HRESULT hr = client3->GetSharedModeEnginePeriod(format, &defaultPeriod, &fundamental, &minPeriod, &maxPeriod);
+        if (SUCCEEDED(hr) && fundamental > 0) {
+            UINT32 stable = (UINT32)(rate * kMinStablePeriodMs / 1000.0f);
+            UINT32 period = minPeriod;
+            while (period < stable && period + fundamental <= maxPeriod) period += fundamental;
+            hr = client3->InitializeSharedAudioStream(0, period, format, NULL);
+            if (SUCCEEDED(hr)) {
+                periodFrames = period;
+                client3->Release();
+                return hr;
+            }
         }
+        client3->Release();
     }
+    REFERENCE_TIME duration = (REFERENCE_TIME)(targetLatencyMs * 10000.0f);
+    HRESULT hr = client->Initialize(AUDCLNT_SHAREMODE_SHARED, 0, duration, 0, format, NULL);
+    if (FAILED(hr)) return hr;
+    REFERENCE_TIME defaultPeriod = 0;
+    client->GetDevicePeriod(&defaultPeriod, NULL);
+    periodFrames = (UINT32)(defaultPeriod * rate / 10000000);
+    return hr;
 }
 
-void AudioProcessor::ApplyChorus(float* buffer, UINT32 numFrames) {
-    if (!chorusEnabled || !buffer || !captureFormat) return;
-    const int channels = captureFormat->nChannels;
-    const float baseDelayMs = 15.0f;
-    const float modDepthMs = 10.0f * chorusDepth;
-    const float lfoRate = chorusRate;
-    const float feedback = chorusFeedback;
-    const float width = chorusWidth;
-    const float wetMix = 0.5f;
-    const float dryMix = 1.0f - wetMix;
-    const int maxDelayMs = 40;
-    const int maxDelaySamples = static_cast<int>((this->sampleRate * maxDelayMs) / 1000.0f);
-    if (chorusDelayBuffer.size() < (size_t)(maxDelaySamples * channels)) {
-        chorusDelayBuffer.assign(maxDelaySamples * channels, 0.0f);
-        chorusDelayIndex = 0;
+// Queues the render depth before the streams start, so the first capture
+// packet lands behind exactly that much audio
+HRESULT AudioProcessor::PrefillRender() {
+    if (bridged) {
+        // The bridge starts out holding the depth as silence
+        return RenderFromBridge();
     }
-    float phase = chorusPhase;
-    for (UINT32 i = 0; i < numFrames; ++i) {
-        for (int ch = 0; ch < channels; ++ch) {
-            size_t bufIdx = i * channels + ch;
-            float dry = buffer[bufIdx];
-            float lfo = 0.6f * sinf(phase) + 0.4f * sinf(phase * 1.5f);
-            float channelPhase = phase + (float)ch * width * PI;
-            lfo = 0.6f * sinf(channelPhase) + 0.4f * sinf(channelPhase * 1.5f);
-            float delayMs = baseDelayMs + modDepthMs * lfo;
-            float delaySamples = (this->sampleRate * delayMs) / 1000.0f;
-            float readPos = (float)chorusDelayIndex - delaySamples;
-            while (readPos < 0) readPos += (float)chorusDelayBuffer.size() / channels;
-            size_t idxA = ((size_t)readPos) * channels + ch;
-            size_t idxB = (idxA + channels);
-            if (idxB >= chorusDelayBuffer.size()) idxB -= chorusDelayBuffer.size();
-            float frac = readPos - floorf(readPos);
-            float sampleA = chorusDelayBuffer[idxA % chorusDelayBuffer.size()];
-            float sampleB = chorusDelayBuffer[idxB % chorusDelayBuffer.size()];
-            float wet = sampleA * (1.0f - frac) + sampleB * frac;
-            buffer[bufIdx] = dryMix * dry + wetMix * wet;
-            size_t writeIdx = (chorusDelayIndex * channels + ch);
-            chorusDelayBuffer[writeIdx % chorusDelayBuffer.size()] = dry + wet * feedback;
-        }
-        phase += 2.0f * PI * lfoRate / this->sampleRate;
-        if (phase > 2.0f * PI) phase -= 2.0f * PI;
-        chorusDelayIndex++;
-        if (chorusDelayIndex * channels >= chorusDelayBuffer.size()) chorusDelayIndex = 0;
-    }
-    chorusPhase = phase;
+    UINT32 frames = (renderDepthFrames < renderBufferFrames) ? renderDepthFrames : renderBufferFrames;
+    BYTE* renderData = NULL;
+    HRESULT hr = renderInterface->GetBuffer(frames, &renderData);
+    if (FAILED(hr)) return hr;
+    return renderInterface->ReleaseBuffer(frames, AUDCLNT_BUFFERFLAGS_SILENT);
 }
 
-void AudioProcessor::ApplyOverdrive(float* buffer, UINT32 numFrames) {
-    if (!overdriveEnabled || !buffer || !captureFormat) return;
-
-    const int channels = captureFormat->nChannels;
-    const float drive = overdriveDrive;        // 1.0f to 10.0f+ (input gain)
-    const float threshold = overdriveThreshold; // 0.1f to 0.9f (where overdrive kicks in)
-    const float tone = overdriveTone;          // 0.0f to 1.0f (tone control)
-    const float wetMix = overdriveMix;         // 0.0f to 1.0f (dry/wet blend)
-    const float dryMix = 1.0f - wetMix;
-
-    // Calculate dynamic parameters based on threshold
-    // Lower threshold = more aggressive overdrive and better compensation
-    const float sensitivity = 1.0f - threshold;  // 0.0 to 0.9
-    const float outputGain = 1.0f + (sensitivity * 2.0f); // Compensate volume loss
-    const float saturationAmount = 1.5f + (sensitivity * 3.0f); // More saturation at lower thresholds
-
-    // Pre-emphasis filter for bite (boosts mids before overdrive)
-    const float preEmphasisGain = 1.0f + (sensitivity * 0.8f);
-
-    // Tone shaping parameters
-    const float bassRolloff = 0.3f + (tone * 0.4f); // More bass cut with higher tone
-    const float trebleBoost = 1.0f + (tone * 1.5f); // More treble with higher tone
-
-    for (UINT32 i = 0; i < numFrames; ++i) {
-        for (int ch = 0; ch < channels; ++ch) {
-            size_t bufIdx = i * channels + ch;
-            float input = buffer[bufIdx];
-
-            // Stage 1: Input gain and pre-emphasis
-            float signal = input * drive * preEmphasisGain;
-
-            // Stage 2: Asymmetric tube-style overdrive
-            float overdriven;
-            float absSignal = fabsf(signal);
-
-            if (absSignal <= threshold) {
-                // Clean region - slight compression for punch
-                overdriven = signal * (1.0f + (absSignal / threshold) * 0.3f);
-            }
-            else {
-                // Overdrive region - progressive saturation
-                float excess = absSignal - threshold;
-                float normalizedExcess = excess / (1.0f - threshold + 0.001f); // Avoid division by zero
-
-                // Asymmetric clipping (different curves for positive/negative)
-                if (signal > 0.0f) {
-                    // Positive half - harder clipping
-                    float saturation = 1.0f - expf(-normalizedExcess * saturationAmount);
-                    overdriven = threshold + (saturation * (1.0f - threshold) * 0.85f);
-                }
-                else {
-                    // Negative half - softer clipping for asymmetry
-                    float saturation = 1.0f - expf(-normalizedExcess * saturationAmount * 0.8f);
-                    overdriven = -(threshold + (saturation * (1.0f - threshold) * 0.75f));
-                }
-
-                // Add harmonic content for aggression
-                float harmonicContent = signal * absSignal * 0.15f * sensitivity;
-                overdriven += harmonicContent;
-            }
-
-            // Stage 3: Tone shaping (simulates amp tone stack)
-            float toneProcessed = overdriven;
-
-            // Simple bass/treble adjustment
-            if (ch < 2) { // Only process first two channels for filter state
-                // High-pass filter for bass rolloff
-                float bassFiltered = overdriven * bassRolloff +
-                    overdriveFilterState[ch] * (1.0f - bassRolloff);
-                overdriveFilterState[ch] = bassFiltered;
-
-                // Treble emphasis
-                toneProcessed = bassFiltered + (overdriven - bassFiltered) * trebleBoost;
-            }
-
-            // Stage 4: Output processing
-            // Soft limiting to prevent harsh clipping
-            if (fabsf(toneProcessed) > 0.9f) {
-                float sign = (toneProcessed > 0.0f) ? 1.0f : -1.0f;
-                float compressed = 0.9f + (fabsf(toneProcessed) - 0.9f) * 0.1f;
-                toneProcessed = sign * fminf(compressed, 0.98f);
-            }
-
-            // Apply output gain compensation
-            toneProcessed *= outputGain;
-
-            // Final mix
-            buffer[bufIdx] = dryMix * input + wetMix * toneProcessed;
-        }
-    }
+bool AudioProcessor::SetEffectGraph(const EffectGraphDesc& desc) {
+    return engine.SetGraph(desc);
 }
 
-void AudioProcessor::ApplyReverb(float* buffer, UINT32 numFrames) {
-    if (!reverbEnabled || !buffer || !captureFormat) return;
-
-    const int channels = captureFormat->nChannels;
-    if (channels < 2) return; // Reverb requires stereo
-
-    // Initialize reverb filters if needed
-    if (!reverbInitialized) {
-        // Comb filter delays (in samples at 44.1kHz)
-        int combTunings[8] = { 1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617 };
-        // Allpass filter delays
-        int allpassTunings[4] = { 556, 441, 341, 225 };
-
-        // Scale delays for current sample rate
-        float scaleFactor = this->sampleRate / 44100.0f;
-
-        for (int i = 0; i < 8; i++) {
-            reverbCombL[i].setBuffer((int)(combTunings[i] * scaleFactor));
-            reverbCombR[i].setBuffer((int)(combTunings[i] * scaleFactor * 1.1f)); // Slight offset for stereo
-        }
-
-        for (int i = 0; i < 4; i++) {
-            reverbAllpassL[i].setBuffer((int)(allpassTunings[i] * scaleFactor));
-            reverbAllpassR[i].setBuffer((int)(allpassTunings[i] * scaleFactor * 1.1f));
-            reverbAllpassL[i].setFeedback(0.5f);
-            reverbAllpassR[i].setFeedback(0.5f);
-        }
-
-        reverbInitialized = true;
-    }
-
-    // Update reverb parameters
-    float roomSize = reverbSize * 0.28f + 0.7f;
-    float damping = reverbDamping * 0.4f;
-
-    for (int i = 0; i < 8; i++) {
-        reverbCombL[i].setFeedback(roomSize);
-        reverbCombR[i].setFeedback(roomSize);
-        reverbCombL[i].setDamp(damping);
-        reverbCombR[i].setDamp(damping);
-    }
-
-    const float wetGain = reverbMix * 3.0f;
-    const float dryGain = 1.0f - reverbMix;
-    const float width = reverbWidth;
-
-    for (UINT32 i = 0; i < numFrames; i++) {
-        float inputL = buffer[i * channels];
-        float inputR = buffer[i * channels + 1];
-
-        // Mix input to mono for reverb processing
-        float input = (inputL + inputR) * 0.015f; // Scale down input
-
-        // Process through comb filters
-        float combOutputL = 0.0f, combOutputR = 0.0f;
-
-        for (int c = 0; c < 8; c++) {
-            combOutputL += reverbCombL[c].process(input);
-            combOutputR += reverbCombR[c].process(input);
-        }
-
-        // Process through allpass filters
-        float allpassOutputL = combOutputL;
-        float allpassOutputR = combOutputR;
-
-        for (int a = 0; a < 4; a++) {
-            allpassOutputL = reverbAllpassL[a].process(allpassOutputL);
-            allpassOutputR = reverbAllpassR[a].process(allpassOutputR);
-        }
-
-        // Apply stereo width
-        float reverbL = allpassOutputL * (1.0f + width) * 0.5f + allpassOutputR * (1.0f - width) * 0.5f;
-        float reverbR = allpassOutputR * (1.0f + width) * 0.5f + allpassOutputL * (1.0f - width) * 0.5f;
-
-        // Mix dry and wet signals
-        buffer[i * channels] = inputL * dryGain + reverbL * wetGain;
-        buffer[i * channels + 1] = inputR * dryGain + reverbR * wetGain;
-
-        // Copy to additional channels if present
-        for (int ch = 2; ch < channels; ch++) {
-            buffer[i * channels + ch] = buffer[i * channels + (ch % 2)];
-        }
-    }
+EffectGraphDesc AudioProcessor::GetEffectGraph() const {
+    return engine.GetGraph();
 }
 
-void AudioProcessor::ApplyWarm(float* buffer, UINT32 numFrames) {
-    if (!warmEnabled || !buffer || !captureFormat) return;
-
-    const int channels = captureFormat->nChannels;
-    const float amount = warmAmount;
-    const float tone = warmTone;
-    const float saturation = warmSaturation;
-
-    // Make the effect more pronounced
-    const float wetMix = amount;  // Use full amount for wet mix
-    const float dryMix = 1.0f - wetMix;
-
-    // More aggressive parameters for audible effect
-    const float compressThreshold = 0.2f; // Lower threshold for more compression
-    const float compressRatio = 0.3f + (amount * 0.4f); // Variable compression
-    const float saturationDrive = 1.0f + (saturation * 3.0f); // More drive
-    const float harmonicAmount = saturation * 0.5f; // More prominent harmonics
-
-    // Frequency shaping - more pronounced
-    const float bassBoost = 1.0f + (1.0f - tone) * 0.8f; // Boost bass when tone is low
-    const float trebleRoll = 1.0f - (tone * 0.3f); // Roll off highs when tone is high
-    const float midWarmth = 1.0f + amount * 0.4f; // Mid frequency warmth
-
-    for (UINT32 i = 0; i < numFrames; ++i) {
-        for (int ch = 0; ch < channels && ch < 2; ++ch) {
-            size_t bufIdx = i * channels + ch;
-            float input = buffer[bufIdx];
-            float processed = input;
-
-            // Stage 1: Pre-emphasis and bass boost
-            processed *= bassBoost;
-
-            // Stage 2: Soft compression for glue
-            float absSignal = fabsf(processed);
-            if (absSignal > compressThreshold) {
-                float excess = absSignal - compressThreshold;
-                float compressed = compressThreshold + excess * compressRatio;
-                processed = (processed > 0.0f) ? compressed : -compressed;
-            }
-
-            // Stage 3: Tube-style saturation (more aggressive)
-            float driven = processed * saturationDrive;
-            float saturated;
-
-            if (fabsf(driven) <= 1.0f) {
-                // Polynomial saturation for warmth
-                float x = driven;
-                float x2 = x * x;
-                float x3 = x2 * x;
-                saturated = x - (x3 * 0.33f) + (x2 * harmonicAmount * 0.1f);
-            }
-            else {
-                // Hard limiting with soft knee
-                float sign = (driven > 0.0f) ? 1.0f : -1.0f;
-                float magnitude = fabsf(driven);
-                saturated = sign * (1.0f - expf(-(magnitude - 1.0f) * 0.5f));
-            }
-
-            // Scale back down
-            saturated *= 0.7f;
-
-            // Stage 4: Add even harmonics for tube warmth
-            if (harmonicAmount > 0.01f) {
-                float harmonic2 = saturated * saturated * harmonicAmount * 0.15f;
-                float harmonic3 = saturated * saturated * saturated * harmonicAmount * 0.05f;
-                saturated += harmonic2 + harmonic3;
-            }
-
-            // Stage 5: Tone shaping and mid warmth
-            saturated *= midWarmth;
-
-            // Simple high-frequency roll-off for smoothness
-            warmLowpassState[ch] += 0.3f * (saturated * trebleRoll - warmLowpassState[ch]);
-            float toneProcessed = warmLowpassState[ch];
-
-            // Stage 6: Output gain compensation
-            toneProcessed *= (0.8f + amount * 0.4f); // Compensate for level changes
-
-            // Final limiting
-            if (fabsf(toneProcessed) > 0.95f) {
-                float sign = (toneProcessed > 0.0f) ? 1.0f : -1.0f;
-                toneProcessed = sign * 0.95f;
-            }
-
-            // Mix with original signal
-            buffer[bufIdx] = dryMix * input + wetMix * toneProcessed;
-        }
-
-        // Copy to additional channels
-        for (int ch = 2; ch < channels; ch++) {
-            buffer[i * channels + ch] = buffer[i * channels + (ch % 2)];
-        }
-    }
+EffectParams AudioProcessor::CapturePreset() const {
+    return engine.Params();
 }
 
-void AudioProcessor::ApplyBluesDriver(float* buffer, UINT32 numFrames) {
-    if (!bluesEnabled || !buffer || !captureFormat) return;
-    const int channels = captureFormat->nChannels;
+// Builds the new chain here and crossfades to it on the audio thread
+void AudioProcessor::ApplyPreset(const EffectParams& preset) {
+    engine.SwitchPreset(preset);
+}
 
-    // Thorny blues parameters - more aggressive and edgy
-    const float inputGain = bluesGain * 1.8f; // More input drive for harder clipping
-    const float preDistortionBoost = 1.4f; // Pre-emphasis for bite
+void AudioProcessor::SetPresetCrossfadeMs(float ms) { engine.SetCrossfadeMs(ms); }
+float AudioProcessor::GetPresetCrossfadeMs() const { return engine.GetCrossfadeMs(); }
 
-    // Asymmetric clipping for that "broken" blues sound
-    const float softThreshold = 0.3f;
-    const float hardThreshold = 0.65f;
+void AudioProcessor::SetBlockSize(UINT32 frames) { engine.SetBlockSize(frames); }
+UINT32 AudioProcessor::GetBlockSize() const { return engine.GetBlockSize(); }
 
-    // Tone shaping - scooped mids with enhanced highs for sparkle
-    const float bassPresence = 1.2f + (1.0f - bluesTone) * 0.5f;
-    const float midScoop = 0.6f + bluesTone * 0.2f; // Slight scoop
-    const float trebleBoost = 1.5f + bluesTone * 1.0f; // Lots of high-end bite
-    const float presenceFreq = 0.15f; // High-mid presence
+void AudioProcessor::SetResamplerQuality(Resampler::Quality quality) { resamplerQuality = quality; }
+Resampler::Quality AudioProcessor::GetResamplerQuality() const { return resamplerQuality; }
 
-    // Harmonic generation for grit
-    const float harmonicDrive = 0.3f;
+double AudioProcessor::GetResamplerLatencyMs() const {
+    return bridged ? clockBridge.ResamplerLatencyMs() : 0.0;
+}
 
-    for (UINT32 i = 0; i < numFrames; ++i) {
-        for (int ch = 0; ch < channels; ++ch) {
-            size_t idx = i * channels + ch;
-            float input = buffer[idx];
+void AudioProcessor::SetDriftCompensation(bool enabled) { driftCompensation = enabled; }
+bool AudioProcessor::IsDriftCompensationEnabled() const { return driftCompensation; }
 
-            // Stage 1: Pre-emphasis boost for attack
-            float signal = input * inputGain * preDistortionBoost;
+DriftStats AudioProcessor::GetDriftStats() const {
+    return bridged ? clockBridge.GetStats() : DriftStats();
+}
 
-            // Stage 2: Asymmetric hard clipping (diode-like behavior)
-            float clipped;
-            float absSignal = fabsf(signal);
+void AudioProcessor::SetTargetLatencyMs(float ms) { targetLatencyMs = clamp(ms, 1.0f, 500.0f); }
+float AudioProcessor::GetTargetLatencyMs() const { return targetLatencyMs; }
 
-            if (absSignal < softThreshold) {
-                // Clean region with slight compression
-                clipped = signal * (1.0f + absSignal * 0.2f);
-            }
-            else if (absSignal < hardThreshold) {
-                // Soft saturation region
-                float excess = (absSignal - softThreshold) / (hardThreshold - softThreshold);
-                float curve = excess - (excess * excess * excess * 0.33f);
-                float sat = softThreshold + curve * (hardThreshold - softThreshold);
-                clipped = (signal > 0.0f) ? sat : -sat;
-            }
-            else {
-                // Hard clipping region - asymmetric!
-                float excess = absSignal - hardThreshold;
-                if (signal > 0.0f) {
-                    // Positive: harder clipping (more compression)
-                    float hardSat = hardThreshold + (1.0f - hardThreshold) * (1.0f - expf(-excess * 2.0f));
-                    clipped = fminf(hardSat, 0.95f);
-                }
-                else {
-                    // Negative: softer clipping (more dynamics)
-                    float softSat = hardThreshold + (1.0f - hardThreshold) * (1.0f - expf(-excess * 1.2f));
-                    clipped = -fminf(softSat, 0.90f);
-                }
-            }
+void AudioProcessor::SetRealtimePriority(bool enabled) { realtimeOptions.raisePriority = enabled; }
+bool AudioProcessor::IsRealtimePriorityEnabled() const { return realtimeOptions.raisePriority; }
+void AudioProcessor::SetAudioThreadCpu(int cpu) { realtimeOptions.cpu = cpu; }
+int AudioProcessor::GetAudioThreadCpu() const { return realtimeOptions.cpu; }
 
-            // Stage 3: Add even and odd harmonics for thorny character
-            float x2 = clipped * clipped;
-            float x3 = x2 * clipped;
-            float harmonics = (x2 * harmonicDrive * 0.15f) + // 2nd harmonic (warmth)
-                (x3 * harmonicDrive * 0.25f);   // 3rd harmonic (grit)
-            clipped += harmonics;
-
-            // Stage 4: Tone stack (Marshall-inspired with more bite)
-            // Use simple filters stored in bluesFilterState[0] = low, [1] = high
-            int filterIdx = ch % 2;
-
-            // Low-shelf for bass
-            float lowTarget = clipped * bassPresence;
-            bluesFilterState[filterIdx] += 0.08f * (lowTarget - bluesFilterState[filterIdx]);
-            float bass = bluesFilterState[filterIdx];
-
-            // High-shelf for treble and presence
-            float highpass = clipped - bass;
-            float treble = highpass * trebleBoost;
-
-            // Mid calculation with scoop
-            float mid = (clipped - bass * 0.5f - highpass * 0.5f) * midScoop;
-
-            // Presence boost (upper mids) - the "thorn"
-            float presence = highpass * presenceFreq * 2.5f;
-
-            // Mix tone components
-            float toneMixed = bass * 0.35f + mid * 0.25f + treble * 0.3f + presence * 0.1f;
-
-            // Stage 5: Final soft limiting to prevent harshness
-            float output = toneMixed;
-            float absOut = fabsf(output);
-            if (absOut > 0.85f) {
-                float sign = (output > 0.0f) ? 1.0f : -1.0f;
-                float limited = 0.85f + (absOut - 0.85f) * 0.3f;
-                output = sign * fminf(limited, 0.98f);
-            }
+void AudioProcessor::SetSessionRecording(const std::string& path) { sessionPath = path; }
+bool AudioProcessor::IsSessionRecording() const { return sessionRecorder.IsRecording(); }
 
-            // Apply output level with slight boost to compensate
-            buffer[idx] = output * bluesLevel * 1.1f;
-        }
+LatencyReport AudioProcessor::GetLatencyReport() const {
+    LatencyReport report;
+    report.requestedMs = targetLatencyMs;
+    if (renderFormat) report.depthMs = renderDepthFrames * 1000.0 / renderFormat->nSamplesPerSec;
+    const double rate = engine.SampleRate();
+    report.effectsMs = engine.EffectLatencyFrames() * 1000.0 / rate;
+    report.blockMs = engine.GetBlockSize() * 1000.0 / rate;
+    report.captureMs = captureStreamMs + devicePeriodMs;
+    report.renderMs = renderStreamMs;
+    if (bridged) {
+        // The bridge target already includes what the render device has queued
+        report.bridgeMs = clockBridge.LatencyMs();
     }
-}
-
-// --- Compressor implementation ---
-void AudioProcessor::ApplyCompressor(float* buffer, UINT32 numFrames) {
-    if (!compEnabled || !buffer || !captureFormat) return;
-    const int channels = captureFormat->nChannels;
-
-    // Convert parameters to useful values
-    float attackSec = fmaxf(0.1f, compAttackMs) / 1000.0f;
-    float releaseSec = fmaxf(10.0f, compSustainMs) / 1000.0f;
-
-    // Advanced envelope coefficients with adaptive behavior
-    float attackCoef = expf(-1.0f / (attackSec * this->sampleRate));
-    float releaseCoef = expf(-1.0f / (releaseSec * this->sampleRate));
-
-    // Sustainer-specific parameters
-    const float threshold = 0.15f; // Lower threshold for more sustain
-    const float ratio = 8.0f; // High ratio for strong compression
-    const float kneeWidth = 0.1f; // Soft knee for smooth compression
-    const float makeupGain = 2.5f; // Boost output to compensate
-
-    // Sustain enhancement - slower release for longer notes
-    float sustainFactor = compSustainMs / 1000.0f;
-    float adaptiveReleaseCoef = expf(-1.0f / ((releaseSec * (1.0f + sustainFactor * 2.0f)) * this->sampleRate));
-
-    for (UINT32 i = 0; i < numFrames; ++i) {
-        for (int ch = 0; ch < channels; ++ch) {
-            size_t idx = i * channels + ch;
-            float x = buffer[idx];
-            float absx = fabsf(x);
-
-            // --- Stage 1: Peak detection with attack/release ---
-            float env = compEnv[ch];
-            if (absx > env) {
-                // Attack phase - fast response to peaks
-                env = attackCoef * env + (1.0f - attackCoef) * absx;
-            }
-            else {
-                // Release phase - use adaptive release for sustain
-                env = adaptiveReleaseCoef * env + (1.0f - adaptiveReleaseCoef) * absx;
-            }
-            compEnv[ch] = env;
-
-            // --- Stage 2: Compute gain reduction with soft knee ---
-            float gain = 1.0f;
-
-            if (env > threshold - kneeWidth && env < threshold + kneeWidth) {
-                // Soft knee region - smooth transition
-                float kneeInput = env - threshold + kneeWidth;
-                float kneeOutput = kneeInput * kneeInput / (4.0f * kneeWidth);
-                float dbOver = 20.0f * log10f((threshold + kneeOutput) / threshold + 1e-20f);
-                float dbReduce = dbOver - dbOver / ratio;
-                gain = powf(10.0f, -dbReduce / 20.0f);
-            }
-            else if (env >= threshold + kneeWidth) {
-                // Above knee - full compression
-                float dbOver = 20.0f * log10f(env / threshold + 1e-20f);
-                float dbReduce = dbOver - dbOver / ratio;
-                gain = powf(10.0f, -dbReduce / 20.0f);
-            }
-            // else: below knee, gain = 1.0f (no compression)
-
-            // --- Stage 3: Smooth gain to prevent zipper noise ---
-            float smooth = compGainSmooth[ch];
-            float smoothCoef = 0.001f; // Very smooth for sustain
-            smooth = smooth * (1.0f - smoothCoef) + gain * smoothCoef;
-            compGainSmooth[ch] = smooth;
-
-            // --- Stage 4: Apply compression and makeup gain ---
-            float compressed = x * smooth * makeupGain * compLevel;
-
-            // --- Stage 5: Sustain enhancement - add subtle harmonics ---
-            // This helps maintain presence during long sustains
-            float harmonic = compressed * fabsf(compressed) * 0.08f * sustainFactor;
-            compressed += harmonic;
-
-            // --- Stage 6: Advanced tone control ---
-            // Simulate amp-like tone stack
-            float low = compLowState[ch];
-            low += 0.03f * (compressed - low); // Low shelf
-            compLowState[ch] = low;
-
-            float high = compressed - low; // High shelf
-
-            // Tone control: 0 = warm (more lows), 1 = bright (more highs)
-            float midBoost = 1.0f + (1.0f - fabsf(compTone - 0.5f) * 2.0f) * 0.3f; // Mid emphasis
-            float toneBalance = compTone;
-
-            float output = (low * (1.0f - toneBalance) * 1.2f +  // Bass boost when tone is low
-                compressed * midBoost * 0.4f +          // Mids always present
-                high * toneBalance * 1.5f);             // Treble boost when tone is high
-
-            // --- Stage 7: Soft limiting to prevent clipping ---
-            float absOut = fabsf(output);
-            if (absOut > 0.9f) {
-                float sign = (output > 0.0f) ? 1.0f : -1.0f;
-                float limited = 0.9f + (absOut - 0.9f) * 0.1f;
-                output = sign * fminf(limited, 0.98f);
-            }
-
-            buffer[idx] = output;
-        }
+    else if (renderFormat) {
+        report.renderMs += renderQueuedFrames * 1000.0 / renderFormat->nSamplesPerSec;
     }
+    report.totalMs = report.effectsMs + report.blockMs + report.bridgeMs + report.captureMs + report.renderMs;
+    return report;
 }
 
-// Wah effect processing
-void AudioProcessor::processWah(float* leftChannel, float* rightChannel, int numSamples) {
-    if (!wahState.enabled || !captureFormat) {
-        return;
-    }
-
-    const float sr = this->sampleRate;
-    const float lfoIncrement = (2.0f * PI * wahState.lfoRate) / sr;
-
-    // Envelope attack/release coefficients
-    float attackCoef = expf(-1.0f / (fmaxf(0.001f, wahState.envAttackMs) * 0.001f * sr));
-    float releaseCoef = expf(-1.0f / (fmaxf(1.0f, wahState.envReleaseMs) * 0.001f * sr));
-
-    // Keep track of last center frequency to smooth coefficient updates
-    static float smoothFreq = wahState.freq;
-    const float smoothFactor = 0.08f; // smoothing for freq changes
-
-    for (int i = 0; i < numSamples; ++i) {
-        // Calculate instantaneous input level (RMS-ish using abs average)
-        float inL = leftChannel[i];
-        float inR = rightChannel[i];
-        float level = (fabsf(inL) + fabsf(inR)) * 0.5f;
-
-        // Update envelope follower (attack/release)
-        if (level > wahState.env) {
-            wahState.env = attackCoef * wahState.env + (1.0f - attackCoef) * level;
-        } else {
-            wahState.env = releaseCoef * wahState.env + (1.0f - releaseCoef) * level;
-        }
-
-        // Compute modulation amount from envelope (scale 0..1)
-        float envMod = fminf(1.0f, wahState.env * 3.0f); // scale up sensitivity
-
-        // LFO value
-        float lfoValue = 0.0f;
-        if (wahState.lfoRate > 0.0f && wahState.lfoDepth > 0.0f) {
-            // use sine LFO for smoothness
-            lfoValue = 0.5f * (1.0f + sinf(wahState.lfoPhase)); // 0..1
-            wahState.lfoPhase += lfoIncrement;
-            if (wahState.lfoPhase >= 2.0f * PI) wahState.lfoPhase -= 2.0f * PI;
-        }
-
-        // Combine envelope and LFO to determine target frequency
-        float envInfluence = envMod * wahState.lfoDepth; // envelope scaled by LFO depth param
-        float lfoInfluence = lfoValue * wahState.lfoDepth;
-        float combined = (envInfluence + lfoInfluence) / fmaxf(0.0001f, (wahState.lfoDepth + wahState.lfoDepth));
-        // If lfoDepth is zero, fall back to envelope only
-        if (wahState.lfoDepth <= 0.0001f) combined = envMod;
-
-        float targetFreq = WAH_FREQ_MIN + combined * (WAH_FREQ_MAX - WAH_FREQ_MIN);
-        // Mix with manual freq setting (manual has some weight)
-        targetFreq = (targetFreq * 0.9f) + (wahState.freq * 0.1f);
-
-        // Smooth frequency to avoid zipper noise
-        smoothFreq += (targetFreq - smoothFreq) * smoothFactor;
-
-        // Update coefficients if change significant
-        static float lastUpdatedFreq = 0.0f;
-        if (fabsf(smoothFreq - lastUpdatedFreq) > 1.0f) {
-            updateWahCoefficients(smoothFreq, sr);
-            lastUpdatedFreq = smoothFreq;
-        }
-
-        // Process left channel sample with biquad difference eq (Direct Form 2 Transposed variant used variables z1/z2 as states)
-        float inSampleL = inL;
-        float outL = wahCoeffs.b0 * inSampleL + wahCoeffs.b1 * wahState.z1L + wahCoeffs.b2 * wahState.z2L - wahCoeffs.a1 * wahState.z1L - wahCoeffs.a2 * wahState.z2L;
-        wahState.z2L = wahState.z1L;
-        wahState.z1L = outL;
-
-        float inSampleR = inR;
-        float outR = wahCoeffs.b0 * inSampleR + wahCoeffs.b1 * wahState.z1R + wahCoeffs.b2 * wahState.z2R - wahCoeffs.a1 * wahState.z1R - wahCoeffs.a2 * wahState.z2R;
-        wahState.z2R = wahState.z1R;
-        wahState.z1R = outR;
-
-        // Mix dry/wet
-        leftChannel[i] = inSampleL * (1.0f - wahState.mix) + outL * wahState.mix;
-        rightChannel[i] = inSampleR * (1.0f - wahState.mix) + outR * wahState.mix;
+LatencyMeasurement AudioProcessor::MeasureLatency(DWORD timeoutMs) {
+    if (!running || !captureFormat) return LatencyMeasurement();
+    latencyProbe.Arm();
+    for (DWORD waited = 0; running && !latencyProbe.Done() && waited < timeoutMs; waited += 10) {
+        Sleep(10);
     }
+    return latencyProbe.Analyze(captureFormat->nSamplesPerSec);
 }
 
-void AudioProcessor::updateWahCoefficients(float centerFreq, float sampleRate) {
-    // Bandpass filter using RBJ cookbook formula
-    float omega = 2.0f * PI * centerFreq / sampleRate;
-    float sinOmega = std::sin(omega);
-    float cosOmega = std::cos(omega);
-    float alpha = sinOmega / (2.0f * wahState.q);
-
-    float a0 = 1.0f + alpha;
-
-    // Bandpass filter coefficients (constant 0 dB peak gain)
-    wahCoeffs.b0 = alpha / a0;
-    wahCoeffs.b1 = 0.0f;
-    wahCoeffs.b2 = -alpha / a0;
-    wahCoeffs.a1 = -2.0f * cosOmega / a0;
-    wahCoeffs.a2 = (1.0f - alpha) / a0;
+// Capture packet -> float -> effects -> render channel layout, still at the
+// capture rate. Returns the converted samples.
+const float* AudioProcessor::ProcessConverted(const BYTE* captureData, UINT32 numFrames) {
+    const int captureChannels = captureFormat->nChannels;
+    const int renderChannels = renderFormat->nChannels;
+    float* samples = captureScratch.data();
+    TRACE_SCOPE("Effects", numFrames);
+    ConvertToFloat(captureSampleFormat, captureData, samples, (size_t)numFrames * captureChannels);
+    AccumulateLevels(samples, (size_t)numFrames * captureChannels, statsWindow.inputPeak, statsWindow.inputSquares);
+    statsWindow.inputSamples += (size_t)numFrames * captureChannels;
+    engine.Process(samples, samples, numFrames, mainVolume);
+    latencyProbe.Process(samples, samples, numFrames, captureChannels);
+    if (renderChannels != captureChannels) {
+        RemapChannels(samples, captureChannels, renderScratch.data(), renderChannels, numFrames);
+        samples = renderScratch.data();
+    }
+    AccumulateLevels(samples, (size_t)numFrames * renderChannels, statsWindow.outputPeak, statsWindow.outputSquares);
+    statsWindow.outputSamples += (size_t)numFrames * renderChannels;
+    return samples;
 }
 
-void AudioProcessor::resetWahState() {
-    wahState.z1L = 0.0f;
-    wahState.z2L = 0.0f;
-    wahState.z1R = 0.0f;
-    wahState.z2R = 0.0f;
-    wahState.lfoPhase = 0.0f;
+// Tops the render buffer up with everything the drift bridge holds
+HRESULT AudioProcessor::RenderFromBridge() {
+    TRACE_SCOPE("RenderFromBridge");
+    UINT32 numFramesPadding = 0;
+    HRESULT hr = renderClient->GetCurrentPadding(&numFramesPadding);
+    if (FAILED(hr)) return hr;
+    if (numFramesPadding == 0) ++statsGlitches;  // the device ran dry
+    UINT32 frames = renderBufferFrames - numFramesPadding;
+    if (frames > clockBridge.Available()) frames = clockBridge.Available();
+    if (frames == 0) return S_OK;
+    BYTE* renderData = NULL;
+    hr = renderInterface->GetBuffer(frames, &renderData);
+    if (FAILED(hr) || !renderData) return hr;
+    clockBridge.Read(bridgeScratch.data(), frames);
+    ConvertFromFloat(renderSampleFormat, bridgeScratch.data(), renderData,
+        (size_t)frames * renderFormat->nChannels, &dither);
+    return renderInterface->ReleaseBuffer(frames, 0);
 }
 
 // --- AudioProcessor method implementations ---
 void AudioProcessor::Reset() {
-    tremoloRate = 5.0f;
-    tremoloDepth = 0.5f;
-    tremoloEnabled = false;
-    chorusEnabled = false;
-    chorusRate = 1.5f;
-    chorusDepth = 0.02f;
-    chorusFeedback = 0.3f;
-    chorusWidth = 0.5f;
-    tremoloPhase = 0.0f;
-    chorusPhase = 0.0f;
+    EffectParams preset;
+    preset.compSustainMs = 100.0f;
+    preset.wahFreq = 1000.0f;
+    preset.wahQ = 10.0f;
+    preset.wahLfoRate = 0.5f;
+    preset.wahLfoDepth = 0.5f;
+    preset.wahMix = 0.5f;
+    // Rate dividers are a CPU setting rather than part of the sound
+    preset.reverbRateDivider = engine.Params().reverbRateDivider;
+    preset.chorusRateDivider = engine.Params().chorusRateDivider;
+    ApplyPreset(preset);
     mainVolume = 1.0f;
 
-    // Reset blues parameters
-    bluesEnabled = false;
-    bluesGain = 1.5f;
-    bluesTone = 0.5f;
-    bluesLevel = 0.8f;
-    bluesFilterState[0] = bluesFilterState[1] = 0.0f;
-
-    // Reset reverb parameters
-    reverbEnabled = false;
-    reverbSize = 0.5f;
-    reverbDamping = 0.5f;
-    reverbWidth = 1.0f;
-    reverbMix = 0.3f;
-    reverbInitialized = false; // Force reinitialize on next use
-    warmEnabled = false;
-    warmAmount = 0.5f;
-    warmTone = 0.5f;
-    warmSaturation = 0.3f;
-    // Clear filter states
-    for (int i = 0; i < 2; i++) {
-        warmLowpassState[i] = 0.0f;
-        warmHighpassState[i] = 0.0f;
-        warmSaturatorState[i] = 0.0f;
-    }
-
-    // Reset compressor parameters
-    compEnabled = false;
-    compLevel = 1.0f;
-    compTone = 0.5f;
-    compAttackMs = 10.0f;
-    compSustainMs = 100.0f;
-    for (int i = 0; i < 2; i++) {
-        compEnv[i] = 0.0f;
-        compGainSmooth[i] = 0.0f;
-        compLowState[i] = 0.0f;
-    }
-
-    // Reset wah parameters
-    wahState.enabled = false;
-    wahState.freq = 1000.0f;
-    wahState.q = 10.0f;
-    wahState.lfoRate = 0.5f;
-    wahState.lfoDepth = 0.5f;
-    wahState.mix = 0.5f;
-    resetWahState();
+    // Back to the default effect order
+    SetEffectGraph(EffectGraphDesc::Default());
 }
 
 void AudioProcessor::AudioLoop() {
     HRESULT hrCOM = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    RealtimeThreadScope realtime(realtimeOptions);
+    TraceRegisterThread("Audio");
+    if (!realtime.Elevated() && realtimeOptions.raisePriority) {
+        LOG_WARNING(LogEvent::AudioNoRealtimePriority);
+    }
     if (!captureClient || !renderClient || !captureInterface || !renderInterface ||
         !captureFormat || !renderFormat) {
-        std::cerr << "AudioLoop: Required interface is null, exiting thread." << std::endl;
+        LOG_ERROR(LogEvent::AudioMissingInterface);
         running = false;
         if (SUCCEEDED(hrCOM)) CoUninitialize();
         return;
@@ -837,131 +392,217 @@ void AudioProcessor::AudioLoop() {
     HRESULT hr;
     hr = captureClient->Start();
     if (FAILED(hr)) {
-        std::cerr << "AudioLoop: captureClient->Start() failed, exiting thread." << std::endl;
+        LOG_ERROR(LogEvent::AudioCaptureStartFailed, (uint32_t)hr);
+        running = false;
+        if (SUCCEEDED(hrCOM)) CoUninitialize();
+        return;
+    }
+    hr = PrefillRender();
+    if (FAILED(hr)) {
+        LOG_ERROR(LogEvent::AudioPrefillFailed, (uint32_t)hr);
+        captureClient->Stop();
         running = false;
         if (SUCCEEDED(hrCOM)) CoUninitialize();
         return;
     }
     hr = renderClient->Start();
     if (FAILED(hr)) {
-        std::cerr << "AudioLoop: renderClient->Start() failed, exiting thread." << std::endl;
+        LOG_ERROR(LogEvent::AudioRenderStartFailed, (uint32_t)hr);
         captureClient->Stop();
         running = false;
         if (SUCCEEDED(hrCOM)) CoUninitialize();
         return;
     }
-    running = true;
+    const int renderChannels = renderFormat->nChannels;
+    const bool direct = captureSampleFormat == SampleFormat::Float32 &&
+        renderSampleFormat == SampleFormat::Float32 &&
+        captureFormat->nChannels == renderChannels && !bridged;
+    const bool convert = captureSampleFormat != SampleFormat::Unknown &&
+        renderSampleFormat != SampleFormat::Unknown;
+    const bool copy = captureFormat->nBlockAlign == renderFormat->nBlockAlign &&
+        captureFormat->nSamplesPerSec == renderFormat->nSamplesPerSec;
+    BeginStats();
+    bool firstPacket = true;
+    // running was set by StartProcessing; Stop() may already have cleared it
     while (running) {
-        if (!captureInterface || !renderInterface) {
-            Sleep(1);
-            continue;
-        }
         UINT32 packetLength = 0;
         hr = captureInterface->GetNextPacketSize(&packetLength);
         if (FAILED(hr)) {
-            std::cerr << "AudioLoop: GetNextPacketSize failed, breaking loop." << std::endl;
+            LOG_ERROR(LogEvent::AudioPacketSizeFailed, (uint32_t)hr);
             break;
         }
         if (packetLength != 0) {
             BYTE* captureData = NULL;
             UINT32 numFramesAvailable = 0;
             DWORD flags = 0;
-            hr = captureInterface->GetBuffer(&captureData, &numFramesAvailable, &flags, NULL, NULL);
+            {
+                TRACE_SCOPE("CaptureGetBuffer");
+                hr = captureInterface->GetBuffer(&captureData, &numFramesAvailable, &flags, NULL, NULL);
+            }
             if (FAILED(hr)) {
-                std::cerr << "AudioLoop: GetBuffer failed, breaking loop." << std::endl;
+                LOG_ERROR(LogEvent::AudioCaptureBufferFailed, (uint32_t)hr);
                 break;
             }
-            if (captureData && numFramesAvailable > 0) {
+            const uint64_t packetStartNs = TraceNowNs();
+            // The first packet after Start() is routinely flagged
+            if ((flags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY) && !firstPacket) ++statsGlitches;
+            firstPacket = false;
+            TRACE_INSTANT("CapturePacket", numFramesAvailable);
+            TRACE_SCOPE("Packet", numFramesAvailable);
+            if (captureData && numFramesAvailable > 0 && bridged) {
+                // Render is topped up from the bridge below, on its own schedule
+                UINT32 numFramesPadding = 0;
+                hr = renderClient->GetCurrentPadding(&numFramesPadding);
+                if (FAILED(hr)) {
+                    LOG_ERROR(LogEvent::AudioPaddingFailed, (uint32_t)hr);
+                    captureInterface->ReleaseBuffer(numFramesAvailable);
+                    break;
+                }
+                clockBridge.Write(ProcessConverted(captureData, numFramesAvailable),
+                    numFramesAvailable, numFramesPadding);
+                TRACE_SCOPE("CaptureReleaseBuffer");
+                captureInterface->ReleaseBuffer(numFramesAvailable);
+            }
+            else if (captureData && numFramesAvailable > 0) {
+                const float* converted = NULL;
+                if (!direct && convert) {
+                    converted = ProcessConverted(captureData, numFramesAvailable);
+                }
                 UINT32 numFramesPadding = 0;
                 hr = renderClient->GetCurrentPadding(&numFramesPadding);
                 if (FAILED(hr)) {
-                    std::cerr << "AudioLoop: GetCurrentPadding failed, breaking loop." << std::endl;
+                    LOG_ERROR(LogEvent::AudioPaddingFailed, (uint32_t)hr);
                     captureInterface->ReleaseBuffer(numFramesAvailable);
                     break;
                 }
+                renderQueuedFrames = numFramesPadding;
+                if (numFramesPadding == 0) ++statsGlitches;  // the device ran dry
                 UINT32 numFramesAvailableForRender = renderBufferFrames - numFramesPadding;
                 if (numFramesAvailableForRender >= numFramesAvailable) {
                     BYTE* renderData = NULL;
-                    hr = renderInterface->GetBuffer(numFramesAvailable, &renderData);
+                    {
+                        TRACE_SCOPE("RenderGetBuffer");
+                        hr = renderInterface->GetBuffer(numFramesAvailable, &renderData);
+                    }
                     if (FAILED(hr)) {
-                        std::cerr << "AudioLoop: renderInterface->GetBuffer failed, breaking loop." << std::endl;
+                        LOG_ERROR(LogEvent::AudioRenderBufferFailed, (uint32_t)hr);
                         captureInterface->ReleaseBuffer(numFramesAvailable);
                         break;
                     }
                     if (renderData) {
-                        memcpy(renderData, captureData, numFramesAvailable * captureFormat->nBlockAlign);
-                        if (captureFormat && captureFormat->wBitsPerSample == 32 && renderData) {
-                            ApplyTremolo((float*)renderData, numFramesAvailable);
-                            if (chorusEnabled) {
-                                ApplyChorus((float*)renderData, numFramesAvailable);
-                            }
-                            if (bluesEnabled) {
-                                ApplyBluesDriver((float*)renderData, numFramesAvailable);
-                            }
-                            if (overdriveEnabled) {
-                                ApplyOverdrive((float*)renderData, numFramesAvailable);
-                            }
-                            if (compEnabled) {
-                                ApplyCompressor((float*)renderData, numFramesAvailable);
-                            }
-                            if (reverbEnabled) {
-                                ApplyReverb((float*)renderData, numFramesAvailable);
-                            }
-                            if (warmEnabled) {
-                                ApplyWarm((float*)renderData, numFramesAvailable);
-                            }
-                            // Wah processing (interleaved to per-channel wrapper)
-                            if (wahState.enabled && captureFormat && captureFormat->wBitsPerSample == 32) {
-                                int channels = captureFormat->nChannels;
-                                if (channels >= 2) {
-                                    std::vector<float> leftBuf(numFramesAvailable);
-                                    std::vector<float> rightBuf(numFramesAvailable);
-                                    float* out = (float*)renderData;
-                                    for (UINT32 f = 0; f < numFramesAvailable; ++f) {
-                                        leftBuf[f] = out[f * channels];
-                                        rightBuf[f] = out[f * channels + 1];
-                                    }
-                                    // processWah updates leftBuf and rightBuf in-place
-                                    processWah(leftBuf.data(), rightBuf.data(), (int)numFramesAvailable);
-                                    for (UINT32 f = 0; f < numFramesAvailable; ++f) {
-                                        out[f * channels] = leftBuf[f];
-                                        out[f * channels + 1] = rightBuf[f];
-                                        // copy to additional channels if present
-                                        for (int ch = 2; ch < channels; ++ch) {
-                                            out[f * channels + ch] = out[f * channels + (ch % 2)];
-                                        }
-                                    }
-                                }
-                            }
-                            // Apply main volume
-                            float vol = mainVolume;
-                            int totalSamples = numFramesAvailable * captureFormat->nChannels;
-                            float* out = (float*)renderData;
-                            for (int i = 0; i < totalSamples; ++i) {
-                                out[i] *= vol;
-                            }
+                        DWORD renderFlags = 0;
+                        if (direct) {
+                            // Effects read the capture packet and write the render buffer
+                            // directly; main volume goes into the last stage's write
+                            TRACE_SCOPE("Effects", numFramesAvailable);
+                            const size_t samples = (size_t)numFramesAvailable * renderChannels;
+                            AccumulateLevels((const float*)captureData, samples,
+                                statsWindow.inputPeak, statsWindow.inputSquares);
+                            engine.Process((const float*)captureData, (float*)renderData,
+                                numFramesAvailable, mainVolume);
+                            latencyProbe.Process((const float*)renderData, (float*)renderData,
+                                numFramesAvailable, renderChannels);
+                            AccumulateLevels((const float*)renderData, samples,
+                                statsWindow.outputPeak, statsWindow.outputSquares);
+                            statsWindow.inputSamples += samples;
+                            statsWindow.outputSamples += samples;
+                        }
+                        else if (converted) {
+                            ConvertFromFloat(renderSampleFormat, converted, renderData,
+                                (size_t)numFramesAvailable * renderChannels, &dither);
+                        }
+                        else if (copy) {
+                            memcpy(renderData, captureData, numFramesAvailable * captureFormat->nBlockAlign);
                         }
-                        renderInterface->ReleaseBuffer(numFramesAvailable, 0);
+                        else {
+                            renderFlags = AUDCLNT_BUFFERFLAGS_SILENT;
+                        }
+                        TRACE_SCOPE("RenderReleaseBuffer");
+                        renderInterface->ReleaseBuffer(numFramesAvailable, renderFlags);
                     }
                 }
+                else {
+                    ++statsGlitches;  // render buffer full: this packet is dropped
+                }
+                TRACE_SCOPE("CaptureReleaseBuffer");
                 captureInterface->ReleaseBuffer(numFramesAvailable);
             }
+            CountPacket(packetStartNs, numFramesAvailable);
+        }
+        else if (WaitForSingleObject(stopEvent, 1) == WAIT_OBJECT_0) {
+            break;
         }
-        else {
-            Sleep(1);
+        if (bridged) {
+            hr = RenderFromBridge();
+            if (FAILED(hr)) {
+                LOG_ERROR(LogEvent::AudioBridgeRenderFailed, (uint32_t)hr);
+                break;
+            }
         }
+        PublishStats(TraceNowNs(), false);
     }
-    std::cerr << "AudioLoop: Exiting main loop." << std::endl;
-    if (captureClient) captureClient->Stop();
-    if (renderClient) renderClient->Stop();
+    LOG_INFO(LogEvent::AudioLoopExit);
+    running = false;
+    liveStats.running = 0;
+    PublishStats(TraceNowNs(), true);
+    captureClient->Stop();
+    renderClient->Stop();
     if (SUCCEEDED(hrCOM)) CoUninitialize();
 }
 
-void AudioProcessor::StartProcessing(const std::wstring& deviceId) {
-    if (running) {
-        Stop();
-        Sleep(100);
+void AudioProcessor::BeginStats() {
+    memset(&liveStats, 0, sizeof(liveStats));
+    liveStats.sampleRate = captureFormat->nSamplesPerSec;
+    liveStats.channels = renderFormat->nChannels;
+    liveStats.running = 1;
+    liveStats.latencyMs = statsLatencyMs;
+    statsWindow = StatsWindow();
+    statsWindow.startNs = TraceNowNs();
+    statsGlitches = 0;
+    uint64_t discard[kLiveStatsEffects] = {};
+    engine.TakeEffectTimes(discard);
+}
+
+// A packet misses its deadline when handling it takes longer than it plays
+void AudioProcessor::CountPacket(uint64_t startNs, UINT32 numFrames) {
+    const uint64_t busy = TraceNowNs() - startNs;
+    statsWindow.busyNs += busy;
+    if ((double)busy > numFrames * 1e9 / liveStats.sampleRate) ++liveStats.deadlineMisses;
+}
+
+void AudioProcessor::PublishStats(uint64_t nowNs, bool force) {
+    const uint64_t elapsed = nowNs - statsWindow.startNs;
+    if (elapsed < kStatsWindowNs && !force) return;
+    engine.TakeEffectTimes(statsWindow.effectNs);
+    const double window = elapsed > 0 ? (double)elapsed : 1.0;
+    liveStats.updates++;
+    liveStats.timeNs = nowNs;
+    liveStats.cpuLoad = statsWindow.busyNs / window;
+    for (int i = 0; i < kLiveStatsEffects; ++i) liveStats.effectLoad[i] = statsWindow.effectNs[i] / window;
+    liveStats.inputPeak = statsWindow.inputPeak;
+    liveStats.outputPeak = statsWindow.outputPeak;
+    liveStats.inputRms = statsWindow.inputSamples ?
+        (float)sqrt(statsWindow.inputSquares / statsWindow.inputSamples) : 0.0f;
+    liveStats.outputRms = statsWindow.outputSamples ?
+        (float)sqrt(statsWindow.outputSquares / statsWindow.outputSamples) : 0.0f;
+    liveStats.xruns = statsGlitches;
+    if (bridged) {
+        DriftStats drift = clockBridge.GetStats();
+        liveStats.xruns += drift.underruns + drift.overruns;
+        liveStats.fifoFillFrames = drift.bufferedFrames;
+        liveStats.fifoTargetFrames = drift.targetFrames;
     }
+    else {
+        liveStats.fifoFillFrames = renderQueuedFrames;
+        liveStats.fifoTargetFrames = renderDepthFrames;
+    }
+    statsPublisher.Publish(liveStats);
+    statsWindow = StatsWindow();
+    statsWindow.startNs = nowNs;
+}
+
+void AudioProcessor::StartProcessing(const std::wstring& deviceId) {
+    // Joins the previous loop before its devices are released
     Cleanup();
     // Ensure deviceEnumerator is initialized
     HRESULT hr = S_OK;
@@ -974,8 +615,20 @@ void AudioProcessor::StartProcessing(const std::wstring& deviceId) {
     }
     hr = SetupAudio(deviceId);
     if (SUCCEEDED(hr)) {
-        std::thread audioThread(&AudioProcessor::AudioLoop, this);
-        audioThread.detach();
+        if (!sessionPath.empty()) {
+            // A replay starts from a new engine, so the live one must too
+            engine.Reset();
+            if (sessionRecorder.Start(sessionPath.c_str(), engine.SampleRate(), engine.Channels(), engine.MaxBlockFrames())) {
+                engine.SetRecorder(&sessionRecorder);
+            }
+            else {
+                LOG_ERROR(LogEvent::SessionRecordingFailed);
+            }
+        }
+        statsLatencyMs = GetLatencyReport().totalMs;
+        ResetEvent(stopEvent);
+        running = true;
+        audioThread = std::thread(&AudioProcessor::AudioLoop, this);
     }
     else {
         Cleanup();
@@ -983,13 +636,25 @@ void AudioProcessor::StartProcessing(const std::wstring& deviceId) {
     }
 }
 
+// Returns once the audio thread has left its loop and stopped both streams:
+// within one iteration, i.e. a capture packet or a 1 ms idle wait
 void AudioProcessor::Stop() {
     running = false;
-    Sleep(100); // Give audio processing time to stop cleanly
+    if (stopEvent) SetEvent(stopEvent);
+    if (audioThread.joinable()) audioThread.join();
+}
+
+bool AudioProcessor::IsRunning() const {
+    return running;
 }
 
 void AudioProcessor::Cleanup() {
-    running = false;
+    Stop();
+    if (sessionRecorder.IsRecording()) {
+        engine.SetRecorder(nullptr);
+        if (sessionRecorder.Overflowed()) LOG_WARNING(LogEvent::SessionRecordingOverflow);
+        sessionRecorder.Stop();
+    }
     if (captureClient) {
         captureClient->Stop();
     }
@@ -1041,43 +706,44 @@ T clamp(T v, T lo, T hi) {
 }
 
 float AudioProcessor::GetReverbMix() const {
-    return reverbMix;
+    return engine.Params().reverbMix;
 }
 
 void AudioProcessor::SetWarmEnabled(bool enabled) {
-    warmEnabled = enabled;
+    engine.SetParam(&EffectParams::warmEnabled, enabled);
 }
 
 void AudioProcessor::SetWarmAmount(float amount) {
-    warmAmount = fmaxf(0.0f, fminf(1.0f, amount));
+    engine.SetParam(&EffectParams::warmAmount, fmaxf(0.0f, fminf(1.0f, amount)));
 }
 
 void AudioProcessor::SetWarmTone(float tone) {
-    warmTone = fmaxf(0.0f, fminf(1.0f, tone));
+    engine.SetParam(&EffectParams::warmTone, fmaxf(0.0f, fminf(1.0f, tone)));
 }
 
 void AudioProcessor::SetWarmSaturation(float saturation) {
-    warmSaturation = fmaxf(0.0f, fminf(1.0f, saturation));
+    engine.SetParam(&EffectParams::warmSaturation, fmaxf(0.0f, fminf(1.0f, saturation)));
 }
 
 bool AudioProcessor::IsWarmEnabled() const {
-    return warmEnabled;
+    return engine.Params().warmEnabled;
 }
 
 float AudioProcessor::GetWarmAmount() const {
-    return warmAmount;
+    return engine.Params().warmAmount;
 }
 
 float AudioProcessor::GetWarmTone() const {
-    return warmTone;
+    return engine.Params().warmTone;
 }
 
 float AudioProcessor::GetWarmSaturation() const {
-    return warmSaturation;
+    return engine.Params().warmSaturation;
 }
 
 void AudioProcessor::SetSampleRate(float rate) {
     sampleRate = rate;
+    engine.Prepare(rate, engine.MaxBlockFrames(), engine.Channels());
 }
 
 float AudioProcessor::GetMainVolume() const {
@@ -1085,78 +751,84 @@ float AudioProcessor::GetMainVolume() const {
 }
 
 float AudioProcessor::GetChorusDepth() const {
-    return chorusDepth;
+    return engine.Params().chorusDepth;
 }
 
 float AudioProcessor::GetChorusRate() const {
-    return chorusRate;
+    return engine.Params().chorusRate;
 }
 
 void AudioProcessor::SetBluesEnabled(bool enabled) {
-    bluesEnabled = enabled;
+    engine.SetParam(&EffectParams::bluesEnabled, enabled);
 }
 
 void AudioProcessor::SetBluesGain(float gain) {
-    bluesGain = gain;
+    engine.SetParam(&EffectParams::bluesGain, gain);
 }
 
 void AudioProcessor::SetBluesTone(float tone) {
-    bluesTone = fmaxf(0.0f, fminf(1.0f, tone));
+    engine.SetParam(&EffectParams::bluesTone, fmaxf(0.0f, fminf(1.0f, tone)));
 }
 
 void AudioProcessor::SetBluesLevel(float level) {
-    bluesLevel = fmaxf(0.0f, fminf(2.0f, level));
+    engine.SetParam(&EffectParams::bluesLevel, fmaxf(0.0f, fminf(2.0f, level)));
 }
 
 bool AudioProcessor::IsBluesEnabled() const {
-    return bluesEnabled;
+    return engine.Params().bluesEnabled;
 }
 
 float AudioProcessor::GetBluesGain() const {
-    return bluesGain;
+    return engine.Params().bluesGain;
 }
 
 float AudioProcessor::GetBluesTone() const {
-    return bluesTone;
+    return engine.Params().bluesTone;
 }
 
 float AudioProcessor::GetBluesLevel() const {
-    return bluesLevel;
+    return engine.Params().bluesLevel;
 }
 
-void AudioProcessor::SetReverbEnabled(bool enabled) { reverbEnabled = enabled; }
-void AudioProcessor::SetReverbSize(float size) { reverbSize = fmaxf(0.0f, fminf(1.0f, size)); }
-void AudioProcessor::SetReverbDamping(float damping) { reverbDamping = fmaxf(0.0f, fminf(1.0f, damping)); }
-void AudioProcessor::SetReverbWidth(float width) { reverbWidth = fmaxf(0.0f, fminf(1.0f, width)); }
-void AudioProcessor::SetReverbMix(float mix) { reverbMix = fmaxf(0.0f, fminf(1.0f, mix)); }
+void AudioProcessor::SetReverbEnabled(bool enabled) { engine.SetParam(&EffectParams::reverbEnabled, enabled); }
+void AudioProcessor::SetReverbSize(float size) { engine.SetParam(&EffectParams::reverbSize, fmaxf(0.0f, fminf(1.0f, size))); }
+void AudioProcessor::SetReverbDamping(float damping) { engine.SetParam(&EffectParams::reverbDamping, fmaxf(0.0f, fminf(1.0f, damping))); }
+void AudioProcessor::SetReverbWidth(float width) { engine.SetParam(&EffectParams::reverbWidth, fmaxf(0.0f, fminf(1.0f, width))); }
+void AudioProcessor::SetReverbMix(float mix) { engine.SetParam(&EffectParams::reverbMix, fmaxf(0.0f, fminf(1.0f, mix))); }
+
+// Only 1, 2 and 4 are supported; anything else snaps to the nearest lower one
+void AudioProcessor::SetReverbRateDivider(int divider) { engine.SetParam(&EffectParams::reverbRateDivider, (divider >= 4) ? 4 : (divider >= 2) ? 2 : 1); }
+int AudioProcessor::GetReverbRateDivider() const { return engine.Params().reverbRateDivider; }
+void AudioProcessor::SetChorusRateDivider(int divider) { engine.SetParam(&EffectParams::chorusRateDivider, (divider >= 4) ? 4 : (divider >= 2) ? 2 : 1); }
+int AudioProcessor::GetChorusRateDivider() const { return engine.Params().chorusRateDivider; }
 
-void AudioProcessor::SetCompressorEnabled(bool enabled) { compEnabled = enabled; }
-void AudioProcessor::SetCompressorLevel(float level) { compLevel = fmaxf(0.0f, fminf(2.0f, level)); }
-void AudioProcessor::SetCompressorTone(float tone) { compTone = fmaxf(0.0f, fminf(1.0f, tone)); }
-void AudioProcessor::SetCompressorAttack(float ms) { compAttackMs = fmaxf(0.1f, ms); }
-void AudioProcessor::SetCompressorSustain(float ms) { compSustainMs = fmaxf(1.0f, ms); }
+void AudioProcessor::SetCompressorEnabled(bool enabled) { engine.SetParam(&EffectParams::compEnabled, enabled); }
+void AudioProcessor::SetCompressorLevel(float level) { engine.SetParam(&EffectParams::compLevel, fmaxf(0.0f, fminf(2.0f, level))); }
+void AudioProcessor::SetCompressorTone(float tone) { engine.SetParam(&EffectParams::compTone, fmaxf(0.0f, fminf(1.0f, tone))); }
+void AudioProcessor::SetCompressorAttack(float ms) { engine.SetParam(&EffectParams::compAttackMs, fmaxf(0.1f, ms)); }
+void AudioProcessor::SetCompressorSustain(float ms) { engine.SetParam(&EffectParams::compSustainMs, fmaxf(1.0f, ms)); }
 
-void AudioProcessor::SetOverdriveEnabled(bool enabled) { overdriveEnabled = enabled; }
-void AudioProcessor::SetOverdriveDrive(float drive) { overdriveDrive = drive; }
-void AudioProcessor::SetOverdriveThreshold(float threshold) { overdriveThreshold = fmaxf(0.0f, fminf(1.0f, threshold)); }
-void AudioProcessor::SetOverdriveTone(float tone) { overdriveTone = fmaxf(0.0f, fminf(1.0f, tone)); }
-void AudioProcessor::SetOverdriveMix(float mix) { overdriveMix = fmaxf(0.0f, fminf(1.0f, mix)); }
+void AudioProcessor::SetOverdriveEnabled(bool enabled) { engine.SetParam(&EffectParams::overdriveEnabled, enabled); }
+void AudioProcessor::SetOverdriveDrive(float drive) { engine.SetParam(&EffectParams::overdriveDrive, drive); }
+void AudioProcessor::SetOverdriveThreshold(float threshold) { engine.SetParam(&EffectParams::overdriveThreshold, fmaxf(0.0f, fminf(1.0f, threshold))); }
+void AudioProcessor::SetOverdriveTone(float tone) { engine.SetParam(&EffectParams::overdriveTone, fmaxf(0.0f, fminf(1.0f, tone))); }
+void AudioProcessor::SetOverdriveMix(float mix) { engine.SetParam(&EffectParams::overdriveMix, fmaxf(0.0f, fminf(1.0f, mix))); }
 
 void AudioProcessor::SetMainVolume(float vol) { mainVolume = vol; }
 
-void AudioProcessor::SetChorusEnabled(bool enabled) { chorusEnabled = enabled; }
-void AudioProcessor::SetChorusRate(float rate) { chorusRate = rate; }
-void AudioProcessor::SetChorusDepth(float depth) { chorusDepth = depth; }
-void AudioProcessor::SetChorusFeedback(float feedback) { chorusFeedback = feedback; }
-void AudioProcessor::SetChorusWidth(float width) { chorusWidth = width; }
-bool AudioProcessor::IsChorusEnabled() const { return chorusEnabled; }
-
-void AudioProcessor::SetTremoloEnabled(bool enabled) { tremoloEnabled = enabled; }
-void AudioProcessor::SetTremoloRate(float rate) { tremoloRate = rate; }
-void AudioProcessor::SetTremoloDepth(float depth) { tremoloDepth = depth; }
-
-bool AudioProcessor::IsOverdriveEnabled() const { return overdriveEnabled; }
-float AudioProcessor::GetOverdriveDrive() const { return overdriveDrive; }
-float AudioProcessor::GetOverdriveThreshold() const { return overdriveThreshold; }
-float AudioProcessor::GetOverdriveTone() const { return overdriveTone; }
-float AudioProcessor::GetOverdriveMix() const { return overdriveMix; }
\ No newline at end of file
+void AudioProcessor::SetChorusEnabled(bool enabled) { engine.SetParam(&EffectParams::chorusEnabled, enabled); }
+void AudioProcessor::SetChorusRate(float rate) { engine.SetParam(&EffectParams::chorusRate, rate); }
+void AudioProcessor::SetChorusDepth(float depth) { engine.SetParam(&EffectParams::chorusDepth, depth); }
+void AudioProcessor::SetChorusFeedback(float feedback) { engine.SetParam(&EffectParams::chorusFeedback, feedback); }
+void AudioProcessor::SetChorusWidth(float width) { engine.SetParam(&EffectParams::chorusWidth, width); }
+bool AudioProcessor::IsChorusEnabled() const { return engine.Params().chorusEnabled; }
+
+void AudioProcessor::SetTremoloEnabled(bool enabled) { engine.SetParam(&EffectParams::tremoloEnabled, enabled); }
+void AudioProcessor::SetTremoloRate(float rate) { engine.SetParam(&EffectParams::tremoloRate, rate); }
+void AudioProcessor::SetTremoloDepth(float depth) { engine.SetParam(&EffectParams::tremoloDepth, depth); }
+
+bool AudioProcessor::IsOverdriveEnabled() const { return engine.Params().overdriveEnabled; }
+float AudioProcessor::GetOverdriveDrive() const { return engine.Params().overdriveDrive; }
+float AudioProcessor::GetOverdriveThreshold() const { return engine.Params().overdriveThreshold; }
+float AudioProcessor::GetOverdriveTone() const { return engine.Params().overdriveTone; }
+float AudioProcessor::GetOverdriveMix() const { return engine.Params().overdriveMix; }
\ No newline at end of file
@@ -8,6 +8,26 @@
 #include <string>
 #include <atomic>
 #include <mutex>
+#include <thread>
+#include "EffectEngine.h"
+#include "SampleFormat.h"
+#include "DriftCompensator.h"
+#include "LatencyProbe.h"
+#include "RealtimeThread.h"
+#include "StatsSegment.h"
+#include "SessionRecording.h"
+
+// Where the input-to-output delay comes from, in milliseconds
+struct LatencyReport {
+    double effectsMs = 0.0;   // algorithmic latency of the effect graph
+    double blockMs = 0.0;     // internal block FIFO
+    double bridgeMs = 0.0;    // drift bridge depth plus resampler look-ahead
+    double captureMs = 0.0;   // capture stream latency plus one device period
+    double renderMs = 0.0;    // render stream latency (plus queued audio when not bridged)
+    double totalMs = 0.0;
+    double requestedMs = 0.0; // target latency setting
+    double depthMs = 0.0;     // render depth actually negotiated for it
+};
 
 struct AudioDevice {
     std::wstring id;
@@ -15,68 +35,6 @@ struct AudioDevice {
     bool isCapture = false;
 };
 
-// Reverb filter structures
-struct ReverbComb {
-    std::vector<float> buffer;
-    int bufferSize;
-    int bufferIndex;
-    float feedback;
-    float filterStore;
-    float damp1, damp2;
-
-    ReverbComb() : bufferSize(0), bufferIndex(0), feedback(0), filterStore(0), damp1(0), damp2(0) {}
-
-    void setBuffer(int size) {
-        bufferSize = size;
-        buffer.assign(size, 0.0f);
-        bufferIndex = 0;
-    }
-
-    void setDamp(float val) {
-        damp1 = val;
-        damp2 = 1.0f - val;
-    }
-
-    void setFeedback(float val) {
-        feedback = val;
-    }
-
-    float process(float input) {
-        float output = buffer[bufferIndex];
-        filterStore = (output * damp2) + (filterStore * damp1);
-        buffer[bufferIndex] = input + (filterStore * feedback);
-        if (++bufferIndex >= bufferSize) bufferIndex = 0;
-        return output;
-    }
-};
-
-struct ReverbAllpass {
-    std::vector<float> buffer;
-    int bufferSize;
-    int bufferIndex;
-    float feedback;
-
-    ReverbAllpass() : bufferSize(0), bufferIndex(0), feedback(0) {}
-
-    void setBuffer(int size) {
-        bufferSize = size;
-        buffer.assign(size, 0.0f);
-        bufferIndex = 0;
-    }
-
-    void setFeedback(float val) {
-        feedback = val;
-    }
-
-    float process(float input) {
-        float bufout = buffer[bufferIndex];
-        float output = -input + bufout;
-        buffer[bufferIndex] = input + (bufout * feedback);
-        if (++bufferIndex >= bufferSize) bufferIndex = 0;
-        return output;
-    }
-};
-
 class AudioProcessor {
 private:
     IMMDeviceEnumerator* deviceEnumerator;
@@ -90,112 +48,72 @@ private:
     WAVEFORMATEX* renderFormat;
     UINT32 captureBufferFrames;
     UINT32 renderBufferFrames;
-    std::atomic<float> tremoloRate;
-    std::atomic<float> tremoloDepth;
-    std::atomic<bool> tremoloEnabled;
     std::atomic<bool> running;
-    float tremoloPhase;
-    float sampleRate = 44100.0f;
-
-    // Chorus parameters
-    bool chorusEnabled = false;
-    float chorusRate = 1.5f;
-    float chorusDepth = 0.02f;
-    float chorusFeedback = 0.3f;
-    float chorusWidth = 0.5f;
-    float chorusPhase = 0.0f;
-    std::vector<float> chorusDelayBuffer;
-    size_t chorusDelayIndex = 0;
 
+    // Owned audio worker. Stop() clears running, signals stopEvent (which
+    // also cuts the loop's idle waits short) and joins, so the COM objects
+    // are only released once the loop is gone.
+    std::thread audioThread;
+    HANDLE stopEvent;
+    float sampleRate = 44100.0f;
     std::atomic<float> mainVolume;
 
-    // Overdrive effect parameters
-    bool overdriveEnabled = false;
-    float overdriveDrive = 3.0f;
-    float overdriveThreshold = 0.3f;
-    float overdriveTone = 0.5f;
-    float overdriveMix = 0.8f;
-    float overdriveFilterState[2] = { 0.0f, 0.0f };
-
-    // Blues driver effect parameters
-    bool bluesEnabled = false;
-    float bluesGain = 1.5f;   // input gain
-    float bluesTone = 0.5f;   // 0..1 tone control
-    float bluesLevel = 0.8f;  // output level (0..1)
-    float bluesFilterState[2] = { 0.0f, 0.0f };
-
-    // Compressor / Sustainer parameters
-    bool compEnabled = false;
-    float compLevel = 1.0f;   // makeup gain (0..2)
-    float compTone = 0.5f;    // tone post-eq (0..1)
-    float compAttackMs = 10.0f; // attack in ms
-    float compSustainMs = 300.0f; // release/sustain in ms
-    float compEnv[2] = { 0.0f, 0.0f };
-    float compGainSmooth[2] = { 1.0f, 1.0f };
-    float compLowState[2] = { 0.0f, 0.0f };
-
-    // Reverb parameters
-    bool reverbEnabled = false;
-    float reverbSize = 0.5f;
-    float reverbDamping = 0.5f;
-    float reverbWidth = 1.0f;
-    float reverbMix = 0.3f;
-    bool reverbInitialized = false;
-
-    // Reverb filter arrays
-    ReverbComb reverbCombL[8], reverbCombR[8];
-    ReverbAllpass reverbAllpassL[4], reverbAllpassR[4];
-
-    // Warm effect parameters
-    bool warmEnabled = false;
-    float warmAmount = 0.5f;
-    float warmTone = 0.5f;
-    float warmSaturation = 0.3f;
-
-    // Warm effect filter states
-    float warmLowpassState[2] = { 0.0f, 0.0f };
-    float warmHighpassState[2] = { 0.0f, 0.0f };
-    float warmSaturatorState[2] = { 0.0f, 0.0f };
-
-    // Wah effect state variables
-    struct WahState {
-        float freq;           // Center frequency (Hz)
-        float q;              // Resonance/Q factor
-        float mix;            // Dry/wet mix (0-1)
-        float lfoRate;        // LFO rate for auto-wah (Hz)
-        float lfoDepth;       // LFO depth (0-1)
-        bool enabled;
-
-        // Filter state variables (biquad filter)
-        float z1L, z2L;       // Left channel state
-        float z1R, z2R;       // Right channel state
-
-        // LFO state
-        float lfoPhase;
-
-        // Envelope follower for dynamic wah (reacts to bends/slides)
-        float env;            // current envelope level (0..1)
-        float envAttackMs;    // attack time in ms
-        float envReleaseMs;   // release time in ms
-
-        WahState() : freq(800.0f), q(10.0f), mix(1.0f), 
-                     lfoRate(0.0f), lfoDepth(0.0f), enabled(false),
-                     z1L(0.0f), z2L(0.0f), z1R(0.0f), z2R(0.0f),
-                     lfoPhase(0.0f), env(0.0f), envAttackMs(5.0f), envReleaseMs(80.0f) {}
-    } wahState;
-
-    // Wah effect methods
-    void processWah(float* leftChannel, float* rightChannel, int numSamples);
-    void updateWahCoefficients(float centerFreq, float sampleRate);
-    void resetWahState();
-
-    // Biquad filter coefficients for wah
-    struct BiquadCoeffs {
-        float b0, b1, b2;  // Numerator coefficients
-        float a1, a2;      // Denominator coefficients (a0 is normalized to 1)
-
-        BiquadCoeffs() : b0(1.0f), b1(0.0f), b2(0.0f), a1(0.0f), a2(0.0f) {}
-    } wahCoeffs;
+    // Device sample layouts; anything but float32 on both sides (with equal
+    // channel counts and rates) goes through the float scratch buffers
+    SampleFormat captureSampleFormat;
+    SampleFormat renderSampleFormat;
+    std::vector<float> captureScratch;
+    std::vector<float> renderScratch;
+    TpdfDither dither;
+
+    // Capture and render run on separate clocks (and maybe rates); the
+    // bridge resamples into a FIFO whose depth a PI loop holds on target
+    DriftCompensator clockBridge;
+    Resampler::Quality resamplerQuality;
+    bool driftCompensation;
+    bool bridged;
+    std::vector<float> bridgeScratch;
+    MemoryLocks scratchLocks;   // the three scratch buffers above
+
+    // Device buffering, measured in SetupAudio / the audio loop
+    double captureStreamMs;
+    double renderStreamMs;
+    double devicePeriodMs;
+    std::atomic<UINT32> renderQueuedFrames;
+    LatencyProbe latencyProbe;
+
+    // Render-side depth asked for, and what the device periods allowed
+    float targetLatencyMs;
+    UINT32 renderDepthFrames;
+
+    // Scheduling of the audio thread, applied when it starts
+    RealtimeOptions realtimeOptions;
+
+    // Live statistics for external monitors (StatsSegment.h). Gathered by the
+    // audio thread over a window and published by it when the window closes.
+    struct StatsWindow {
+        uint64_t startNs = 0;
+        uint64_t busyNs = 0;
+        uint64_t effectNs[kLiveStatsEffects] = {};
+        float inputPeak = 0.0f;
+        float outputPeak = 0.0f;
+        double inputSquares = 0.0;
+        double outputSquares = 0.0;
+        uint64_t inputSamples = 0;
+        uint64_t outputSamples = 0;
+    };
+    StatsPublisher statsPublisher;
+    LiveStats liveStats;
+    StatsWindow statsWindow;
+    uint64_t statsGlitches;   // capture discontinuities and render starvation
+    double statsLatencyMs;    // expected latency, taken when the stream starts
+
+    // Effect chain, routing and preset switching
+    EffectEngine engine;
+
+    // Session capture for offline replay (SessionRecording.h)
+    SessionRecorder sessionRecorder;
+    std::string sessionPath;
 
 public:
     AudioProcessor();
@@ -203,17 +121,63 @@ public:
     HRESULT Initialize();
     std::vector<AudioDevice> EnumerateDevices();
     HRESULT SetupAudio(const std::wstring& captureDeviceId);
-    void ApplyTremolo(float* buffer, UINT32 numFrames);
-    void ApplyChorus(float* buffer, UINT32 numFrames);
-    void ApplyOverdrive(float* buffer, UINT32 numFrames);
-    void ApplyReverb(float* buffer, UINT32 numFrames);
-    void ApplyWarm(float* buffer, UINT32 numFrames);
-    void ApplyBluesDriver(float* buffer, UINT32 numFrames);
-    void ApplyCompressor(float* buffer, UINT32 numFrames);
     void SetSampleRate(float rate);
     void AudioLoop();
     void StartProcessing(const std::wstring& deviceId);
     void Stop();
+
+    // Effect order; returns false if the graph uses an effect more than once
+    bool SetEffectGraph(const EffectGraphDesc& desc);
+    EffectGraphDesc GetEffectGraph() const;
+
+    // Presets: a snapshot of every effect setting. Applying one crossfades to
+    // a freshly built chain while the old chain's tails ring out.
+    EffectParams CapturePreset() const;
+    void ApplyPreset(const EffectParams& preset);
+    void SetPresetCrossfadeMs(float ms);
+    float GetPresetCrossfadeMs() const;
+
+    // Frames per internal processing block (0 = process each device packet)
+    void SetBlockSize(UINT32 frames);
+    UINT32 GetBlockSize() const;
+
+    // Capture/render rate conversion. Quality applies from the next
+    // StartProcessing; latency is 0 when the devices aren't bridged.
+    void SetResamplerQuality(Resampler::Quality quality);
+    Resampler::Quality GetResamplerQuality() const;
+    double GetResamplerLatencyMs() const;
+
+    // Clock drift compensation between the capture and render devices (on
+    // by default; applies from the next StartProcessing). Rates that differ
+    // are always bridged. Without it, equal-format devices take the zero-copy path.
+    void SetDriftCompensation(bool enabled);
+    bool IsDriftCompensationEnabled() const;
+    DriftStats GetDriftStats() const;
+
+    // Audio kept queued ahead of the render device, e.g. 3, 5 or 10 ms.
+    // Picks the device periods and buffer depth from the next StartProcessing.
+    void SetTargetLatencyMs(float ms);
+    float GetTargetLatencyMs() const;
+
+    // Expected input-to-output latency, from the pieces that make it up
+    LatencyReport GetLatencyReport() const;
+    // Plays an MLS burst and times its return through the effects. Needs the
+    // output looped back into the input (cable, or the amp miked up); blocks
+    // for up to timeoutMs while processing is running.
+    LatencyMeasurement MeasureLatency(DWORD timeoutMs = 5000);
+
+    // Audio thread scheduling, from the next StartProcessing: MMCSS "Pro
+    // Audio" (on by default) and an optional core to pin it to (-1 = any)
+    void SetRealtimePriority(bool enabled);
+    bool IsRealtimePriorityEnabled() const;
+    void SetAudioThreadCpu(int cpu);
+    int GetAudioThreadCpu() const;
+
+    // Records every stream to path (empty: off), for replay with --replay.
+    // Each StartProcessing resets the effects and starts the file over.
+    void SetSessionRecording(const std::string& path);
+    bool IsSessionRecording() const;
+
     void SetTremoloEnabled(bool enabled);
     void SetTremoloRate(float rate);
     void SetTremoloDepth(float depth);
@@ -258,6 +222,12 @@ public:
     void SetReverbWidth(float width);
     void SetReverbMix(float mix);
 
+    // Multirate: run reverb / chorus at half or quarter of the device rate
+    void SetReverbRateDivider(int divider);
+    int GetReverbRateDivider() const;
+    void SetChorusRateDivider(int divider);
+    int GetChorusRateDivider() const;
+
     // Warm effect methods
     void SetWarmEnabled(bool enabled);
     void SetWarmAmount(float amount);
@@ -265,23 +235,23 @@ public:
     void SetWarmSaturation(float saturation);
 
     // Wah effect methods
-    void setWahEnabled(bool enabled) { wahState.enabled = enabled; }
-    bool getWahEnabled() const { return wahState.enabled; }
+    void setWahEnabled(bool enabled) { engine.SetParam(&EffectParams::wahEnabled, enabled); }
+    bool getWahEnabled() const { return engine.Params().wahEnabled; }
 
-    void setWahFrequency(float freq) { wahState.freq = freq; }
-    float getWahFrequency() const { return wahState.freq; }
+    void setWahFrequency(float freq) { engine.SetParam(&EffectParams::wahFreq, freq); }
+    float getWahFrequency() const { return engine.Params().wahFreq; }
 
-    void setWahQ(float q) { wahState.q = q; }
-    float getWahQ() const { return wahState.q; }
+    void setWahQ(float q) { engine.SetParam(&EffectParams::wahQ, q); }
+    float getWahQ() const { return engine.Params().wahQ; }
 
-    void setWahMix(float mix) { wahState.mix = clamp(mix, 0.0f, 1.0f); }
-    float getWahMix() const { return wahState.mix; }
+    void setWahMix(float mix) { engine.SetParam(&EffectParams::wahMix, clamp(mix, 0.0f, 1.0f)); }
+    float getWahMix() const { return engine.Params().wahMix; }
 
-    void setWahLFORate(float rate) { wahState.lfoRate = rate; }
-    float getWahLFORate() const { return wahState.lfoRate; }
+    void setWahLFORate(float rate) { engine.SetParam(&EffectParams::wahLfoRate, rate); }
+    float getWahLFORate() const { return engine.Params().wahLfoRate; }
 
-    void setWahLFODepth(float depth) { wahState.lfoDepth = clamp(depth, 0.0f, 1.0f); }
-    float getWahLFODepth() const { return wahState.lfoDepth; }
+    void setWahLFODepth(float depth) { engine.SetParam(&EffectParams::wahLfoDepth, clamp(depth, 0.0f, 1.0f)); }
+    float getWahLFODepth() const { return engine.Params().wahLfoDepth; }
 
     float GetMainVolume() const;
     bool IsChorusEnabled() const;
@@ -312,6 +282,13 @@ public:
     void Reset();
 private:
     void Cleanup();
+    const float* ProcessConverted(const BYTE* captureData, UINT32 numFrames);
+    HRESULT RenderFromBridge();
+    HRESULT InitializeStream(IAudioClient* client, WAVEFORMATEX* format, UINT32& periodFrames);
+    HRESULT PrefillRender();
+    void BeginStats();
+    void CountPacket(uint64_t startNs, UINT32 numFrames);
+    void PublishStats(uint64_t nowNs, bool force);
 
     // Helper function to clamp values
     template<typename T>
@@ -0,0 +1,89 @@
+#include "Benchmark.h"
+#include "SampleFormat.h"
+#include "Resampler.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const int kRate = 48000;
+const int kChannels = 2;
+const size_t kSamples = (size_t)kRate * kChannels;  // one second
+const int kRepeats = 50;
+
+template<typename Fn>
+double SecondsPerRun(Fn run) {
+    run();  // warm caches and page in the buffers
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRepeats; ++i) run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / kRepeats;
+}
+
+void Report(const char* name, double seconds) {
+    printf("  %-28s %7.3f ns/sample  %9.0fx real time\n",
+        name, seconds * 1e9 / kSamples, 1.0 / seconds);
+}
+
+void BenchmarkSampleFormats() {
+    printf("Sample format conversion (%d Hz, %d channels)\n", kRate, kChannels);
+    std::vector<float> signal(kSamples), decoded(kSamples);
+    std::vector<unsigned char> encoded(kSamples * 4);
+    for (size_t i = 0; i < kSamples; ++i) {
+        signal[i] = 0.8f * sinf(0.01f * (float)i);
+    }
+
+    const SampleFormat formats[] = { SampleFormat::Int16, SampleFormat::Int24,
+        SampleFormat::Int24In32, SampleFormat::Int32, SampleFormat::Float32 };
+    char name[64];
+    for (SampleFormat format : formats) {
+        TpdfDither dither;
+        snprintf(name, sizeof(name), "%s -> float", SampleFormatName(format));
+        ConvertFromFloat(format, signal.data(), encoded.data(), kSamples);
+        Report(name, SecondsPerRun([&] {
+            ConvertToFloat(format, encoded.data(), decoded.data(), kSamples);
+        }));
+        snprintf(name, sizeof(name), "float -> %s", SampleFormatName(format));
+        Report(name, SecondsPerRun([&] {
+            ConvertFromFloat(format, signal.data(), encoded.data(), kSamples);
+        }));
+        snprintf(name, sizeof(name), "float -> %s (dither)", SampleFormatName(format));
+        Report(name, SecondsPerRun([&] {
+            ConvertFromFloat(format, signal.data(), encoded.data(), kSamples, &dither);
+        }));
+    }
+}
+
+void BenchmarkResampler() {
+    printf("Resampler 48000 -> 44100 Hz, %d channels, 256-frame blocks\n", kChannels);
+    const uint32_t block = 256;
+    std::vector<float> signal(kSamples), output(kSamples);
+    for (size_t i = 0; i < kSamples; ++i) {
+        signal[i] = 0.8f * sinf(0.01f * (float)i);
+    }
+    const char* names[] = { "low", "medium", "high" };
+    const Resampler::Quality qualities[] = { Resampler::Quality::Low,
+        Resampler::Quality::Medium, Resampler::Quality::High };
+    char name[64];
+    for (int q = 0; q < 3; ++q) {
+        Resampler resampler;
+        resampler.Prepare(kRate, 44100.0, kChannels, qualities[q], block);
+        snprintf(name, sizeof(name), "%s (%.2f ms latency)", names[q], resampler.LatencyMs());
+        Report(name, SecondsPerRun([&] {
+            for (size_t frame = 0; frame + block <= (size_t)kRate; frame += block) {
+                resampler.Process(&signal[frame * kChannels], block, output.data(),
+                    resampler.MaxOutputFrames(block));
+            }
+        }));
+    }
+}
+
+} // namespace
+
+int RunBenchmarks() {
+    BenchmarkSampleFormats();
+    BenchmarkResampler();
+    return 0;
+}
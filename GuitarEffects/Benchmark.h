@@ -0,0 +1,5 @@
+#pragma once
+
+// Console micro-benchmarks (GuitarEffects --bench). Prints per-sample cost
+// and how many times faster than real time each stage runs at 48 kHz stereo.
+int RunBenchmarks();
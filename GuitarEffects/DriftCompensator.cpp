@@ -0,0 +1,132 @@
+#include "DriftCompensator.h"
+#include "RealtimeThread.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+
+// Loop gains, with the depth error measured in seconds. The depth error
+// obeys e'' + Kp e' + Ki e = 0, so these give a natural frequency of 0.5
+// rad/s with 0.9 damping: a skew of several hundred ppm locks in about 5 s
+// with no real overshoot. One millisecond of depth jitter moves the ratio
+// by under 1000 ppm (under 2 cents), far below audibility.
+const double kProportional = 0.9;
+const double kIntegral = 0.25;
+// Depth is measured once per capture packet, so it jitters by a packet or
+// so; this averages it before the controller sees it. Kept well inside the
+// loop's time constant so it adds little phase lag.
+const double kSmoothingSeconds = 0.25;
+// Correction limit; real crystals are within a few hundred ppm
+const double kMaxAdjust = 0.002;
+
+} // namespace
+
+DriftCompensator::DriftCompensator() : inputRate(48000.0), outputRate(48000.0), channels(0),
+capacity(0), readPos(0), writePos(0), count(0),
+target(0.0), smoothed(0.0), integral(0.0), adjust(1.0),
+statBuffered(0.0), statPpm(0.0), statUnderruns(0), statOverruns(0) {
+}
+
+void DriftCompensator::Prepare(double inRate, double outRate, int numChannels,
+    Resampler::Quality quality, uint32_t maxInputFrames, uint32_t targetFrames) {
+    memoryLocks.Release();
+    inputRate = inRate;
+    outputRate = outRate;
+    channels = numChannels;
+    resampler.Prepare(inRate, outRate, numChannels, quality, maxInputFrames);
+    uint32_t maxOutput = resampler.MaxOutputFrames(maxInputFrames);
+    resampled.assign((size_t)maxOutput * numChannels, 0.0f);
+    target = targetFrames;
+    // Target depth, a burst of capture packets and the same again for slack
+    capacity = 2 * (targetFrames + maxOutput) + 1;
+    ring.assign((size_t)capacity * numChannels, 0.0f);
+    memoryLocks.Lock(resampled);
+    memoryLocks.Lock(ring);
+    Reset();
+}
+
+// Starts with the target depth already buffered (as silence), so the
+// controller begins on target rather than pulling the ratio to fill up
+void DriftCompensator::Reset() {
+    resampler.Reset();
+    std::fill(ring.begin(), ring.end(), 0.0f);
+    readPos = 0;
+    count = (uint32_t)target;
+    writePos = count;
+    smoothed = target;
+    integral = 0.0;
+    adjust = 1.0;
+    resampler.SetRatioAdjust(adjust);
+    statBuffered = smoothed;
+    statPpm = 0.0;
+    statUnderruns = 0;
+    statOverruns = 0;
+}
+
+void DriftCompensator::Write(const float* in, uint32_t numFrames, uint32_t downstreamFrames) {
+    if (channels <= 0) return;
+    uint32_t produced = resampler.Process(in, numFrames, resampled.data(),
+        (uint32_t)(resampled.size() / channels));
+    Push(resampled.data(), produced);
+    UpdateController(numFrames, downstreamFrames);
+}
+
+void DriftCompensator::Push(const float* in, uint32_t numFrames) {
+    if (numFrames > capacity - count) {
+        statOverruns.fetch_add(1, std::memory_order_relaxed);
+        numFrames = capacity - count;
+    }
+    uint32_t first = std::min(numFrames, capacity - writePos);
+    memcpy(&ring[(size_t)writePos * channels], in, (size_t)first * channels * sizeof(float));
+    memcpy(&ring[0], in + (size_t)first * channels, (size_t)(numFrames - first) * channels * sizeof(float));
+    writePos = (writePos + numFrames) % capacity;
+    count += numFrames;
+}
+
+uint32_t DriftCompensator::Read(float* out, uint32_t numFrames) {
+    if (channels <= 0) return 0;
+    uint32_t frames = std::min(numFrames, count);
+    uint32_t first = std::min(frames, capacity - readPos);
+    memcpy(out, &ring[(size_t)readPos * channels], (size_t)first * channels * sizeof(float));
+    memcpy(out + (size_t)first * channels, &ring[0], (size_t)(frames - first) * channels * sizeof(float));
+    readPos = (readPos + frames) % capacity;
+    count -= frames;
+    if (frames < numFrames) {
+        statUnderruns.fetch_add(1, std::memory_order_relaxed);
+        memset(out + (size_t)frames * channels, 0, (size_t)(numFrames - frames) * channels * sizeof(float));
+    }
+    return frames;
+}
+
+void DriftCompensator::UpdateController(uint32_t inputFrames, uint32_t downstreamFrames) {
+    const double dt = inputFrames / inputRate;
+    const double measured = (double)count + downstreamFrames;
+    smoothed += (measured - smoothed) * (1.0 - exp(-dt / kSmoothingSeconds));
+
+    // Too much buffered: consume input faster (ratio above 1) to drain it
+    const double error = (smoothed - target) / outputRate;
+    double next = 1.0 + kProportional * error + kIntegral * (integral + error * dt);
+    if (fabs(next - 1.0) < kMaxAdjust) {
+        integral += error * dt;  // no wind-up while clamped
+    }
+    adjust = std::max(1.0 - kMaxAdjust, std::min(1.0 + kMaxAdjust, next));
+    resampler.SetRatioAdjust(adjust);
+
+    statBuffered.store(smoothed, std::memory_order_relaxed);
+    statPpm.store((adjust - 1.0) * 1e6, std::memory_order_relaxed);
+}
+
+DriftStats DriftCompensator::GetStats() const {
+    DriftStats stats;
+    stats.bufferedFrames = statBuffered.load(std::memory_order_relaxed);
+    stats.targetFrames = target;
+    stats.ratioPpm = statPpm.load(std::memory_order_relaxed);
+    stats.underruns = statUnderruns.load(std::memory_order_relaxed);
+    stats.overruns = statOverruns.load(std::memory_order_relaxed);
+    return stats;
+}
+
+double DriftCompensator::LatencyMs() const {
+    return target * 1000.0 / outputRate + resampler.LatencyMs();
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include "Resampler.h"
+#include "RealtimeThread.h"
+
+// Fill/ratio telemetry, safe to read from any thread
+struct DriftStats {
+    double bufferedFrames = 0.0;  // smoothed FIFO fill plus device queue
+    double targetFrames = 0.0;
+    double ratioPpm = 0.0;        // current correction, + means consuming faster
+    uint64_t underruns = 0;       // render asked for more than the FIFO held
+    uint64_t overruns = 0;        // capture data dropped because the FIFO was full
+};
+
+// Bridges two devices running on independent clocks. Capture audio is
+// resampled into a FIFO at the render rate, and the render side drains it.
+// A PI controller trims the resampling ratio so that the FIFO plus whatever
+// the render device has queued stays at a target depth, instead of slowly
+// drifting into underruns or ever-growing latency.
+//
+// Write() and Read() run on the audio thread; Prepare() allocates, they don't.
+class DriftCompensator {
+public:
+    DriftCompensator();
+
+    void Prepare(double inputRate, double outputRate, int channels, Resampler::Quality quality,
+        uint32_t maxInputFrames, uint32_t targetFrames);
+    void Reset();
+
+    // Capture side. downstreamFrames is what the render device already has
+    // queued (its padding); it counts towards the controlled depth.
+    void Write(const float* in, uint32_t numFrames, uint32_t downstreamFrames);
+
+    // Render side. Fills numFrames, zero-filling past what the FIFO holds,
+    // and returns how many came from the FIFO.
+    uint32_t Read(float* out, uint32_t numFrames);
+    uint32_t Available() const { return count; }
+
+    DriftStats GetStats() const;
+    double LatencyMs() const;         // target depth plus resampler look-ahead
+    double ResamplerLatencyMs() const { return resampler.LatencyMs(); }
+
+private:
+    void Push(const float* in, uint32_t numFrames);
+    void UpdateController(uint32_t inputFrames, uint32_t downstreamFrames);
+
+    Resampler resampler;
+    std::vector<float> resampled;
+    double inputRate;
+    double outputRate;
+    int channels;
+
+    // FIFO at the render rate, interleaved
+    std::vector<float> ring;
+    uint32_t capacity;
+    uint32_t readPos;
+    uint32_t writePos;
+    uint32_t count;
+
+    // Controller state
+    double target;
+    double smoothed;
+    double integral;
+    double adjust;
+
+    std::atomic<double> statBuffered;
+    std::atomic<double> statPpm;
+    std::atomic<uint64_t> statUnderruns;
+    std::atomic<uint64_t> statOverruns;
+    MemoryLocks memoryLocks;    // resampled and ring
+};
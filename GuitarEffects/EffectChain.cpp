@@ -0,0 +1,1140 @@
+#include "EffectChain.h"
+#include "RealtimeThread.h"
+#include "Trace.h"
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+// Constants
+const float PI = 3.14159265358979323846f;
+const float WAH_FREQ_MIN = 200.0f;   // Minimum wah frequency
+const float WAH_FREQ_MAX = 3000.0f;  // Maximum wah frequency
+const int kChorusMaxDelayMs = 40;
+const float kSilenceThreshold = 1e-6f;  // -120 dBFS
+
+// Trace point names, indexed by EffectId
+static const char* const kEffectTraceNames[] = {
+    "Tremolo", "Chorus", "BluesDriver", "Overdrive", "Compressor", "Reverb", "Warm", "Wah"
+};
+static_assert(sizeof(kEffectTraceNames) / sizeof(kEffectTraceNames[0]) == (size_t)EffectId::Count,
+    "every effect needs a trace name");
+
+// Charges an effect's processing time to its counter, and records it as a
+// trace event from the same two clock reads
+class EffectTimer {
+public:
+    EffectTimer(uint64_t& counter, const char* traceName, uint32_t numFrames) :
+        total(counter), name(traceName), frames(numFrames), start(TraceNowNs()) {}
+    ~EffectTimer() {
+        const uint64_t end = TraceNowNs();
+        total += end - start;
+#ifndef TRACE_DISABLED
+        TraceComplete(name, start, end, frames);
+#endif
+    }
+
+private:
+    uint64_t& total;
+    const char* name;
+    uint32_t frames;
+    uint64_t start;
+};
+
+static bool IsBlockSilent(const float* buffer, size_t samples) {
+    for (size_t i = 0; i < samples; ++i) {
+        if (fabsf(buffer[i]) >= kSilenceThreshold) return false;
+    }
+    return true;
+}
+
+EffectChain::EffectChain() : sampleRate(44100.0f), channels(0), maxBlockFrames(0), tremoloPhase(0.0f) {
+}
+
+void EffectChain::Prepare(float rate, uint32_t maxBlock, int numChannels) {
+    sampleRate = rate;
+    channels = numChannels;
+    maxBlockFrames = maxBlock;
+    if (channels <= 0) return;
+    memoryLocks.Release();
+
+    compCoefAttackMs = compCoefSustainMs = -1.0f;
+    compEnv.assign(channels, 0.0f);
+    compGainSmooth.assign(channels, 1.0f);
+    compLowState.assign(channels, 0.0f);
+    wahLeft.assign(maxBlock, 0.0f);
+    wahRight.assign(maxBlock, 0.0f);
+
+    // Delay lines are allocated for the full rate, the largest they get, and
+    // locked at that size. Switching the rate divider later only
+    // re-initialises them in place.
+    if (channels >= 2) InitReverb(1);
+    else reverbInitialized = false;
+    InitChorus(1);
+    LockMemory();
+    if (channels >= 2 && params.reverbRateDivider != 1) InitReverb(params.reverbRateDivider);
+    const int chorusFactor = (channels <= kMaxMultirateChannels) ? params.chorusRateDivider : 1;
+    if (chorusFactor != 1) InitChorus(chorusFactor);
+}
+
+// Everything the audio thread touches, made resident before it gets there
+void EffectChain::LockMemory() {
+    memoryLocks.Lock(this, sizeof(*this));
+    for (int i = 0; i < 8; ++i) {
+        memoryLocks.Lock(reverbCombL[i].buffer);
+        memoryLocks.Lock(reverbCombR[i].buffer);
+    }
+    for (int i = 0; i < 4; ++i) {
+        memoryLocks.Lock(reverbAllpassL[i].buffer);
+        memoryLocks.Lock(reverbAllpassR[i].buffer);
+    }
+    memoryLocks.Lock(chorusDelayBuffer);
+    memoryLocks.Lock(compEnv);
+    memoryLocks.Lock(compGainSmooth);
+    memoryLocks.Lock(compLowState);
+    memoryLocks.Lock(wahLeft);
+    memoryLocks.Lock(wahRight);
+}
+
+void EffectChain::InitReverb(int factor) {
+    // Comb filter delays (in samples at 44.1kHz)
+    int combTunings[8] = { 1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617 };
+    // Allpass filter delays
+    int allpassTunings[4] = { 556, 441, 341, 225 };
+
+    // Scale delays for the rate the reverb runs at
+    float scaleFactor = (this->sampleRate / factor) / 44100.0f;
+
+    for (int i = 0; i < 8; i++) {
+        reverbCombL[i].setBuffer((int)(combTunings[i] * scaleFactor));
+        reverbCombR[i].setBuffer((int)(combTunings[i] * scaleFactor * 1.1f)); // Slight offset for stereo
+    }
+
+    for (int i = 0; i < 4; i++) {
+        reverbAllpassL[i].setBuffer((int)(allpassTunings[i] * scaleFactor));
+        reverbAllpassR[i].setBuffer((int)(allpassTunings[i] * scaleFactor * 1.1f));
+        reverbAllpassL[i].setFeedback(0.5f);
+        reverbAllpassR[i].setFeedback(0.5f);
+    }
+
+    reverbDown.setFactor(factor);
+    reverbUpL.setFactor(factor);
+    reverbUpR.setFactor(factor);
+    reverbInitDivider = factor;
+
+    int longest = 0;
+    for (int i = 0; i < 8; i++) longest = (reverbCombR[i].bufferSize > longest) ? reverbCombR[i].bufferSize : longest;
+    for (int i = 0; i < 4; i++) longest += reverbAllpassR[i].bufferSize;
+    reverbTailFrames = (uint32_t)(longest * factor + MultirateLatency(factor));
+    reverbInitialized = true;
+}
+
+void EffectChain::InitChorus(int factor) {
+    const float rate = this->sampleRate / factor;
+    const int maxDelaySamples = static_cast<int>((rate * kChorusMaxDelayMs) / 1000.0f);
+    chorusDelayBuffer.assign(maxDelaySamples * channels, 0.0f);
+    chorusDelayIndex = 0;
+    for (int ch = 0; ch < channels && ch < kMaxMultirateChannels; ++ch) {
+        chorusDown[ch].setFactor(factor);
+        chorusUp[ch].setFactor(factor);
+    }
+    chorusActiveDivider = factor;
+}
+
+void EffectChain::ApplyTremolo(const float* in, float* out, uint32_t numFrames, float postGain) {
+    if (!params.tremoloEnabled || channels <= 0) {
+        PassThrough(in, out, numFrames, postGain);
+        return;
+    }
+    float rate = params.tremoloRate;
+    float depth = params.tremoloDepth;
+    for (uint32_t i = 0; i < numFrames; i++) {
+        float tremolo = 1.0f + depth * sinf(tremoloPhase);
+        for (int ch = 0; ch < (int)channels; ch++) {
+            out[i * channels + ch] = in[i * channels + ch] * tremolo * postGain;
+        }
+        tremoloPhase += 2.0f * PI * rate / this->sampleRate;
+        if (tremoloPhase > 2.0f * PI) {
+            tremoloPhase -= 2.0f * PI;
+        }
+    }
+}
+
+void EffectChain::ApplyChorus(const float* in, float* out, uint32_t numFrames, float postGain) {
+    if (!params.chorusEnabled || channels <= 0) {
+        PassThrough(in, out, numFrames, postGain);
+        return;
+    }
+    // Per-channel resamplers are only kept for the first kMaxMultirateChannels
+    const int factor = (channels <= kMaxMultirateChannels) ? params.chorusRateDivider : 1;
+    const float rate = this->sampleRate / factor;
+    // The resampler round trip is part of the wet path, take it off the base delay
+    const float baseDelayMs = 15.0f - (MultirateLatency(factor) * 1000.0f) / this->sampleRate;
+    const float modDepthMs = 10.0f * params.chorusDepth;
+    const float lfoRate = params.chorusRate;
+    const float feedback = params.chorusFeedback;
+    const float width = params.chorusWidth;
+    const float wetMix = 0.5f;
+    const float dryMix = 1.0f - wetMix;
+    if (chorusDelayBuffer.empty()) {
+        PassThrough(in, out, numFrames, postGain); // Prepare() not run
+        return;
+    }
+    // Divider changed: fits in the storage Prepare() sized for the full rate
+    if (factor != chorusActiveDivider) {
+        InitChorus(factor);
+    }
+    const size_t delaySize = chorusDelayBuffer.size();
+    float phase = chorusPhase;
+
+    // One delay line read/write at the chorus rate
+    auto tap = [&](int ch, float input) -> float {
+        float channelPhase = phase + (float)ch * width * PI;
+        float lfo = 0.6f * sinf(channelPhase) + 0.4f * sinf(channelPhase * 1.5f);
+        float delayMs = baseDelayMs + modDepthMs * lfo;
+        float delaySamples = (rate * delayMs) / 1000.0f;
+        float readPos = (float)chorusDelayIndex - delaySamples;
+        while (readPos < 0) readPos += (float)delaySize / channels;
+        size_t idxA = ((size_t)readPos) * channels + ch;
+        size_t idxB = (idxA + channels);
+        if (idxB >= delaySize) idxB -= delaySize;
+        float frac = readPos - floorf(readPos);
+        float sampleA = chorusDelayBuffer[idxA % delaySize];
+        float sampleB = chorusDelayBuffer[idxB % delaySize];
+        float wet = sampleA * (1.0f - frac) + sampleB * frac;
+        size_t writeIdx = (chorusDelayIndex * channels + ch);
+        chorusDelayBuffer[writeIdx % delaySize] = input + wet * feedback;
+        return wet;
+    };
+
+    for (uint32_t i = 0; i < numFrames; ++i) {
+        bool tick = false; // a chorus-rate frame was processed
+        for (int ch = 0; ch < channels; ++ch) {
+            size_t bufIdx = i * channels + ch;
+            float dry = in[bufIdx];
+            float wet;
+            if (factor == 1) {
+                wet = tap(ch, dry);
+                tick = true;
+            }
+            else {
+                float low;
+                if (chorusDown[ch].process(dry, low)) {
+                    chorusUp[ch].push(tap(ch, low));
+                    tick = true;
+                }
+                wet = chorusUp[ch].pop();
+            }
+            out[bufIdx] = (dryMix * dry + wetMix * wet) * postGain;
+        }
+        if (tick) {
+            phase += 2.0f * PI * lfoRate / rate;
+            if (phase > 2.0f * PI) phase -= 2.0f * PI;
+            chorusDelayIndex++;
+            if (chorusDelayIndex * channels >= delaySize) chorusDelayIndex = 0;
+        }
+    }
+    chorusPhase = phase;
+}
+
+void EffectChain::ApplyOverdrive(const float* in, float* out, uint32_t numFrames, float postGain) {
+    if (!params.overdriveEnabled || channels <= 0) {
+        PassThrough(in, out, numFrames, postGain);
+        return;
+    }
+
+    const float drive = params.overdriveDrive;        // 1.0f to 10.0f+ (input gain)
+    const float threshold = params.overdriveThreshold; // 0.1f to 0.9f (where overdrive kicks in)
+    const float tone = params.overdriveTone;          // 0.0f to 1.0f (tone control)
+    const float wetMix = params.overdriveMix;         // 0.0f to 1.0f (dry/wet blend)
+    const float dryMix = 1.0f - wetMix;
+
+    // Calculate dynamic parameters based on threshold
+    // Lower threshold = more aggressive overdrive and better compensation
+    const float sensitivity = 1.0f - threshold;  // 0.0 to 0.9
+    const float outputGain = 1.0f + (sensitivity * 2.0f); // Compensate volume loss
+    const float saturationAmount = 1.5f + (sensitivity * 3.0f); // More saturation at lower thresholds
+
+    // Pre-emphasis filter for bite (boosts mids before overdrive)
+    const float preEmphasisGain = 1.0f + (sensitivity * 0.8f);
+
+    // Tone shaping parameters
+    const float bassRolloff = 0.3f + (tone * 0.4f); // More bass cut with higher tone
+    const float trebleBoost = 1.0f + (tone * 1.5f); // More treble with higher tone
+
+    for (uint32_t i = 0; i < numFrames; ++i) {
+        for (int ch = 0; ch < channels; ++ch) {
+            size_t bufIdx = i * channels + ch;
+            float input = in[bufIdx];
+
+            // Stage 1: Input gain and pre-emphasis
+            float signal = input * drive * preEmphasisGain;
+
+            // Stage 2: Asymmetric tube-style overdrive
+            float overdriven;
+            float absSignal = fabsf(signal);
+
+            if (absSignal <= threshold) {
+                // Clean region - slight compression for punch
+                overdriven = signal * (1.0f + (absSignal / threshold) * 0.3f);
+            }
+            else {
+                // Overdrive region - progressive saturation
+                float excess = absSignal - threshold;
+                float normalizedExcess = excess / (1.0f - threshold + 0.001f); // Avoid division by zero
+
+                // Asymmetric clipping (different curves for positive/negative)
+                if (signal > 0.0f) {
+                    // Positive half - harder clipping
+                    float saturation = 1.0f - expf(-normalizedExcess * saturationAmount);
+                    overdriven = threshold + (saturation * (1.0f - threshold) * 0.85f);
+                }
+                else {
+                    // Negative half - softer clipping for asymmetry
+                    float saturation = 1.0f - expf(-normalizedExcess * saturationAmount * 0.8f);
+                    overdriven = -(threshold + (saturation * (1.0f - threshold) * 0.75f));
+                }
+
+                // Add harmonic content for aggression
+                float harmonicContent = signal * absSignal * 0.15f * sensitivity;
+                overdriven += harmonicContent;
+            }
+
+            // Stage 3: Tone shaping (simulates amp tone stack)
+            float toneProcessed = overdriven;
+
+            // Simple bass/treble adjustment
+            if (ch < 2) { // Only process first two channels for filter state
+                // High-pass filter for bass rolloff
+                float bassFiltered = overdriven * bassRolloff +
+                    overdriveFilterState[ch] * (1.0f - bassRolloff);
+                overdriveFilterState[ch] = bassFiltered;
+
+                // Treble emphasis
+                toneProcessed = bassFiltered + (overdriven - bassFiltered) * trebleBoost;
+            }
+
+            // Stage 4: Output processing
+            // Soft limiting to prevent harsh clipping
+            if (fabsf(toneProcessed) > 0.9f) {
+                float sign = (toneProcessed > 0.0f) ? 1.0f : -1.0f;
+                float compressed = 0.9f + (fabsf(toneProcessed) - 0.9f) * 0.1f;
+                toneProcessed = sign * fminf(compressed, 0.98f);
+            }
+
+            // Apply output gain compensation
+            toneProcessed *= outputGain;
+
+            // Final mix
+            out[bufIdx] = (dryMix * input + wetMix * toneProcessed) * postGain;
+        }
+    }
+}
+
+void EffectChain::ApplyReverb(const float* in, float* out, uint32_t numFrames, float postGain) {
+    if (!params.reverbEnabled || channels <= 0) {
+        PassThrough(in, out, numFrames, postGain);
+        return;
+    }
+
+    if (channels < 2 || !reverbInitialized) {
+        // Reverb requires stereo (and Prepare() having run)
+        PassThrough(in, out, numFrames, postGain);
+        return;
+    }
+
+    // Divider changed: fits in the storage Prepare() sized for the full rate
+    const int factor = params.reverbRateDivider;
+    if (factor != reverbInitDivider) {
+        InitReverb(factor);
+    }
+
+    // Update reverb parameters (only when they changed, blocks can be short)
+    if (params.reverbSize != reverbAppliedSize || params.reverbDamping != reverbAppliedDamping) {
+        float roomSize = params.reverbSize * 0.28f + 0.7f;
+        float damping = params.reverbDamping * 0.4f;
+
+        for (int i = 0; i < 8; i++) {
+            reverbCombL[i].setFeedback(roomSize);
+            reverbCombR[i].setFeedback(roomSize);
+            reverbCombL[i].setDamp(damping);
+            reverbCombR[i].setDamp(damping);
+        }
+        reverbAppliedSize = params.reverbSize;
+        reverbAppliedDamping = params.reverbDamping;
+    }
+
+    reverbCleared = false;
+    const float wetGain = params.reverbMix * 3.0f;
+    const float dryGain = 1.0f - params.reverbMix;
+    const float width = params.reverbWidth;
+
+    for (uint32_t i = 0; i < numFrames; i++) {
+        float inputL = in[i * channels];
+        float inputR = in[i * channels + 1];
+
+        // Mix input to mono for reverb processing
+        float input = (inputL + inputR) * 0.015f; // Scale down input
+
+        float allpassOutputL, allpassOutputR;
+        float lowInput;
+        if (reverbDown.process(input, lowInput)) {
+            // Process through comb filters
+            float combOutputL = 0.0f, combOutputR = 0.0f;
+
+            for (int c = 0; c < 8; c++) {
+                combOutputL += reverbCombL[c].process(lowInput);
+                combOutputR += reverbCombR[c].process(lowInput);
+            }
+
+            // Process through allpass filters
+            allpassOutputL = combOutputL;
+            allpassOutputR = combOutputR;
+
+            for (int a = 0; a < 4; a++) {
+                allpassOutputL = reverbAllpassL[a].process(allpassOutputL);
+                allpassOutputR = reverbAllpassR[a].process(allpassOutputR);
+            }
+
+            reverbUpL.push(allpassOutputL);
+            reverbUpR.push(allpassOutputR);
+        }
+        allpassOutputL = reverbUpL.pop();
+        allpassOutputR = reverbUpR.pop();
+
+        // Apply stereo width
+        float reverbL = allpassOutputL * (1.0f + width) * 0.5f + allpassOutputR * (1.0f - width) * 0.5f;
+        float reverbR = allpassOutputR * (1.0f + width) * 0.5f + allpassOutputL * (1.0f - width) * 0.5f;
+
+        // Mix dry and wet signals
+        out[i * channels] = (inputL * dryGain + reverbL * wetGain) * postGain;
+        out[i * channels + 1] = (inputR * dryGain + reverbR * wetGain) * postGain;
+
+        // Copy to additional channels if present
+        for (int ch = 2; ch < channels; ch++) {
+            out[i * channels + ch] = out[i * channels + (ch % 2)];
+        }
+    }
+}
+
+void EffectChain::ApplyWarm(const float* in, float* out, uint32_t numFrames, float postGain) {
+    if (!params.warmEnabled || channels <= 0) {
+        PassThrough(in, out, numFrames, postGain);
+        return;
+    }
+
+    const float amount = params.warmAmount;
+    const float tone = params.warmTone;
+    const float saturation = params.warmSaturation;
+
+    // Make the effect more pronounced
+    const float wetMix = amount;  // Use full amount for wet mix
+    const float dryMix = 1.0f - wetMix;
+
+    // More aggressive parameters for audible effect
+    const float compressThreshold = 0.2f; // Lower threshold for more compression
+    const float compressRatio = 0.3f + (amount * 0.4f); // Variable compression
+    const float saturationDrive = 1.0f + (saturation * 3.0f); // More drive
+    const float harmonicAmount = saturation * 0.5f; // More prominent harmonics
+
+    // Frequency shaping - more pronounced
+    const float bassBoost = 1.0f + (1.0f - tone) * 0.8f; // Boost bass when tone is low
+    const float trebleRoll = 1.0f - (tone * 0.3f); // Roll off highs when tone is high
+    const float midWarmth = 1.0f + amount * 0.4f; // Mid frequency warmth
+
+    for (uint32_t i = 0; i < numFrames; ++i) {
+        for (int ch = 0; ch < channels && ch < 2; ++ch) {
+            size_t bufIdx = i * channels + ch;
+            float input = in[bufIdx];
+            float processed = input;
+
+            // Stage 1: Pre-emphasis and bass boost
+            processed *= bassBoost;
+
+            // Stage 2: Soft compression for glue
+            float absSignal = fabsf(processed);
+            if (absSignal > compressThreshold) {
+                float excess = absSignal - compressThreshold;
+                float compressed = compressThreshold + excess * compressRatio;
+                processed = (processed > 0.0f) ? compressed : -compressed;
+            }
+
+            // Stage 3: Tube-style saturation (more aggressive)
+            float driven = processed * saturationDrive;
+            float saturated;
+
+            if (fabsf(driven) <= 1.0f) {
+                // Polynomial saturation for warmth
+                float x = driven;
+                float x2 = x * x;
+                float x3 = x2 * x;
+                saturated = x - (x3 * 0.33f) + (x2 * harmonicAmount * 0.1f);
+            }
+            else {
+                // Hard limiting with soft knee
+                float sign = (driven > 0.0f) ? 1.0f : -1.0f;
+                float magnitude = fabsf(driven);
+                saturated = sign * (1.0f - expf(-(magnitude - 1.0f) * 0.5f));
+            }
+
+            // Scale back down
+            saturated *= 0.7f;
+
+            // Stage 4: Add even harmonics for tube warmth
+            if (harmonicAmount > 0.01f) {
+                float harmonic2 = saturated * saturated * harmonicAmount * 0.15f;
+                float harmonic3 = saturated * saturated * saturated * harmonicAmount * 0.05f;
+                saturated += harmonic2 + harmonic3;
+            }
+
+            // Stage 5: Tone shaping and mid warmth
+            saturated *= midWarmth;
+
+            // Simple high-frequency roll-off for smoothness
+            warmLowpassState[ch] += 0.3f * (saturated * trebleRoll - warmLowpassState[ch]);
+            float toneProcessed = warmLowpassState[ch];
+
+            // Stage 6: Output gain compensation
+            toneProcessed *= (0.8f + amount * 0.4f); // Compensate for level changes
+
+            // Final limiting
+            if (fabsf(toneProcessed) > 0.95f) {
+                float sign = (toneProcessed > 0.0f) ? 1.0f : -1.0f;
+                toneProcessed = sign * 0.95f;
+            }
+
+            // Mix with original signal
+            out[bufIdx] = (dryMix * input + wetMix * toneProcessed) * postGain;
+        }
+
+        // Copy to additional channels
+        for (int ch = 2; ch < channels; ch++) {
+            out[i * channels + ch] = out[i * channels + (ch % 2)];
+        }
+    }
+}
+
+void EffectChain::ApplyBluesDriver(const float* in, float* out, uint32_t numFrames, float postGain) {
+    if (!params.bluesEnabled || channels <= 0) {
+        PassThrough(in, out, numFrames, postGain);
+        return;
+    }
+
+    // Thorny blues parameters - more aggressive and edgy
+    const float inputGain = params.bluesGain * 1.8f; // More input drive for harder clipping
+    const float preDistortionBoost = 1.4f; // Pre-emphasis for bite
+
+    // Asymmetric clipping for that "broken" blues sound
+    const float softThreshold = 0.3f;
+    const float hardThreshold = 0.65f;
+
+    // Tone shaping - scooped mids with enhanced highs for sparkle
+    const float bassPresence = 1.2f + (1.0f - params.bluesTone) * 0.5f;
+    const float midScoop = 0.6f + params.bluesTone * 0.2f; // Slight scoop
+    const float trebleBoost = 1.5f + params.bluesTone * 1.0f; // Lots of high-end bite
+    const float presenceFreq = 0.15f; // High-mid presence
+
+    // Harmonic generation for grit
+    const float harmonicDrive = 0.3f;
+
+    for (uint32_t i = 0; i < numFrames; ++i) {
+        for (int ch = 0; ch < channels; ++ch) {
+            size_t idx = i * channels + ch;
+            float input = in[idx];
+
+            // Stage 1: Pre-emphasis boost for attack
+            float signal = input * inputGain * preDistortionBoost;
+
+            // Stage 2: Asymmetric hard clipping (diode-like behavior)
+            float clipped;
+            float absSignal = fabsf(signal);
+
+            if (absSignal < softThreshold) {
+                // Clean region with slight compression
+                clipped = signal * (1.0f + absSignal * 0.2f);
+            }
+            else if (absSignal < hardThreshold) {
+                // Soft saturation region
+                float excess = (absSignal - softThreshold) / (hardThreshold - softThreshold);
+                float curve = excess - (excess * excess * excess * 0.33f);
+                float sat = softThreshold + curve * (hardThreshold - softThreshold);
+                clipped = (signal > 0.0f) ? sat : -sat;
+            }
+            else {
+                // Hard clipping region - asymmetric!
+                float excess = absSignal - hardThreshold;
+                if (signal > 0.0f) {
+                    // Positive: harder clipping (more compression)
+                    float hardSat = hardThreshold + (1.0f - hardThreshold) * (1.0f - expf(-excess * 2.0f));
+                    clipped = fminf(hardSat, 0.95f);
+                }
+                else {
+                    // Negative: softer clipping (more dynamics)
+                    float softSat = hardThreshold + (1.0f - hardThreshold) * (1.0f - expf(-excess * 1.2f));
+                    clipped = -fminf(softSat, 0.90f);
+                }
+            }
+
+            // Stage 3: Add even and odd harmonics for thorny character
+            float x2 = clipped * clipped;
+            float x3 = x2 * clipped;
+            float harmonics = (x2 * harmonicDrive * 0.15f) + // 2nd harmonic (warmth)
+                (x3 * harmonicDrive * 0.25f);   // 3rd harmonic (grit)
+            clipped += harmonics;
+
+            // Stage 4: Tone stack (Marshall-inspired with more bite)
+            // Use simple filters stored in bluesFilterState[0] = low, [1] = high
+            int filterIdx = ch % 2;
+
+            // Low-shelf for bass
+            float lowTarget = clipped * bassPresence;
+            bluesFilterState[filterIdx] += 0.08f * (lowTarget - bluesFilterState[filterIdx]);
+            float bass = bluesFilterState[filterIdx];
+
+            // High-shelf for treble and presence
+            float highpass = clipped - bass;
+            float treble = highpass * trebleBoost;
+
+            // Mid calculation with scoop
+            float mid = (clipped - bass * 0.5f - highpass * 0.5f) * midScoop;
+
+            // Presence boost (upper mids) - the "thorn"
+            float presence = highpass * presenceFreq * 2.5f;
+
+            // Mix tone components
+            float toneMixed = bass * 0.35f + mid * 0.25f + treble * 0.3f + presence * 0.1f;
+
+            // Stage 5: Final soft limiting to prevent harshness
+            float output = toneMixed;
+            float absOut = fabsf(output);
+            if (absOut > 0.85f) {
+                float sign = (output > 0.0f) ? 1.0f : -1.0f;
+                float limited = 0.85f + (absOut - 0.85f) * 0.3f;
+                output = sign * fminf(limited, 0.98f);
+            }
+
+            // Apply output level with slight boost to compensate
+            out[idx] = output * params.bluesLevel * 1.1f * postGain;
+        }
+    }
+}
+
+// --- Compressor implementation ---
+void EffectChain::ApplyCompressor(const float* in, float* out, uint32_t numFrames, float postGain) {
+    if (!params.compEnabled || channels <= 0) {
+        PassThrough(in, out, numFrames, postGain);
+        return;
+    }
+    if (compEnv.size() != (size_t)channels) {
+        PassThrough(in, out, numFrames, postGain); // Prepare() not run
+        return;
+    }
+
+    // Advanced envelope coefficients with adaptive behavior. They only depend
+    // on the attack/sustain settings, so they're recomputed when those change.
+    float sustainFactor = params.compSustainMs / 1000.0f;
+    if (params.compAttackMs != compCoefAttackMs || params.compSustainMs != compCoefSustainMs) {
+        float attackSec = fmaxf(0.1f, params.compAttackMs) / 1000.0f;
+        float releaseSec = fmaxf(10.0f, params.compSustainMs) / 1000.0f;
+        compAttackCoef = expf(-1.0f / (attackSec * this->sampleRate));
+        // Sustain enhancement - slower release for longer notes
+        compReleaseCoef = expf(-1.0f / ((releaseSec * (1.0f + sustainFactor * 2.0f)) * this->sampleRate));
+        compCoefAttackMs = params.compAttackMs;
+        compCoefSustainMs = params.compSustainMs;
+    }
+    const float attackCoef = compAttackCoef;
+    const float adaptiveReleaseCoef = compReleaseCoef;
+
+    // Sustainer-specific parameters
+    const float threshold = 0.15f; // Lower threshold for more sustain
+    const float ratio = 8.0f; // High ratio for strong compression
+    const float kneeWidth = 0.1f; // Soft knee for smooth compression
+    const float makeupGain = 2.5f; // Boost output to compensate
+
+    for (uint32_t i = 0; i < numFrames; ++i) {
+        for (int ch = 0; ch < channels; ++ch) {
+            size_t idx = i * channels + ch;
+            float x = in[idx];
+            float absx = fabsf(x);
+
+            // --- Stage 1: Peak detection with attack/release ---
+            float env = compEnv[ch];
+            if (absx > env) {
+                // Attack phase - fast response to peaks
+                env = attackCoef * env + (1.0f - attackCoef) * absx;
+            }
+            else {
+                // Release phase - use adaptive release for sustain
+                env = adaptiveReleaseCoef * env + (1.0f - adaptiveReleaseCoef) * absx;
+            }
+            compEnv[ch] = env;
+
+            // --- Stage 2: Compute gain reduction with soft knee ---
+            float gain = 1.0f;
+
+            if (env > threshold - kneeWidth && env < threshold + kneeWidth) {
+                // Soft knee region - smooth transition
+                float kneeInput = env - threshold + kneeWidth;
+                float kneeOutput = kneeInput * kneeInput / (4.0f * kneeWidth);
+                float dbOver = 20.0f * log10f((threshold + kneeOutput) / threshold + 1e-20f);
+                float dbReduce = dbOver - dbOver / ratio;
+                gain = powf(10.0f, -dbReduce / 20.0f);
+            }
+            else if (env >= threshold + kneeWidth) {
+                // Above knee - full compression
+                float dbOver = 20.0f * log10f(env / threshold + 1e-20f);
+                float dbReduce = dbOver - dbOver / ratio;
+                gain = powf(10.0f, -dbReduce / 20.0f);
+            }
+            // else: below knee, gain = 1.0f (no compression)
+
+            // --- Stage 3: Smooth gain to prevent zipper noise ---
+            float smooth = compGainSmooth[ch];
+            float smoothCoef = 0.001f; // Very smooth for sustain
+            smooth = smooth * (1.0f - smoothCoef) + gain * smoothCoef;
+            compGainSmooth[ch] = smooth;
+
+            // --- Stage 4: Apply compression and makeup gain ---
+            float compressed = x * smooth * makeupGain * params.compLevel;
+
+            // --- Stage 5: Sustain enhancement - add subtle harmonics ---
+            // This helps maintain presence during long sustains
+            float harmonic = compressed * fabsf(compressed) * 0.08f * sustainFactor;
+            compressed += harmonic;
+
+            // --- Stage 6: Advanced tone control ---
+            // Simulate amp-like tone stack
+            float low = compLowState[ch];
+            low += 0.03f * (compressed - low); // Low shelf
+            compLowState[ch] = low;
+
+            float high = compressed - low; // High shelf
+
+            // Tone control: 0 = warm (more lows), 1 = bright (more highs)
+            float midBoost = 1.0f + (1.0f - fabsf(params.compTone - 0.5f) * 2.0f) * 0.3f; // Mid emphasis
+            float toneBalance = params.compTone;
+
+            float output = (low * (1.0f - toneBalance) * 1.2f +  // Bass boost when tone is low
+                compressed * midBoost * 0.4f +          // Mids always present
+                high * toneBalance * 1.5f);             // Treble boost when tone is high
+
+            // --- Stage 7: Soft limiting to prevent clipping ---
+            float absOut = fabsf(output);
+            if (absOut > 0.9f) {
+                float sign = (output > 0.0f) ? 1.0f : -1.0f;
+                float limited = 0.9f + (absOut - 0.9f) * 0.1f;
+                output = sign * fminf(limited, 0.98f);
+            }
+
+            out[idx] = output * postGain;
+        }
+    }
+}
+
+// One sample of the wah's sweep, shared by processWah and SkipEffect so a
+// skipped wah moves exactly as a processed one would
+void EffectChain::stepWahSweep(float envMod, float lfoIncrement, float& smoothFreq, float& lastUpdatedFreq) {
+    // LFO value
+    float lfoValue = 0.0f;
+    if (params.wahLfoRate > 0.0f && params.wahLfoDepth > 0.0f) {
+        // use sine LFO for smoothness
+        lfoValue = 0.5f * (1.0f + sinf(wahState.lfoPhase)); // 0..1
+        wahState.lfoPhase += lfoIncrement;
+        if (wahState.lfoPhase >= 2.0f * PI) wahState.lfoPhase -= 2.0f * PI;
+    }
+
+    // Combine envelope and LFO to determine target frequency
+    float envInfluence = envMod * params.wahLfoDepth; // envelope scaled by LFO depth param
+    float lfoInfluence = lfoValue * params.wahLfoDepth;
+    float combined = (envInfluence + lfoInfluence) / fmaxf(0.0001f, (params.wahLfoDepth + params.wahLfoDepth));
+    // If lfoDepth is zero, fall back to envelope only
+    if (params.wahLfoDepth <= 0.0001f) combined = envMod;
+
+    float targetFreq = WAH_FREQ_MIN + combined * (WAH_FREQ_MAX - WAH_FREQ_MIN);
+    // Mix with manual freq setting (manual has some weight)
+    targetFreq = (targetFreq * 0.9f) + (params.wahFreq * 0.1f);
+
+    // Smooth frequency to avoid zipper noise
+    const float smoothFactor = 0.08f; // smoothing for freq changes
+    smoothFreq += (targetFreq - smoothFreq) * smoothFactor;
+
+    // Update coefficients if change significant
+    if (fabsf(smoothFreq - lastUpdatedFreq) > 1.0f) {
+        updateWahCoefficients(smoothFreq, this->sampleRate);
+        lastUpdatedFreq = smoothFreq;
+    }
+}
+
+// Wah effect processing
+void EffectChain::processWah(float* leftChannel, float* rightChannel, int numSamples) {
+    if (!params.wahEnabled || channels <= 0) {
+        return;
+    }
+
+    const float sr = this->sampleRate;
+    const float lfoIncrement = (2.0f * PI * params.wahLfoRate) / sr;
+
+    // Envelope attack/release coefficients
+    float attackCoef = expf(-1.0f / (fmaxf(0.001f, wahState.envAttackMs) * 0.001f * sr));
+    float releaseCoef = expf(-1.0f / (fmaxf(1.0f, wahState.envReleaseMs) * 0.001f * sr));
+
+    // Keep track of last center frequency to smooth coefficient updates
+    if (wahState.smoothFreq < 0.0f) wahState.smoothFreq = params.wahFreq;
+    float smoothFreq = wahState.smoothFreq;
+    float lastUpdatedFreq = wahState.lastUpdatedFreq;
+
+    for (int i = 0; i < numSamples; ++i) {
+        // Calculate instantaneous input level (RMS-ish using abs average)
+        float inL = leftChannel[i];
+        float inR = rightChannel[i];
+        float level = (fabsf(inL) + fabsf(inR)) * 0.5f;
+
+        // Update envelope follower (attack/release)
+        if (level > wahState.env) {
+            wahState.env = attackCoef * wahState.env + (1.0f - attackCoef) * level;
+        } else {
+            wahState.env = releaseCoef * wahState.env + (1.0f - releaseCoef) * level;
+        }
+
+        // Compute modulation amount from envelope (scale 0..1)
+        float envMod = fminf(1.0f, wahState.env * 3.0f); // scale up sensitivity
+
+        // Sweep the filter: LFO, target frequency, smoothing, coefficients
+        stepWahSweep(envMod, lfoIncrement, smoothFreq, lastUpdatedFreq);
+
+        // Process left channel sample with biquad difference eq (Direct Form 2 Transposed variant used variables z1/z2 as states)
+        float inSampleL = inL;
+        float outL = wahCoeffs.b0 * inSampleL + wahCoeffs.b1 * wahState.z1L + wahCoeffs.b2 * wahState.z2L - wahCoeffs.a1 * wahState.z1L - wahCoeffs.a2 * wahState.z2L;
+        wahState.z2L = wahState.z1L;
+        wahState.z1L = outL;
+
+        float inSampleR = inR;
+        float outR = wahCoeffs.b0 * inSampleR + wahCoeffs.b1 * wahState.z1R + wahCoeffs.b2 * wahState.z2R - wahCoeffs.a1 * wahState.z1R - wahCoeffs.a2 * wahState.z2R;
+        wahState.z2R = wahState.z1R;
+        wahState.z1R = outR;
+
+        // Mix dry/wet
+        leftChannel[i] = inSampleL * (1.0f - params.wahMix) + outL * params.wahMix;
+        rightChannel[i] = inSampleR * (1.0f - params.wahMix) + outR * params.wahMix;
+    }
+    wahState.smoothFreq = smoothFreq;
+    wahState.lastUpdatedFreq = lastUpdatedFreq;
+}
+
+void EffectChain::updateWahCoefficients(float centerFreq, float sampleRate) {
+    // Bandpass filter using RBJ cookbook formula
+    float omega = 2.0f * PI * centerFreq / sampleRate;
+    float sinOmega = std::sin(omega);
+    float cosOmega = std::cos(omega);
+    float alpha = sinOmega / (2.0f * params.wahQ);
+
+    float a0 = 1.0f + alpha;
+
+    // Bandpass filter coefficients (constant 0 dB peak gain)
+    wahCoeffs.b0 = alpha / a0;
+    wahCoeffs.b1 = 0.0f;
+    wahCoeffs.b2 = -alpha / a0;
+    wahCoeffs.a1 = -2.0f * cosOmega / a0;
+    wahCoeffs.a2 = (1.0f - alpha) / a0;
+}
+
+// Interleaved wrapper around processWah (left/right, extra channels copied)
+void EffectChain::ApplyWah(const float* in, float* out, uint32_t numFrames, float postGain) {
+    if (!params.wahEnabled || channels < 2 || maxBlockFrames == 0) {
+        PassThrough(in, out, numFrames, postGain);
+        return;
+    }
+    for (uint32_t offset = 0; offset < numFrames; offset += maxBlockFrames) {
+        uint32_t frames = (numFrames - offset < maxBlockFrames) ? numFrames - offset : maxBlockFrames;
+        const float* src = in + (size_t)offset * channels;
+        float* dst = out + (size_t)offset * channels;
+        for (uint32_t f = 0; f < frames; ++f) {
+            wahLeft[f] = src[f * channels];
+            wahRight[f] = src[f * channels + 1];
+        }
+        // processWah updates wahLeft and wahRight in-place
+        processWah(wahLeft.data(), wahRight.data(), (int)frames);
+        for (uint32_t f = 0; f < frames; ++f) {
+            dst[f * channels] = wahLeft[f] * postGain;
+            dst[f * channels + 1] = wahRight[f] * postGain;
+            // copy to additional channels if present
+            for (int ch = 2; ch < channels; ++ch) {
+                dst[f * channels + ch] = dst[f * channels + (ch % 2)];
+            }
+        }
+    }
+}
+
+// out = in * gain, skipped entirely when that's a no-op
+void EffectChain::PassThrough(const float* in, float* out, uint32_t numFrames, float gain) {
+    if (!in || !out || channels <= 0 || (in == out && gain == 1.0f)) return;
+    const size_t samples = (size_t)numFrames * channels;
+    if (gain == 1.0f) {
+        memmove(out, in, samples * sizeof(float));
+        return;
+    }
+    for (size_t i = 0; i < samples; ++i) out[i] = in[i] * gain;
+}
+
+bool EffectChain::RunEffect(EffectId effect, const float* in, float* out, uint32_t numFrames, float gain) {
+    const int index = (int)effect;
+    if (!IsEnabled(effect) || !in || !out) {
+        silentFrames[index] = 0;
+        return false;
+    }
+    EffectTimer timer(effectTimeNs[index], kEffectTraceNames[index], numFrames);
+
+    // Once input and output have been silent for longer than the effect's
+    // tail (and its filter state has decayed), processing it would only
+    // produce more silence. Skip it until signal comes back.
+    const size_t samples = (size_t)numFrames * channels;
+    const bool inputSilent = IsBlockSilent(in, samples);
+    if (inputSilent && silentFrames[index] > TailFrames(effect) && StateSilent(effect)) {
+        SkipEffect(effect, numFrames);
+        PassThrough(in, out, numFrames, gain);
+        return true;
+    }
+
+    switch (effect) {
+    case EffectId::Tremolo: ApplyTremolo(in, out, numFrames, gain); break;
+    case EffectId::Chorus: ApplyChorus(in, out, numFrames, gain); break;
+    case EffectId::BluesDriver: ApplyBluesDriver(in, out, numFrames, gain); break;
+    case EffectId::Overdrive: ApplyOverdrive(in, out, numFrames, gain); break;
+    case EffectId::Compressor: ApplyCompressor(in, out, numFrames, gain); break;
+    case EffectId::Reverb: ApplyReverb(in, out, numFrames, gain); break;
+    case EffectId::Warm: ApplyWarm(in, out, numFrames, gain); break;
+    case EffectId::Wah: ApplyWah(in, out, numFrames, gain); break;
+    default: break;
+    }
+
+    if (inputSilent && IsBlockSilent(out, samples)) {
+        uint32_t count = silentFrames[index];
+        silentFrames[index] = (count > UINT32_MAX - numFrames) ? UINT32_MAX : count + numFrames;
+    }
+    else {
+        silentFrames[index] = 0;
+    }
+    return true;
+}
+
+void EffectChain::TakeEffectTimes(uint64_t* ns) {
+    for (int i = 0; i < (int)EffectId::Count; ++i) {
+        ns[i] += effectTimeNs[i];
+        effectTimeNs[i] = 0;
+    }
+}
+
+bool EffectChain::IsIdle(EffectId effect) const {
+    return IsEnabled(effect) && silentFrames[(int)effect] > TailFrames(effect) && StateSilent(effect);
+}
+
+bool EffectChain::IsEnabled(EffectId effect) const {
+    switch (effect) {
+    case EffectId::Tremolo: return params.tremoloEnabled;
+    case EffectId::Chorus: return params.chorusEnabled;
+    case EffectId::BluesDriver: return params.bluesEnabled;
+    case EffectId::Overdrive: return params.overdriveEnabled;
+    case EffectId::Compressor: return params.compEnabled;
+    case EffectId::Reverb: return params.reverbEnabled;
+    case EffectId::Warm: return params.warmEnabled;
+    case EffectId::Wah: return params.wahEnabled;
+    default: return false;
+    }
+}
+
+// How long an effect can keep producing output after its input went silent
+// Every kernel is sample-by-sample on its dry path. The multirate filters
+// only delay wet signals: chorus takes their delay out of its base delay and
+// for reverb it just adds to the pre-delay, so nothing here adds latency yet.
+// A look-ahead or linear-phase effect would report it here.
+uint32_t EffectChain::LatencyFrames(EffectId) const {
+    return 0;
+}
+
+uint32_t EffectChain::TailFrames(EffectId effect) const {
+    switch (effect) {
+    case EffectId::Reverb:
+        return reverbTailFrames;
+    case EffectId::Chorus:
+        if (channels <= 0) return 0;
+        return (uint32_t)(chorusDelayBuffer.size() / channels) * chorusActiveDivider + MultirateLatency(chorusActiveDivider);
+    default:
+        // Everything else only has one-pole/biquad state, covered by StateSilent
+        return 0;
+    }
+}
+
+bool EffectChain::StateSilent(EffectId effect) const {
+    auto below = [](const float* state, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            if (fabsf(state[i]) >= kSilenceThreshold) return false;
+        }
+        return true;
+    };
+    switch (effect) {
+    case EffectId::Overdrive: return below(overdriveFilterState, 2);
+    case EffectId::BluesDriver: return below(bluesFilterState, 2);
+    case EffectId::Compressor: {
+        // The gain smoother rests at unity once the envelope is below the knee
+        for (float gain : compGainSmooth) {
+            if (fabsf(gain - 1.0f) >= kSilenceThreshold) return false;
+        }
+        return below(compEnv.data(), compEnv.size()) && below(compLowState.data(), compLowState.size());
+    }
+    case EffectId::Warm:
+        return below(warmLowpassState, 2) && below(warmHighpassState, 2) && below(warmSaturatorState, 2);
+    case EffectId::Wah: {
+        const float state[5] = { wahState.z1L, wahState.z2L, wahState.z1R, wahState.z2R, wahState.env };
+        return below(state, 5);
+    }
+    case EffectId::Reverb:
+        for (int i = 0; i < 8; i++) {
+            if (fabsf(reverbCombL[i].filterStore) >= kSilenceThreshold ||
+                fabsf(reverbCombR[i].filterStore) >= kSilenceThreshold) return false;
+        }
+        return true;
+    default:
+        return true;
+    }
+}
+
+// Keep the LFOs running while an effect is skipped, so it comes back at the
+// same phase it would have had if it had been processed. The phases are
+// stepped exactly as the kernels step them: a closed-form advance rounds
+// differently, and then the output would depend on where the packet
+// boundaries fell when the skip started and stopped.
+void EffectChain::SkipEffect(EffectId effect, uint32_t numFrames) {
+    const float twoPi = 2.0f * PI;
+    switch (effect) {
+    case EffectId::Tremolo: {
+        const float increment = 2.0f * PI * params.tremoloRate / this->sampleRate;
+        for (uint32_t i = 0; i < numFrames; ++i) {
+            tremoloPhase += increment;
+            if (tremoloPhase > twoPi) tremoloPhase -= twoPi;
+        }
+        break;
+    }
+    case EffectId::Chorus: {
+        if (chorusDelayBuffer.empty() || channels <= 0) break;
+        const int factor = (channels <= kMaxMultirateChannels) ? params.chorusRateDivider : 1;
+        if (factor != chorusActiveDivider) InitChorus(factor);
+        // The resamplers run in lockstep, so channel 0 says how many
+        // chorus-rate frames this packet would have produced
+        int ticks = (int)numFrames;
+        for (int ch = 0; ch < channels && ch < kMaxMultirateChannels; ++ch) {
+            ticks = chorusDown[ch].skip((int)numFrames);
+            chorusUp[ch].reset();
+        }
+        const float increment = 2.0f * PI * params.chorusRate / (this->sampleRate / factor);
+        for (int i = 0; i < ticks; ++i) {
+            chorusPhase += increment;
+            if (chorusPhase > twoPi) chorusPhase -= twoPi;
+        }
+        const size_t delayFrames = chorusDelayBuffer.size() / channels;
+        chorusDelayIndex = (chorusDelayIndex + ticks) % delayFrames;
+        break;
+    }
+    case EffectId::Reverb: {
+        if (channels < 2 || !reverbInitialized) break;
+        const int factor = params.reverbRateDivider;
+        if (factor != reverbInitDivider) InitReverb(factor);
+        // Whatever is left below the silence threshold would sit frozen
+        // through the skip and come back at an offset that depends on where
+        // it started; cleared, every split resumes from the same state
+        if (!reverbCleared) {
+            for (int i = 0; i < 8; i++) {
+                reverbCombL[i].clear();
+                reverbCombR[i].clear();
+            }
+            for (int i = 0; i < 4; i++) {
+                reverbAllpassL[i].clear();
+                reverbAllpassR[i].clear();
+            }
+            reverbCleared = true;
+        }
+        // Keeps the decimation phase where processing would have left it
+        reverbDown.skip((int)numFrames);
+        reverbUpL.reset();
+        reverbUpR.reset();
+        break;
+    }
+    case EffectId::Wah: {
+        // What is left in the filter is below the silence threshold; cleared,
+        // it resumes from the same state however the skip was split. The
+        // sweep keeps moving as it would with no input: with the LFO, the
+        // smoothed frequency and its coefficient updates follow it.
+        wahState.z1L = wahState.z2L = wahState.z1R = wahState.z2R = 0.0f;
+        wahState.env = 0.0f;
+        if (wahState.smoothFreq < 0.0f) wahState.smoothFreq = params.wahFreq;
+        const float lfoIncrement = (2.0f * PI * params.wahLfoRate) / this->sampleRate;
+        for (uint32_t i = 0; i < numFrames; ++i) {
+            stepWahSweep(0.0f, lfoIncrement, wahState.smoothFreq, wahState.lastUpdatedFreq);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// Index of the last op that writes the main buffer, which gets the output
+// gain folded in; -1 if no enabled effect touches it
+int EffectChain::FinalMainOp(const EffectGraph& graph) const {
+    const std::vector<EffectGraph::Op>& ops = graph.Ops();
+    for (int i = (int)ops.size() - 1; i >= 0; --i) {
+        const EffectGraph::Op& op = ops[i];
+        if (op.kind == EffectGraph::Op::Scale || op.kind == EffectGraph::Op::Accumulate) return i;
+        if (op.kind == EffectGraph::Op::Run && op.slot == 0 && IsEnabled(op.effect)) return i;
+    }
+    return -1;
+}
+
+void EffectChain::Process(EffectGraph& graph, const float* in, float* out, uint32_t numFrames, float gain) {
+    if (channels <= 0) return;
+    // Serial graphs run on the whole packet; parallel sections use the graph's
+    // scratch buffers, so the packet is walked in chunks that fit them.
+    uint32_t chunk = graph.HasParallel() ? (uint32_t)(EffectGraph::kScratchSamples / channels) : numFrames;
+    if (chunk == 0) return;
+    const std::vector<EffectGraph::Op>& ops = graph.Ops();
+    const int finalOp = FinalMainOp(graph);
+    for (uint32_t offset = 0; offset < numFrames; offset += chunk) {
+        uint32_t frames = (numFrames - offset < chunk) ? numFrames - offset : chunk;
+        // The first stage reads the input directly, every later one works in place on out
+        const float* src = in + (size_t)offset * channels;
+        float* main = out + (size_t)offset * channels;
+        size_t samples = (size_t)frames * channels;
+        for (int i = 0; i < (int)ops.size(); ++i) {
+            const EffectGraph::Op& op = ops[i];
+            const float opGain = (i == finalOp) ? gain : 1.0f;
+            switch (op.kind) {
+            case EffectGraph::Op::Run:
+                if (op.slot == 0) {
+                    if (RunEffect(op.effect, src, main, frames, opGain)) src = main;
+                }
+                else {
+                    float* branch = graph.Scratch(op.slot);
+                    RunEffect(op.effect, branch, branch, frames, 1.0f);
+                }
+                break;
+            case EffectGraph::Op::Split:
+                for (int slot = 1; slot <= op.slot; ++slot) {
+                    memcpy(graph.Scratch(slot), src, samples * sizeof(float));
+                }
+                break;
+            case EffectGraph::Op::Scale:
+                if (src != main || op.gain * opGain != 1.0f) {
+                    const float scale = op.gain * opGain;
+                    for (size_t s = 0; s < samples; ++s) main[s] = src[s] * scale;
+                    src = main;
+                }
+                break;
+            case EffectGraph::Op::Accumulate: {
+                const float* branch = graph.Scratch(op.slot);
+                for (size_t s = 0; s < samples; ++s) main[s] = (main[s] + branch[s] * op.gain) * opGain;
+                break;
+            }
+            }
+        }
+        // Nothing ran: plain copy with the gain applied
+        if (src != main) PassThrough(src, main, frames, gain);
+    }
+}
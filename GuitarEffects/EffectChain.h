@@ -0,0 +1,291 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include "Multirate.h"
+#include "EffectGraph.h"
+#include "LockFree.h"
+#include "RealtimeThread.h"
+
+// Reverb filter structures
+struct ReverbComb {
+    std::vector<float> buffer;
+    int bufferSize;
+    int bufferIndex;
+    float feedback;
+    float filterStore;
+    float damp1, damp2;
+
+    ReverbComb() : bufferSize(0), bufferIndex(0), feedback(0), filterStore(0), damp1(0), damp2(0) {}
+
+    void setBuffer(int size) {
+        bufferSize = size;
+        buffer.assign(size, 0.0f);
+        bufferIndex = 0;
+    }
+
+    // Silence, as a freshly sized buffer
+    void clear() {
+        std::fill(buffer.begin(), buffer.end(), 0.0f);
+        bufferIndex = 0;
+        filterStore = 0.0f;
+    }
+
+    void setDamp(float val) {
+        damp1 = val;
+        damp2 = 1.0f - val;
+    }
+
+    void setFeedback(float val) {
+        feedback = val;
+    }
+
+    float process(float input) {
+        float output = buffer[bufferIndex];
+        filterStore = (output * damp2) + (filterStore * damp1);
+        buffer[bufferIndex] = input + (filterStore * feedback);
+        if (++bufferIndex >= bufferSize) bufferIndex = 0;
+        return output;
+    }
+};
+
+struct ReverbAllpass {
+    std::vector<float> buffer;
+    int bufferSize;
+    int bufferIndex;
+    float feedback;
+
+    ReverbAllpass() : bufferSize(0), bufferIndex(0), feedback(0) {}
+
+    void setBuffer(int size) {
+        bufferSize = size;
+        buffer.assign(size, 0.0f);
+        bufferIndex = 0;
+    }
+
+    void clear() {
+        std::fill(buffer.begin(), buffer.end(), 0.0f);
+        bufferIndex = 0;
+    }
+
+    void setFeedback(float val) {
+        feedback = val;
+    }
+
+    float process(float input) {
+        float bufout = buffer[bufferIndex];
+        float output = -input + bufout;
+        buffer[bufferIndex] = input + (bufout * feedback);
+        if (++bufferIndex >= bufferSize) bufferIndex = 0;
+        return output;
+    }
+};
+
+// Every user-facing effect setting. A copy of this struct is a preset.
+struct EffectParams {
+    // Tremolo
+    bool tremoloEnabled = false;
+    float tremoloRate = 5.0f;
+    float tremoloDepth = 0.5f;
+
+    // Chorus
+    bool chorusEnabled = false;
+    float chorusRate = 1.5f;
+    float chorusDepth = 0.02f;
+    float chorusFeedback = 0.3f;
+    float chorusWidth = 0.5f;
+    int chorusRateDivider = 1;       // run chorus at sampleRate / divider (1, 2 or 4)
+
+    // Overdrive
+    bool overdriveEnabled = false;
+    float overdriveDrive = 3.0f;
+    float overdriveThreshold = 0.3f;
+    float overdriveTone = 0.5f;
+    float overdriveMix = 0.8f;
+
+    // Blues driver
+    bool bluesEnabled = false;
+    float bluesGain = 1.5f;   // input gain
+    float bluesTone = 0.5f;   // 0..1 tone control
+    float bluesLevel = 0.8f;  // output level (0..1)
+
+    // Compressor / Sustainer
+    bool compEnabled = false;
+    float compLevel = 1.0f;   // makeup gain (0..2)
+    float compTone = 0.5f;    // tone post-eq (0..1)
+    float compAttackMs = 10.0f; // attack in ms
+    float compSustainMs = 300.0f; // release/sustain in ms
+
+    // Reverb
+    bool reverbEnabled = false;
+    float reverbSize = 0.5f;
+    float reverbDamping = 0.5f;
+    float reverbWidth = 1.0f;
+    float reverbMix = 0.3f;
+    int reverbRateDivider = 1;       // run reverb at sampleRate / divider (1, 2 or 4)
+
+    // Warm
+    bool warmEnabled = false;
+    float warmAmount = 0.5f;
+    float warmTone = 0.5f;
+    float warmSaturation = 0.3f;
+
+    // Wah
+    bool wahEnabled = false;
+    float wahFreq = 800.0f;     // Center frequency (Hz)
+    float wahQ = 10.0f;         // Resonance/Q factor
+    float wahMix = 1.0f;        // Dry/wet mix (0-1)
+    float wahLfoRate = 0.0f;    // LFO rate for auto-wah (Hz)
+    float wahLfoDepth = 0.0f;   // LFO depth (0-1)
+};
+
+// One complete set of effects: parameters plus all filter/delay state.
+// Chains are built on the control thread and then owned by the audio thread
+// (see EffectEngine), so a preset switch can run two of them side by side.
+class EffectChain {
+public:
+    EffectParams params;
+    // Under an EffectEngine the control thread publishes parameter changes
+    // here, and the audio thread copies the newest whole set into params at
+    // the start of each call
+    RtSnapshot<EffectParams> paramUpdates;
+
+    EffectChain();
+
+    // Size and allocate all effect state for a format. Runs on the control
+    // thread; Process() never allocates afterwards, as long as blocks are no
+    // longer than maxBlockFrames (longer ones are split where needed).
+    void Prepare(float sampleRate, uint32_t maxBlockFrames, int channels);
+    float SampleRate() const { return sampleRate; }
+    int Channels() const { return channels; }
+    uint32_t MaxBlockFrames() const { return maxBlockFrames; }
+
+    // Run the chain on interleaved audio in the order given by graph. The
+    // first stage reads in, all stages write out (in == out is fine), and
+    // gain is applied as part of the last stage's write.
+    void Process(EffectGraph& graph, const float* in, float* out, uint32_t numFrames, float gain = 1.0f);
+
+    // Kernels: out = effect(in) * postGain, in place when in == out
+    void ApplyTremolo(const float* in, float* out, uint32_t numFrames, float postGain = 1.0f);
+    void ApplyChorus(const float* in, float* out, uint32_t numFrames, float postGain = 1.0f);
+    void ApplyOverdrive(const float* in, float* out, uint32_t numFrames, float postGain = 1.0f);
+    void ApplyReverb(const float* in, float* out, uint32_t numFrames, float postGain = 1.0f);
+    void ApplyWarm(const float* in, float* out, uint32_t numFrames, float postGain = 1.0f);
+    void ApplyBluesDriver(const float* in, float* out, uint32_t numFrames, float postGain = 1.0f);
+    void ApplyCompressor(const float* in, float* out, uint32_t numFrames, float postGain = 1.0f);
+    void ApplyWah(const float* in, float* out, uint32_t numFrames, float postGain = 1.0f);
+
+    // Wah effect processing on split channels
+    void processWah(float* leftChannel, float* rightChannel, int numSamples);
+
+    // True while the effect is being skipped because its input and its
+    // internal state have been below -120 dBFS for longer than its tail
+    bool IsIdle(EffectId effect) const;
+
+    // Delay the effect adds to the signal passing through it, in frames
+    uint32_t LatencyFrames(EffectId effect) const;
+
+    // Audio thread: adds the time spent in each effect since the last call
+    // to ns (indexed by EffectId) and restarts the counts
+    void TakeEffectTimes(uint64_t* ns);
+
+private:
+    float sampleRate;
+    int channels;
+    uint32_t maxBlockFrames;
+
+    // Returns false if the effect is disabled and out wasn't written
+    bool RunEffect(EffectId effect, const float* in, float* out, uint32_t numFrames, float gain);
+    int FinalMainOp(const EffectGraph& graph) const;
+    void PassThrough(const float* in, float* out, uint32_t numFrames, float gain);
+
+    // Silence tracking (see RunEffect)
+    bool IsEnabled(EffectId effect) const;
+    uint32_t TailFrames(EffectId effect) const;
+    bool StateSilent(EffectId effect) const;
+    void SkipEffect(EffectId effect, uint32_t numFrames);
+    uint32_t silentFrames[(int)EffectId::Count] = {};  // consecutive silent in+out frames
+    uint64_t effectTimeNs[(int)EffectId::Count] = {};  // processing time, for the live stats
+    void InitReverb(int factor);
+    void InitChorus(int factor);
+    void LockMemory();
+
+    float tremoloPhase;
+
+    // Chorus state
+    float chorusPhase = 0.0f;
+    std::vector<float> chorusDelayBuffer;
+    size_t chorusDelayIndex = 0;
+    int chorusActiveDivider = 0;     // divider the delay buffer was sized for
+    MultirateDownsampler chorusDown[kMaxMultirateChannels];
+    MultirateUpsampler chorusUp[kMaxMultirateChannels];
+
+    float overdriveFilterState[2] = { 0.0f, 0.0f };
+    float bluesFilterState[2] = { 0.0f, 0.0f };
+
+    // Compressor state, one entry per channel
+    std::vector<float> compEnv;
+    std::vector<float> compGainSmooth;
+    std::vector<float> compLowState;
+    float compCoefAttackMs = -1.0f;  // settings the cached coefficients are for
+    float compCoefSustainMs = -1.0f;
+    float compAttackCoef = 0.0f;
+    float compReleaseCoef = 0.0f;
+
+    // Reverb state
+    bool reverbInitialized = false;
+    int reverbInitDivider = 1;       // divider the comb/allpass buffers were sized for
+    uint32_t reverbTailFrames = 0;   // longest path through the combs and allpasses
+    float reverbAppliedSize = -1.0f; // size/damping the combs were last set to
+    float reverbAppliedDamping = -1.0f;
+    bool reverbCleared = false;      // combs/allpasses zeroed since it last ran
+    MultirateDownsampler reverbDown;
+    MultirateUpsampler reverbUpL, reverbUpR;
+
+    // Reverb filter arrays
+    ReverbComb reverbCombL[8], reverbCombR[8];
+    ReverbAllpass reverbAllpassL[4], reverbAllpassR[4];
+
+    // Warm effect filter states
+    float warmLowpassState[2] = { 0.0f, 0.0f };
+    float warmHighpassState[2] = { 0.0f, 0.0f };
+    float warmSaturatorState[2] = { 0.0f, 0.0f };
+
+    // Wah effect state variables
+    struct WahState {
+        // Filter state variables (biquad filter)
+        float z1L, z2L;       // Left channel state
+        float z1R, z2R;       // Right channel state
+
+        // LFO state
+        float lfoPhase;
+
+        // Envelope follower for dynamic wah (reacts to bends/slides)
+        float env;            // current envelope level (0..1)
+        float envAttackMs;    // attack time in ms
+        float envReleaseMs;   // release time in ms
+
+        // Center frequency smoothing (per chain, so two chains don't share it)
+        float smoothFreq;
+        float lastUpdatedFreq;
+
+        WahState() : z1L(0.0f), z2L(0.0f), z1R(0.0f), z2R(0.0f),
+                     lfoPhase(0.0f), env(0.0f), envAttackMs(5.0f), envReleaseMs(80.0f),
+                     smoothFreq(-1.0f), lastUpdatedFreq(0.0f) {}
+    } wahState;
+    std::vector<float> wahLeft, wahRight;  // de-interleaved block for processWah
+
+    void updateWahCoefficients(float centerFreq, float sampleRate);
+    void stepWahSweep(float envMod, float lfoIncrement, float& smoothFreq, float& lastUpdatedFreq);
+
+    // Biquad filter coefficients for wah
+    struct BiquadCoeffs {
+        float b0, b1, b2;  // Numerator coefficients
+        float a1, a2;      // Denominator coefficients (a0 is normalized to 1)
+
+        BiquadCoeffs() : b0(1.0f), b1(0.0f), b2(0.0f), a1(0.0f), a2(0.0f) {}
+    } wahCoeffs;
+
+    // Last, so the buffers above are unlocked before they're freed
+    MemoryLocks memoryLocks;
+};
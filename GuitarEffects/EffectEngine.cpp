@@ -0,0 +1,317 @@
+#include "EffectEngine.h"
+#include "RealtimeThread.h"
+#include "SessionRecording.h"
+#include "Trace.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+EffectEngine::EffectEngine() : sampleRate(44100.0f), channels(2), maxBlockFrames(1024),
+graphDesc(EffectGraphDesc::Default()), controlChain(nullptr),
+crossfadeMs(50.0f), tailThreshold(1e-4f), requestedBlockSize(64),
+current(nullptr), fading(nullptr), fadeFinished(false),
+fadeLength(1), fadePosition(0), tailFrames(0),
+blockSize(0), fifoChannels(0), fifoPosition(0),
+activeTailThreshold(1e-4f), swapCrossfadeMs(50.0f),
+recorder(nullptr), recordFrame(0), recordedGraph(nullptr),
+recordedBlockSize(0), recordedTailThreshold(0.0f) {
+    fadeBuffer.assign(kFadeChunkSamples, 0.0f);
+    fifoIn.assign(kFifoSamples, 0.0f);
+    fifoOut.assign(kFifoSamples, 0.0f);
+    memoryLocks.Lock(fadeBuffer);
+    memoryLocks.Lock(fifoIn);
+    memoryLocks.Lock(fifoOut);
+    graphs.Publish(new EffectGraph(graphDesc));
+    controlChain = new EffectChain();
+    controlChain->Prepare(sampleRate, maxBlockFrames, channels);
+    chains.Publish(controlChain);
+}
+
+EffectEngine::~EffectEngine() {
+    // controlChain is either pending (freed by the handoff) or current
+    delete current;
+    delete fading;
+}
+
+void EffectEngine::Prepare(float rate, uint32_t maxBlock, int numChannels) {
+    sampleRate = rate;
+    maxBlockFrames = maxBlock;
+    channels = numChannels;
+    SwitchPreset(controlParams);
+}
+
+const EffectParams& EffectEngine::Params() const {
+    return controlParams;
+}
+
+void EffectEngine::SetParams(const EffectParams& params) {
+    controlParams = params;
+    controlChain->paramUpdates.Publish(controlParams);
+}
+
+bool EffectEngine::SetGraph(const EffectGraphDesc& desc) {
+    if (!desc.IsValid()) return false;
+    graphDesc = desc;
+    // Compiled (and its scratch allocated) here, picked up by Process()
+    graphs.Publish(new EffectGraph(desc));
+    return true;
+}
+
+EffectGraphDesc EffectEngine::GetGraph() const {
+    return graphDesc;
+}
+
+void EffectEngine::SwitchPreset(const EffectParams& preset) {
+    EffectChain* chain = new EffectChain();
+    chain->params = preset;
+    controlParams = preset;
+    chain->Prepare(sampleRate, maxBlockFrames, channels);
+    controlChain = chain;
+    chains.Publish(chain);
+}
+
+void EffectEngine::SetCrossfadeMs(float ms) {
+    crossfadeMs = fmaxf(0.0f, ms);
+}
+
+float EffectEngine::GetCrossfadeMs() const {
+    return crossfadeMs;
+}
+
+void EffectEngine::SetTailThresholdDb(float db) {
+    tailThreshold = powf(10.0f, db / 20.0f);
+}
+
+float EffectEngine::GetTailThresholdDb() const {
+    return 20.0f * log10f(tailThreshold);
+}
+
+void EffectEngine::SetTailThreshold(float level) {
+    tailThreshold = level;
+}
+
+void EffectEngine::SetBlockSize(uint32_t frames) {
+    uint32_t size = 0;
+    for (uint32_t candidate = 16; candidate <= kMaxBlockFrames; candidate *= 2) {
+        if (frames >= candidate) size = candidate;
+    }
+    requestedBlockSize = size;
+}
+
+uint32_t EffectEngine::GetBlockSize() const {
+    return requestedBlockSize;
+}
+
+void EffectEngine::Reset() {
+    // controlChain moves to the fresh (pending) chain before current goes
+    SwitchPreset(controlParams);
+    delete fading;
+    delete current;
+    fading = nullptr;
+    current = nullptr;
+    fadeFinished = false;
+    fifoChannels = 0;  // restarts the FIFO on the next block
+}
+
+void EffectEngine::SetRecorder(SessionRecorder* sessionRecorder) {
+    recorder = sessionRecorder;
+    recordFrame = 0;
+    recordedGraph = nullptr;  // the first packet records the full state
+    recordedBlockSize = UINT32_MAX;
+}
+
+uint32_t EffectEngine::EffectLatencyFrames() const {
+    uint32_t total = 0;
+    for (const EffectGraphDesc::Step& step : graphDesc.steps) {
+        if (!step.parallel) {
+            total += controlChain->LatencyFrames(step.effect);
+            continue;
+        }
+        uint32_t slowest = 0;
+        for (const EffectGraphDesc::Branch& branch : step.branches) {
+            uint32_t branchLatency = 0;
+            for (EffectId effect : branch.effects) branchLatency += controlChain->LatencyFrames(effect);
+            slowest = std::max(slowest, branchLatency);
+        }
+        total += slowest;
+    }
+    return total;
+}
+
+uint32_t EffectEngine::LatencyFrames() const {
+    return requestedBlockSize + EffectLatencyFrames();
+}
+
+// Take() only succeeds with an empty retire slot, so retiring a chain
+// whose tail is still running can't fail here
+bool EffectEngine::SwapPendingChain() {
+    EffectChain* next = chains.Take();
+    if (!next) return false;
+    TRACE_INSTANT("PresetSwap", 0);
+    if (fading) chains.TryRetire(fading);
+    fading = current;
+    fadeFinished = false;
+    current = next;
+    swapCrossfadeMs = crossfadeMs;
+    float length = swapCrossfadeMs * current->SampleRate() / 1000.0f;
+    fadeLength = (length >= 1.0f) ? (uint32_t)length : 1;
+    fadePosition = 0;
+    tailFrames = 0;
+    return true;
+}
+
+void EffectEngine::Process(const float* in, float* out, uint32_t numFrames, float gain) {
+    EffectGraph* graph;
+    bool swapped;
+    {
+        // Pick up whatever the control thread published since the last call
+        TRACE_SCOPE("ParameterDrain");
+        graph = graphs.Acquire();
+        swapped = SwapPendingChain();
+    }
+    if (!in || !out) return;
+    if (!graph || !current) {
+        if (in != out) memcpy(out, in, (size_t)numFrames * channels * sizeof(float));
+        return;
+    }
+
+    // One consistent parameter set for the whole call
+    current->paramUpdates.Read(current->params);
+    const int ch = current->Channels();
+    uint32_t block = requestedBlockSize;
+    activeTailThreshold = tailThreshold;
+    // Recorded before processing: in may be out
+    if (recorder) RecordPacket(*graph, swapped, block, in, numFrames, gain);
+    if ((size_t)block * ch > fifoIn.size()) block = 0;
+    if (block != blockSize || ch != fifoChannels) {
+        // Restart the FIFO; the first block comes out as silence
+        blockSize = block;
+        fifoChannels = ch;
+        fifoPosition = 0;
+        std::fill(fifoOut.begin(), fifoOut.end(), 0.0f);
+    }
+
+    // The common sizes get the block length as a compile-time constant
+    switch (blockSize) {
+    case 16: RenderFixed<16>(*graph, in, out, numFrames, gain); break;
+    case 32: RenderFixed<32>(*graph, in, out, numFrames, gain); break;
+    case 64: RenderFixed<64>(*graph, in, out, numFrames, gain); break;
+    case 128: RenderFixed<128>(*graph, in, out, numFrames, gain); break;
+    case 256: RenderFixed<256>(*graph, in, out, numFrames, gain); break;
+    default: Render(*graph, in, out, numFrames, gain); break;
+    }
+    if (recorder) {
+        recorder->RecordOutput(recordFrame, HashSamples(out, (size_t)numFrames * ch));
+        recordFrame += numFrames;
+    }
+}
+
+// Everything the block depends on that changed since the last packet, then
+// the packet itself. Parameters are compared whole: the control thread
+// writes them in place, so the audio thread can't be told what changed.
+void EffectEngine::RecordPacket(const EffectGraph& graph, bool swapped, uint32_t block,
+    const float* in, uint32_t numFrames, float gain) {
+    if (&graph != recordedGraph) {
+        recorder->RecordGraph(recordFrame, graph.Desc());
+        recordedGraph = &graph;
+    }
+    if (swapped) {
+        recorder->RecordPreset(recordFrame, current->params, swapCrossfadeMs, current->SampleRate(), current->Channels());
+        recordedParams = current->params;
+    }
+    else if (memcmp(&recordedParams, &current->params, sizeof(EffectParams)) != 0) {
+        recorder->RecordParams(recordFrame, current->params);
+        recordedParams = current->params;
+    }
+    if (block != recordedBlockSize || activeTailThreshold != recordedTailThreshold) {
+        recorder->RecordSettings(recordFrame, block, activeTailThreshold);
+        recordedBlockSize = block;
+        recordedTailThreshold = activeTailThreshold;
+    }
+    recorder->RecordPacket(recordFrame, in, numFrames, current->Channels(), gain);
+}
+
+void EffectEngine::TakeEffectTimes(uint64_t* ns) {
+    if (current) current->TakeEffectTimes(ns);
+    if (fading) fading->TakeEffectTimes(ns);
+}
+
+// Each packet frame goes into the block being collected and the frame at the
+// same position of the previous (processed) block comes out, so the output
+// lags by exactly one block. Input is copied before output, so in == out works.
+template<uint32_t N>
+void EffectEngine::RenderFixed(EffectGraph& graph, const float* in, float* out, uint32_t numFrames, float gain) {
+    const size_t ch = (size_t)fifoChannels;
+    uint32_t done = 0;
+    while (done < numFrames) {
+        uint32_t frames = (N - fifoPosition < numFrames - done) ? N - fifoPosition : numFrames - done;
+        const size_t bytes = frames * ch * sizeof(float);
+        memcpy(&fifoIn[fifoPosition * ch], in + done * ch, bytes);
+        memcpy(out + done * ch, &fifoOut[fifoPosition * ch], bytes);
+        fifoPosition += frames;
+        done += frames;
+        if (fifoPosition == N) {
+            Render(graph, fifoIn.data(), fifoOut.data(), N, gain);
+            fifoPosition = 0;
+        }
+    }
+}
+
+void EffectEngine::Render(EffectGraph& graph, const float* in, float* out, uint32_t numFrames, float gain) {
+    const bool formatChanged = fading &&
+        (fading->Channels() != current->Channels() || fading->SampleRate() != current->SampleRate());
+    // Device changed under the old chain: nothing sensible to mix
+    if (formatChanged) fadeFinished = true;
+    // A finished chain is never mixed again, whether or not the control
+    // thread has emptied the retire slot yet: the output mustn't depend on
+    // its timing (session replay reproduces it without a control thread)
+    if (fading && fadeFinished && chains.TryRetire(fading)) fading = nullptr;
+    if (!fading || fadeFinished) {
+        current->Process(graph, in, out, numFrames, gain);
+        return;
+    }
+
+    const int ch = current->Channels();
+    const uint32_t chunk = (uint32_t)(fadeBuffer.size() / ch);
+    if (chunk == 0) return;
+    float tailPeak = 0.0f;
+    for (uint32_t offset = 0; offset < numFrames; offset += chunk) {
+        uint32_t frames = (numFrames - offset < chunk) ? numFrames - offset : chunk;
+        const float* src = in + (size_t)offset * ch;
+        float* main = out + (size_t)offset * ch;
+        float* old = fadeBuffer.data();
+
+        // The old chain hears the input fade out, then silence
+        for (uint32_t f = 0; f < frames; ++f) {
+            uint32_t pos = fadePosition + f;
+            float fade = (pos < fadeLength) ? 1.0f - (float)pos / fadeLength : 0.0f;
+            for (int c = 0; c < ch; ++c) {
+                old[f * ch + c] = src[f * ch + c] * fade;
+            }
+        }
+        fading->Process(graph, old, old, frames);
+        current->Process(graph, src, main, frames);
+
+        // New chain fades in on top of whatever the old one still produces
+        for (uint32_t f = 0; f < frames; ++f) {
+            uint32_t pos = fadePosition + f;
+            float fade = (pos < fadeLength) ? (float)pos / fadeLength : 1.0f;
+            for (int c = 0; c < ch; ++c) {
+                float tail = old[f * ch + c];
+                main[f * ch + c] = (main[f * ch + c] * fade + tail) * gain;
+                if (pos >= fadeLength && fabsf(tail) > tailPeak) tailPeak = fabsf(tail);
+            }
+        }
+        fadePosition = (fadeLength - fadePosition > frames) ? fadePosition + frames : fadeLength;
+    }
+
+    // Done once the fade is over and the tail has decayed (or ran too long)
+    if (fadePosition >= fadeLength) {
+        tailFrames += numFrames;
+        bool expired = tailFrames > (uint32_t)(kMaxTailSeconds * current->SampleRate());
+        if (tailPeak < activeTailThreshold || expired) {
+            fadeFinished = true;
+            if (chains.TryRetire(fading)) fading = nullptr;
+        }
+    }
+}
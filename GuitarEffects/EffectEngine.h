@@ -0,0 +1,144 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include "EffectChain.h"
+#include "EffectGraph.h"
+#include "LockFree.h"
+
+class SessionRecorder;
+
+// Runs the effects on the audio thread. The routing (EffectGraph) and the
+// chain holding all effect state (EffectChain) are both built on the control
+// thread and handed over without locks.
+//
+// A preset switch builds a complete new chain off the audio thread and
+// crossfades to it. The old chain keeps running on a fading input and then
+// on silence, so reverb and chorus tails ring out instead of being cut, and
+// is handed back to the control thread once its output has decayed.
+class EffectEngine {
+public:
+    EffectEngine();
+    ~EffectEngine();
+
+    EffectEngine(const EffectEngine&) = delete;
+    EffectEngine& operator=(const EffectEngine&) = delete;
+
+    // Control thread. Builds a chain prepared for the new format; the audio
+    // thread switches to it without a crossfade if the format changed.
+    void Prepare(float sampleRate, uint32_t maxBlockFrames, int channels);
+    float SampleRate() const { return sampleRate; }
+    int Channels() const { return channels; }
+    uint32_t MaxBlockFrames() const { return maxBlockFrames; }
+
+    // Control thread: parameters of the newest chain. Changes are published
+    // whole and take effect on the next call to Process().
+    const EffectParams& Params() const;
+    void SetParams(const EffectParams& params);
+    template<typename V>
+    void SetParam(V EffectParams::*field, V value) {
+        EffectParams params = controlParams;
+        params.*field = value;
+        SetParams(params);
+    }
+
+    bool SetGraph(const EffectGraphDesc& desc);
+    EffectGraphDesc GetGraph() const;
+
+    void SwitchPreset(const EffectParams& preset);
+    void SetCrossfadeMs(float ms);
+    float GetCrossfadeMs() const;
+    void SetTailThresholdDb(float db);
+    float GetTailThresholdDb() const;
+    // The same as a linear peak level, exactly as the audio thread uses it
+    void SetTailThreshold(float level);
+
+    // Internal block size. Device packets are rechunked through a FIFO so
+    // the chain always runs on blocks of exactly this many frames, whatever
+    // the packet size; that adds the same number of frames of latency.
+    // 0 processes each packet as it arrives. Snaps to 0, 16, 32, 64, 128, 256.
+    void SetBlockSize(uint32_t frames);
+    uint32_t GetBlockSize() const;
+
+    // Algorithmic latency of the current graph: effects in series add up,
+    // parallel branches count with their slowest branch
+    uint32_t EffectLatencyFrames() const;
+    // Rechunking FIFO (the block size) plus the effects
+    uint32_t LatencyFrames() const;
+
+    // Audio thread: out = effects(in) * gain. in and out may be the same
+    // buffer; out-of-place saves the copy from the capture to the render buffer.
+    // With parameters held constant, the output does not depend on how the
+    // input is split into calls, at any block size (to within the -120 dBFS
+    // silence threshold; see RunChunkingCheck), so buffer sizes can change freely.
+    void Process(const float* in, float* out, uint32_t numFrames, float gain = 1.0f);
+
+    // Control thread, audio thread stopped: drops all effect state (tails,
+    // a running crossfade, the FIFO). The next Process() starts on a freshly
+    // prepared chain, exactly like a new engine.
+    void Reset();
+
+    // Control thread, audio thread stopped: Process() reports what it
+    // consumes to recorder (nullptr: stop). Call Reset() first so the
+    // recording starts from a state a new engine can reproduce.
+    void SetRecorder(SessionRecorder* recorder);
+
+    // Audio thread: per-effect processing time since the last call, added
+    // to ns (indexed by EffectId); the outgoing chain of a crossfade included
+    void TakeEffectTimes(uint64_t* ns);
+
+private:
+    // The old chain runs on a copy of the input, processed in chunks of this size
+    static const int kFadeChunkSamples = 4096;
+    // Tails that never decay (e.g. DC) are cut after this long
+    static const int kMaxTailSeconds = 10;
+    // FIFO storage: the largest block for up to 16 channels. Devices with
+    // more channels fall back to processing whole packets.
+    static const uint32_t kMaxBlockFrames = 256;
+    static const int kFifoSamples = kMaxBlockFrames * 16;
+
+    bool SwapPendingChain();
+    void RecordPacket(const EffectGraph& graph, bool swapped, uint32_t block,
+        const float* in, uint32_t numFrames, float gain);
+    void Render(EffectGraph& graph, const float* in, float* out, uint32_t numFrames, float gain);
+    template<uint32_t N>
+    void RenderFixed(EffectGraph& graph, const float* in, float* out, uint32_t numFrames, float gain);
+
+    float sampleRate;
+    int channels;
+    uint32_t maxBlockFrames;
+    EffectGraphDesc graphDesc;
+    RtHandoff<EffectGraph> graphs;
+    RtHandoff<EffectChain> chains;
+    EffectChain* controlChain;      // newest chain handed over (control thread)
+    EffectParams controlParams;     // its parameters as last set (control thread)
+    std::atomic<float> crossfadeMs;
+    std::atomic<float> tailThreshold; // linear peak level
+    std::atomic<uint32_t> requestedBlockSize;
+
+    // Audio thread
+    EffectChain* current;
+    EffectChain* fading;
+    bool fadeFinished;          // fading has rung out, waiting to be retired
+    uint32_t fadeLength;
+    uint32_t fadePosition;
+    uint32_t tailFrames;
+    std::vector<float> fadeBuffer;
+    uint32_t blockSize;         // block size the FIFO is running at
+    int fifoChannels;
+    uint32_t fifoPosition;      // frames of the current block already collected
+    std::vector<float> fifoIn;  // block being collected
+    std::vector<float> fifoOut; // previous block, being played out
+    float activeTailThreshold;  // tailThreshold as read for this call
+    float swapCrossfadeMs;      // crossfadeMs as read by the last swap
+
+    // Session recording (audio thread, while recorder is set)
+    SessionRecorder* recorder;
+    uint64_t recordFrame;
+    const EffectGraph* recordedGraph;
+    EffectParams recordedParams;
+    uint32_t recordedBlockSize;
+    float recordedTailThreshold;
+
+    MemoryLocks memoryLocks;    // fadeBuffer and the FIFOs
+};
@@ -0,0 +1,83 @@
+#include "EffectGraph.h"
+#include "RealtimeThread.h"
+
+EffectGraphDesc EffectGraphDesc::Default() {
+    EffectGraphDesc desc;
+    desc.Then(EffectId::Tremolo)
+        .Then(EffectId::Chorus)
+        .Then(EffectId::BluesDriver)
+        .Then(EffectId::Overdrive)
+        .Then(EffectId::Compressor)
+        .Then(EffectId::Reverb)
+        .Then(EffectId::Warm)
+        .Then(EffectId::Wah);
+    return desc;
+}
+
+EffectGraphDesc& EffectGraphDesc::Then(EffectId effect) {
+    Step step;
+    step.effect = effect;
+    steps.push_back(step);
+    return *this;
+}
+
+EffectGraphDesc& EffectGraphDesc::Split(const std::vector<Branch>& branches) {
+    Step step;
+    step.parallel = true;
+    step.branches = branches;
+    steps.push_back(step);
+    return *this;
+}
+
+bool EffectGraphDesc::IsValid() const {
+    bool used[(int)EffectId::Count] = {};
+    auto claim = [&used](EffectId effect) {
+        int idx = (int)effect;
+        if (idx < 0 || idx >= (int)EffectId::Count || used[idx]) return false;
+        used[idx] = true;
+        return true;
+    };
+    for (const Step& step : steps) {
+        if (!step.parallel) {
+            if (!claim(step.effect)) return false;
+            continue;
+        }
+        if (step.branches.empty()) return false;
+        for (const Branch& branch : step.branches) {
+            for (EffectId effect : branch.effects) {
+                if (!claim(effect)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+EffectGraph::EffectGraph(const EffectGraphDesc& graphDesc) : desc(graphDesc) {
+    size_t maxExtraBranches = 0;
+    for (const EffectGraphDesc::Step& step : desc.steps) {
+        if (!step.parallel) {
+            ops.push_back({ Op::Run, step.effect, 0, 1.0f });
+            continue;
+        }
+        // Branch 0 runs in place on the main buffer, the others on copies of it
+        int extra = (int)step.branches.size() - 1;
+        if (extra > 0) {
+            ops.push_back({ Op::Split, EffectId::Count, extra, 1.0f });
+        }
+        for (size_t b = 0; b < step.branches.size(); ++b) {
+            for (EffectId effect : step.branches[b].effects) {
+                ops.push_back({ Op::Run, effect, (int)b, 1.0f });
+            }
+        }
+        ops.push_back({ Op::Scale, EffectId::Count, 0, step.branches[0].gain });
+        for (size_t b = 1; b < step.branches.size(); ++b) {
+            ops.push_back({ Op::Accumulate, EffectId::Count, (int)b, step.branches[b].gain });
+        }
+        if ((size_t)extra > maxExtraBranches) maxExtraBranches = extra;
+    }
+    scratch.resize(maxExtraBranches);
+    for (std::vector<float>& slot : scratch) {
+        slot.assign(kScratchSamples, 0.0f);
+        memoryLocks.Lock(slot);
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "RealtimeThread.h"
+
+enum class EffectId {
+    Tremolo,
+    Chorus,
+    BluesDriver,
+    Overdrive,
+    Compressor,
+    Reverb,
+    Warm,
+    Wah,
+    Count
+};
+
+// Effect routing as edited on the control thread: a serial list of steps,
+// where each step is either one effect or a parallel split whose branches
+// are summed back together with their gains.
+struct EffectGraphDesc {
+    struct Branch {
+        std::vector<EffectId> effects;
+        float gain = 1.0f;
+    };
+
+    struct Step {
+        bool parallel = false;
+        EffectId effect = EffectId::Tremolo;  // serial step
+        std::vector<Branch> branches;         // parallel step
+    };
+
+    std::vector<Step> steps;
+
+    // tremolo -> chorus -> blues -> overdrive -> compressor -> reverb -> warm -> wah
+    static EffectGraphDesc Default();
+
+    EffectGraphDesc& Then(EffectId effect);
+    EffectGraphDesc& Split(const std::vector<Branch>& branches);
+
+    // Every effect owns a single set of state, so it may appear at most once
+    bool IsValid() const;
+};
+
+// Flattened form of an EffectGraphDesc that the audio thread walks without
+// allocating. Branch scratch buffers are allocated up front by the constructor.
+class EffectGraph {
+public:
+    struct Op {
+        enum Kind {
+            Run,        // run effect on slot
+            Split,      // copy main buffer into slots 1..slot
+            Scale,      // main *= gain
+            Accumulate  // main += slot * gain
+        } kind;
+        EffectId effect;
+        int slot;       // 0 = main buffer, n = scratch[n - 1]
+        float gain;
+    };
+
+    // Parallel sections are processed in chunks of at most this many samples
+    static const int kScratchSamples = 4096;
+
+    explicit EffectGraph(const EffectGraphDesc& desc);
+
+    const EffectGraphDesc& Desc() const { return desc; }
+    const std::vector<Op>& Ops() const { return ops; }
+    bool HasParallel() const { return !scratch.empty(); }
+    float* Scratch(int slot) { return scratch[slot - 1].data(); }
+
+private:
+    EffectGraphDesc desc;
+    std::vector<Op> ops;
+    std::vector<std::vector<float>> scratch;
+    MemoryLocks memoryLocks;
+};
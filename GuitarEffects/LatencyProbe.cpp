@@ -0,0 +1,115 @@
+#include "LatencyProbe.h"
+#include <cmath>
+#include <complex>
+
+namespace {
+
+const float kProbeLevel = 0.25f;   // -12 dBFS, loud enough over room noise
+// Peak-to-RMS of the correlation needed to trust the result
+const double kMinConfidence = 8.0;
+
+// Feedback taps of maximal-length Galois LFSRs, indexed by order
+const uint32_t kLfsrTaps[] = {
+    0, 0, 0x3, 0x6, 0xC, 0x14, 0x30, 0x60, 0xB8, 0x110, 0x240,
+    0x500, 0x829, 0x100D, 0x2015, 0x6000, 0xD008, 0x12000, 0x20400
+};
+
+typedef std::complex<double> Complex;
+
+// In-place iterative radix-2 FFT; size must be a power of two
+void Fft(std::vector<Complex>& data, bool inverse) {
+    const size_t n = data.size();
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(data[i], data[j]);
+    }
+    for (size_t length = 2; length <= n; length <<= 1) {
+        double angle = 2.0 * 3.14159265358979323846 / length * (inverse ? 1.0 : -1.0);
+        Complex step(cos(angle), sin(angle));
+        for (size_t start = 0; start < n; start += length) {
+            Complex w(1.0, 0.0);
+            for (size_t k = 0; k < length / 2; ++k) {
+                Complex even = data[start + k];
+                Complex odd = data[start + k + length / 2] * w;
+                data[start + k] = even + odd;
+                data[start + k + length / 2] = even - odd;
+                w *= step;
+            }
+        }
+    }
+}
+
+} // namespace
+
+LatencyProbe::LatencyProbe(int order, uint32_t maxLatencyFrames) : position(0), state(Idle) {
+    if (order < 2) order = 2;
+    if (order > 18) order = 18;
+    const uint32_t length = (1u << order) - 1;
+    sequence.resize(length);
+    uint32_t lfsr = 1;
+    for (uint32_t i = 0; i < length; ++i) {
+        sequence[i] = (lfsr & 1) ? kProbeLevel : -kProbeLevel;
+        lfsr = (lfsr >> 1) ^ ((lfsr & 1) ? kLfsrTaps[order] : 0);
+    }
+    recording.assign(length + maxLatencyFrames, 0.0f);
+}
+
+void LatencyProbe::Arm() {
+    state.store(Armed, std::memory_order_release);
+}
+
+void LatencyProbe::Process(const float* captured, float* playback, uint32_t numFrames, int channels) {
+    int current = state.load(std::memory_order_acquire);
+    if (current == Armed) {
+        position = 0;
+        state.store(Running, std::memory_order_relaxed);
+    }
+    else if (current != Running) {
+        return;
+    }
+    const uint32_t total = (uint32_t)recording.size();
+    for (uint32_t f = 0; f < numFrames; ++f) {
+        const size_t frame = (size_t)f * channels;
+        if (position < total) recording[position] = captured[frame];
+        float out = (position < sequence.size()) ? sequence[position] : 0.0f;
+        for (int c = 0; c < channels; ++c) playback[frame + c] = out;
+        if (position < total) ++position;
+    }
+    if (position >= total) state.store(Finished, std::memory_order_release);
+}
+
+LatencyMeasurement LatencyProbe::Analyze(double sampleRate) const {
+    LatencyMeasurement result;
+    if (!Done()) return result;
+
+    size_t size = 1;
+    while (size < recording.size() + sequence.size()) size <<= 1;
+    std::vector<Complex> rec(size), seq(size);
+    for (size_t i = 0; i < recording.size(); ++i) rec[i] = recording[i];
+    for (size_t i = 0; i < sequence.size(); ++i) seq[i] = sequence[i];
+    Fft(rec, false);
+    Fft(seq, false);
+    for (size_t i = 0; i < size; ++i) rec[i] *= std::conj(seq[i]);
+    Fft(rec, true);
+
+    // corr[lag] = sum recording[n + lag] * sequence[n], for lags in the window
+    const size_t lags = recording.size() - sequence.size() + 1;
+    size_t best = 0;
+    double peak = 0.0, energy = 0.0;
+    for (size_t lag = 0; lag < lags; ++lag) {
+        double value = fabs(rec[lag].real());
+        energy += value * value;
+        if (value > peak) {
+            peak = value;
+            best = lag;
+        }
+    }
+    double rest = (lags > 1) ? sqrt((energy - peak * peak) / (lags - 1)) : 0.0;
+    result.frames = (uint32_t)best;
+    result.ms = best * 1000.0 / sampleRate;
+    result.confidence = (rest > 0.0) ? peak / rest : 0.0;
+    result.valid = peak > 0.0 && (rest == 0.0 || result.confidence >= kMinConfidence);
+    return result;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+struct LatencyMeasurement {
+    uint32_t frames = 0;     // round trip, output of the probe to its return
+    double ms = 0.0;
+    double confidence = 0.0; // correlation peak over the RMS of the rest
+    bool valid = false;      // peak stood clearly above the noise
+};
+
+// Round-trip latency measurement: plays a maximum length sequence (MLS),
+// records what comes back and cross-correlates the two. The correlation peak
+// sits at the round-trip delay; MLS has a flat spectrum and a near-ideal
+// autocorrelation, so it finds the peak through noise and effects that a
+// single click wouldn't survive.
+//
+// Arm() on the control thread, Process() on the audio thread, Analyze() on
+// the control thread once Done().
+class LatencyProbe {
+public:
+    // 2^order - 1 sample sequence; maxLatencyFrames bounds the search
+    LatencyProbe(int order = 14, uint32_t maxLatencyFrames = 48000);
+
+    void Arm();
+    bool Active() const { return state.load(std::memory_order_acquire) == Running; }
+    bool Done() const { return state.load(std::memory_order_acquire) == Finished; }
+
+    // Records channel 0 of captured and writes the probe (then silence) to
+    // every channel of playback. captured and playback may be the same buffer.
+    void Process(const float* captured, float* playback, uint32_t numFrames, int channels);
+
+    LatencyMeasurement Analyze(double sampleRate) const;
+
+private:
+    enum State { Idle, Armed, Running, Finished };
+
+    std::vector<float> sequence;
+    std::vector<float> recording;
+    uint32_t position;
+    std::atomic<int> state;
+};
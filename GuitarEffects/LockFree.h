@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+
+// Hands heap objects built on the control thread over to the audio thread
+// without locks. The audio thread never allocates or deletes: an object it
+// replaces is parked in a retire slot, and the control thread frees it on its
+// next Publish() or Collect().
+template<typename T>
+class RtHandoff {
+public:
+    RtHandoff() : pending(nullptr), retired(nullptr), active(nullptr) {}
+
+    // Only call once the audio thread has stopped
+    ~RtHandoff() {
+        delete pending.exchange(nullptr);
+        delete retired.exchange(nullptr);
+        delete active;
+    }
+
+    RtHandoff(const RtHandoff&) = delete;
+    RtHandoff& operator=(const RtHandoff&) = delete;
+
+    // Control thread: queue next for the audio thread. An object that was
+    // published earlier but never picked up is freed here.
+    void Publish(T* next) {
+        Collect();
+        delete pending.exchange(next);
+    }
+
+    // Control thread: free whatever the audio thread has retired
+    void Collect() {
+        delete retired.exchange(nullptr);
+    }
+
+    // Audio thread: take the pending object without retiring anything. Only
+    // succeeds while the retire slot is empty, so the caller can always hand
+    // one object back with TryRetire() afterwards.
+    T* Take() {
+        if (retired.load() != nullptr) return nullptr;
+        return pending.exchange(nullptr);
+    }
+
+    // Audio thread: give an object back for the control thread to free.
+    // Fails (and the caller keeps it) while the retire slot is occupied.
+    bool TryRetire(T* object) {
+        if (retired.load() != nullptr) return false;
+        retired.store(object);
+        return true;
+    }
+
+    // Audio thread: returns the object to use for the current block. A
+    // pending object is only taken once the retire slot is empty, so at
+    // worst the swap happens one block later.
+    T* Acquire() {
+        if (retired.load() == nullptr) {
+            T* next = pending.exchange(nullptr);
+            if (next) {
+                T* previous = active;
+                active = next;
+                retired.store(previous);
+            }
+        }
+        return active;
+    }
+
+private:
+    std::atomic<T*> pending;
+    std::atomic<T*> retired;
+    T* active; // audio thread only (Acquire)
+};
+
+// Passes copies of a small value from the control thread to the audio thread
+// without locks (a triple buffer). Publish() never waits and Read() always
+// sees one whole value, the newest published, never a mix of two.
+template<typename T>
+class RtSnapshot {
+public:
+    RtSnapshot() : shared(1), back(0), front(2) {}
+
+    RtSnapshot(const RtSnapshot&) = delete;
+    RtSnapshot& operator=(const RtSnapshot&) = delete;
+
+    // Control thread
+    void Publish(const T& value) {
+        slots[back] = value;
+        back = shared.exchange(back | kFresh) & kIndex;
+    }
+
+    // Audio thread: copies the newest value into out if one was published
+    // since the last call. Returns false (out untouched) otherwise.
+    bool Read(T& out) {
+        if (!(shared.load() & kFresh)) return false;
+        front = shared.exchange(front) & kIndex;
+        out = slots[front];
+        return true;
+    }
+
+private:
+    static const int kIndex = 3;
+    static const int kFresh = 4;
+
+    T slots[3];
+    std::atomic<int> shared; // slot last handed over, plus kFresh
+    int back;                // control thread only (Publish)
+    int front;               // audio thread only (Read)
+};
@@ -0,0 +1,184 @@
+#include "Logger.h"
+#include "RealtimeThread.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace {
+
+// Indexed by LogEvent
+const char* const kEventFormats[] = {
+    "AudioLoop: could not raise the thread priority, running at normal priority",
+    "AudioLoop: required interface is null, exiting thread",
+    "AudioLoop: captureClient->Start() failed (hr 0x%08llX), exiting thread",
+    "AudioLoop: prefilling the render buffer failed (hr 0x%08llX), exiting thread",
+    "AudioLoop: renderClient->Start() failed (hr 0x%08llX), exiting thread",
+    "AudioLoop: GetNextPacketSize failed (hr 0x%08llX), breaking loop",
+    "AudioLoop: GetBuffer failed (hr 0x%08llX), breaking loop",
+    "AudioLoop: GetCurrentPadding failed (hr 0x%08llX), breaking loop",
+    "AudioLoop: renderInterface->GetBuffer failed (hr 0x%08llX), breaking loop",
+    "AudioLoop: writing the render buffer failed (hr 0x%08llX), breaking loop",
+    "AudioLoop: exiting main loop",
+    "Session recording: cannot open the file, not recording",
+    "Session recording: the disk fell behind, recording stopped early",
+    "Live stats: cannot create the shared-memory segment (another instance running?), not publishing",
+    "Rebinding %lld: controller %lld buttons=0x%04llX",
+    "Button pressed during rebind: 0x%04llX",
+    "Storing button mask: 0x%04llX for action %lld",
+    "Controller %lld connected, buttons: 0x%04llX",
+    "Action %lld: mask=0x%04llX, current=0x%04llX, pressed=%lld, actionPressed=%lld",
+    "Triggered action %lld with button mask 0x%04llX",
+};
+static_assert(sizeof(kEventFormats) / sizeof(kEventFormats[0]) == (size_t)LogEvent::Count,
+    "every LogEvent needs a format string");
+
+const char* const kLevelNames[] = { "debug", "info", "warning", "error" };
+
+// Idle drain period; entries wait at most this long to be written
+const int kDrainIntervalMs = 20;
+
+uint64_t NowNs() {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+uint32_t CurrentThreadId() {
+#ifdef _WIN32
+    return GetCurrentThreadId();
+#else
+    return (uint32_t)(uintptr_t)pthread_self();
+#endif
+}
+
+} // namespace
+
+Logger& Logger::Get() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger() : enqueuePos(0), dequeuePos(0), dropped(0), reportedDropped(0), stopping(false) {
+    for (uint32_t i = 0; i < kCapacity; ++i) {
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    NowNs();  // pins the time origin before any thread logs
+}
+
+Logger::~Logger() {
+    Stop();
+}
+
+void Logger::Start() {
+    if (worker.joinable()) return;
+    PrefaultAndLock(ring, sizeof(ring));
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = false;
+    }
+    worker = std::thread(&Logger::Run, this);
+}
+
+void Logger::Stop() {
+    if (!worker.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+// Bounded MPSC queue after Vyukov: a producer claims a cell by advancing
+// enqueuePos when the cell's sequence says it is free, fills it and then
+// publishes it by bumping the sequence. The consumer never blocks them.
+void Logger::Push(LogLevel level, LogEvent event, const int64_t* args, int numArgs) {
+    uint32_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Entry* entry;
+    for (;;) {
+        entry = &ring[pos & (kCapacity - 1)];
+        const uint32_t sequence = entry->sequence.load(std::memory_order_acquire);
+        const int32_t diff = (int32_t)(sequence - pos);
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        }
+        else if (diff < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);  // full
+            return;
+        }
+        else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    entry->level = level;
+    entry->event = event;
+    entry->numArgs = numArgs;
+    entry->timeNs = NowNs();
+    entry->threadId = CurrentThreadId();
+    memcpy(entry->args, args, sizeof(entry->args));
+    entry->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool Logger::Pop(Entry& out) {
+    Entry& entry = ring[dequeuePos & (kCapacity - 1)];
+    const uint32_t sequence = entry.sequence.load(std::memory_order_acquire);
+    if ((int32_t)(sequence - (dequeuePos + 1)) < 0) return false;  // empty, or still being filled
+    out.level = entry.level;
+    out.event = entry.event;
+    out.numArgs = entry.numArgs;
+    out.timeNs = entry.timeNs;
+    out.threadId = entry.threadId;
+    memcpy(out.args, entry.args, sizeof(out.args));
+    entry.sequence.store(dequeuePos + kCapacity, std::memory_order_release);
+    ++dequeuePos;
+    return true;
+}
+
+void Logger::Drain() {
+    Entry entry;
+    while (Pop(entry)) Write(entry);
+    const uint64_t total = Dropped();
+    if (total != reportedDropped) {
+        char line[96];
+        snprintf(line, sizeof(line), "[log] %llu entries dropped, ring full\n",
+            (unsigned long long)(total - reportedDropped));
+        fputs(line, stderr);
+#ifdef _WIN32
+        OutputDebugStringA(line);
+#endif
+        reportedDropped = total;
+    }
+}
+
+void Logger::Write(const Entry& entry) {
+    long long a[kMaxLogArgs];
+    for (int i = 0; i < kMaxLogArgs; ++i) a[i] = (i < entry.numArgs) ? (long long)entry.args[i] : 0;
+    char message[256];
+    snprintf(message, sizeof(message), kEventFormats[(int)entry.event], a[0], a[1], a[2], a[3], a[4], a[5]);
+    char line[320];
+    snprintf(line, sizeof(line), "[%10.3f] [%u] %s: %s\n", entry.timeNs / 1e6,
+        entry.threadId, kLevelNames[(int)entry.level], message);
+    fputs(line, stderr);
+#ifdef _WIN32
+    OutputDebugStringA(line);
+#endif
+}
+
+void Logger::Run() {
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    while (!stopping) {
+        // Producers never signal (that could block them); poll instead
+        wake.wait_for(lock, std::chrono::milliseconds(kDrainIntervalMs));
+        lock.unlock();
+        Drain();
+        lock.lock();
+    }
+    lock.unlock();
+    Drain();
+}
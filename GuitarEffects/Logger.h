@@ -0,0 +1,139 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+// Asynchronous logging for the audio and input threads.
+//
+// A log call stores an event ID, up to kMaxLogArgs integer arguments and a
+// timestamp in a fixed ring: no formatting, no locks, no allocation, and
+// never a wait (a full ring drops the entry and counts it). A background
+// thread started with Logger::Get().Start() drains the ring, formats each
+// entry from the event's format string and writes it to stderr and the
+// debugger.
+//
+// Log through the LOG_* macros. Levels below LOG_COMPILE_LEVEL expand to
+// nothing, arguments included; release builds keep Info and above.
+
+enum class LogLevel { Debug, Info, Warning, Error };
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_OFF 4
+
+#ifndef LOG_COMPILE_LEVEL
+#ifdef NDEBUG
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+// Every message the program logs. The format strings (Logger.cpp, same
+// order) take their arguments as long long.
+enum class LogEvent : uint16_t {
+    AudioNoRealtimePriority,
+    AudioMissingInterface,
+    AudioCaptureStartFailed,
+    AudioPrefillFailed,
+    AudioRenderStartFailed,
+    AudioPacketSizeFailed,
+    AudioCaptureBufferFailed,
+    AudioPaddingFailed,
+    AudioRenderBufferFailed,
+    AudioBridgeRenderFailed,
+    AudioLoopExit,
+    SessionRecordingFailed,
+    SessionRecordingOverflow,
+    StatsSegmentUnavailable,
+    InputRebindState,
+    InputRebindPressed,
+    InputRebindStored,
+    InputControllerConnected,
+    InputActionState,
+    InputActionTriggered,
+    Count
+};
+
+const int kMaxLogArgs = 6;
+
+class Logger {
+public:
+    static Logger& Get();
+
+    // Starts / stops the draining thread; Stop() writes out what's queued
+    void Start();
+    void Stop();
+
+    // Lock-free; never blocks, allocates or formats
+    template<typename... Args>
+    void Log(LogLevel level, LogEvent event, Args... args) {
+        static_assert(sizeof...(Args) <= kMaxLogArgs, "too many log arguments");
+        const int64_t values[kMaxLogArgs] = { (int64_t)args... };
+        Push(level, event, values, (int)sizeof...(Args));
+    }
+
+    uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    Logger();
+    ~Logger();
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    struct Entry {
+        std::atomic<uint32_t> sequence;  // Vyukov cell sequence: who may use the slot
+        LogLevel level;
+        LogEvent event;
+        int numArgs;
+        uint64_t timeNs;
+        uint32_t threadId;
+        int64_t args[kMaxLogArgs];
+    };
+    static const uint32_t kCapacity = 1024;  // power of two
+
+    void Push(LogLevel level, LogEvent event, const int64_t* args, int numArgs);
+    bool Pop(Entry& out);
+    void Drain();
+    void Write(const Entry& entry);
+    void Run();
+
+    Entry ring[kCapacity];
+    std::atomic<uint32_t> enqueuePos;
+    uint32_t dequeuePos;  // consumer only
+    std::atomic<uint64_t> dropped;
+    uint64_t reportedDropped;
+
+    std::thread worker;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool stopping;
+};
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) Logger::Get().Log(LogLevel::Debug, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...) Logger::Get().Log(LogLevel::Info, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING(...) Logger::Get().Log(LogLevel::Warning, __VA_ARGS__)
+#else
+#define LOG_WARNING(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) Logger::Get().Log(LogLevel::Error, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
@@ -0,0 +1,108 @@
+#include "Loudness.h"
+#include <cmath>
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+const double kAbsoluteGateLufs = -70.0;
+const double kRelativeGateLu = -10.0;
+const int kStepsPerBlock = 4;  // 400 ms blocks, advanced 100 ms at a time
+
+// The constant in the BS.1770 loudness formula
+double ToLufs(double meanSquare) {
+    return -0.691 + 10.0 * log10(meanSquare);
+}
+
+} // namespace
+
+// The K-weighting filters are specified as 48 kHz coefficients. They are
+// derived here from their analog prototypes, so the meter is right at any
+// rate; at 48 kHz this reproduces the published values.
+void LoudnessMeter::Prepare(float sampleRate, int numChannels) {
+    {
+        const double f0 = 1681.974450955533, gainDb = 3.999843853973347, q = 0.7071752369554196;
+        const double k = tan(kPi * f0 / sampleRate);
+        const double vh = pow(10.0, gainDb / 20.0);
+        const double vb = pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+        shelf.b0 = (vh + vb * k / q + k * k) / a0;
+        shelf.b1 = 2.0 * (k * k - vh) / a0;
+        shelf.b2 = (vh - vb * k / q + k * k) / a0;
+        shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+        shelf.a2 = (1.0 - k / q + k * k) / a0;
+    }
+    {
+        const double f0 = 38.13547087602444, q = 0.5003270373238773;
+        const double k = tan(kPi * f0 / sampleRate);
+        const double a0 = 1.0 + k / q + k * k;
+        highpass.b0 = 1.0;
+        highpass.b1 = -2.0;
+        highpass.b2 = 1.0;
+        highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+        highpass.a2 = (1.0 - k / q + k * k) / a0;
+    }
+    channels = numChannels;
+    state.assign((size_t)channels * 8, 0.0);
+    stepFrames = (uint32_t)(sampleRate / 10.0f + 0.5f);
+    stepPosition = 0;
+    stepEnergy = 0.0;
+    steps.clear();
+    peak = 0.0f;
+}
+
+void LoudnessMeter::Add(const float* interleaved, uint32_t frames) {
+    if (channels <= 0 || stepFrames == 0) return;
+    for (uint32_t f = 0; f < frames; ++f) {
+        for (int c = 0; c < channels; ++c) {
+            const float sample = interleaved[(size_t)f * channels + c];
+            if (fabsf(sample) > peak) peak = fabsf(sample);
+            // Direct form I, stage by stage: x1 x2 y1 y2 each
+            double* s = &state[(size_t)c * 8];
+            double x = sample;
+            double y = shelf.b0 * x + shelf.b1 * s[0] + shelf.b2 * s[1] - shelf.a1 * s[2] - shelf.a2 * s[3];
+            s[1] = s[0]; s[0] = x; s[3] = s[2]; s[2] = y;
+            x = y;
+            y = highpass.b0 * x + highpass.b1 * s[4] + highpass.b2 * s[5] - highpass.a1 * s[6] - highpass.a2 * s[7];
+            s[5] = s[4]; s[4] = x; s[7] = s[6]; s[6] = y;
+            stepEnergy += y * y;
+        }
+        if (++stepPosition == stepFrames) {
+            steps.push_back(stepEnergy);
+            stepPosition = 0;
+            stepEnergy = 0.0;
+        }
+    }
+}
+
+double LoudnessMeter::IntegratedLufs() const {
+    // Mean square of each 400 ms block, summed over channels
+    std::vector<double> blocks;
+    for (size_t i = 0; i + kStepsPerBlock <= steps.size(); ++i) {
+        double energy = 0.0;
+        for (int j = 0; j < kStepsPerBlock; ++j) energy += steps[i + j];
+        blocks.push_back(energy / ((double)stepFrames * kStepsPerBlock));
+    }
+    double gated = 0.0;
+    size_t count = 0;
+    for (double block : blocks) {
+        if (block > 0.0 && ToLufs(block) > kAbsoluteGateLufs) {
+            gated += block;
+            ++count;
+        }
+    }
+    if (count == 0) return -HUGE_VAL;
+    const double relativeGate = ToLufs(gated / count) + kRelativeGateLu;
+    double loud = 0.0;
+    size_t loudCount = 0;
+    for (double block : blocks) {
+        if (block > 0.0 && ToLufs(block) > kAbsoluteGateLufs && ToLufs(block) > relativeGate) {
+            loud += block;
+            ++loudCount;
+        }
+    }
+    return loudCount ? ToLufs(loud / loudCount) : -HUGE_VAL;
+}
+
+double LoudnessMeter::PeakDb() const {
+    return (peak > 0.0f) ? 20.0 * log10(peak) : -HUGE_VAL;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Integrated loudness after ITU-R BS.1770-4: K-weighting, 400 ms blocks
+// with 75% overlap, the -70 LUFS absolute gate and the -10 LU relative
+// gate. All channels count with weight 1 (the standard weights surround
+// channels higher; guitar renders are mono or stereo). Also tracks the
+// sample peak. Feed it a file as it is rendered, in any chunk sizes.
+class LoudnessMeter {
+public:
+    void Prepare(float sampleRate, int channels);
+    void Add(const float* interleaved, uint32_t frames);
+
+    // -HUGE_VAL if everything was gated away (silence or too short)
+    double IntegratedLufs() const;
+    // Largest absolute sample value, as dBFS
+    double PeakDb() const;
+
+private:
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+    };
+
+    Biquad shelf;       // stage 1: head-related high shelf
+    Biquad highpass;    // stage 2: RLB high-pass
+    int channels = 0;
+    std::vector<double> state;  // 4 per stage per channel
+    uint32_t stepFrames = 0;    // 100 ms
+    uint32_t stepPosition = 0;
+    double stepEnergy = 0.0;    // sum of squares over the current 100 ms
+    std::vector<double> steps;  // energy of each complete 100 ms step
+    float peak = 0.0f;
+};
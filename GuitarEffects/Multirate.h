@@ -0,0 +1,207 @@
+#pragma once
+#include <cmath>
+
+// Half-band FIR used for 2x decimation/interpolation. Every other tap of a
+// half-band kernel is zero (apart from the centre tap of 0.5), so both filters
+// are written in polyphase form and only evaluate the non-zero branch.
+const int kHalfbandTaps = 31;
+const int kHalfbandCenter = (kHalfbandTaps - 1) / 2;
+const int kHalfbandBranchTaps = (kHalfbandTaps + 1) / 2;
+
+// Largest channel count that gets per-channel resamplers (chorus)
+const int kMaxMultirateChannels = 8;
+
+// Fills the non-zero polyphase branch (taps 0, 2, 4, ...) of a Blackman
+// windowed sinc with its cutoff at a quarter of the full rate.
+inline void designHalfbandBranch(float* branch) {
+    const double pi = 3.14159265358979323846;
+    double sum = 0.0;
+    for (int j = 0; j < kHalfbandBranchTaps; ++j) {
+        int k = 2 * j;
+        int d = k - kHalfbandCenter; // always odd
+        double sinc = sin(pi * d / 2.0) / (pi * d);
+        double window = 0.42 - 0.5 * cos(2.0 * pi * k / (kHalfbandTaps - 1))
+            + 0.08 * cos(4.0 * pi * k / (kHalfbandTaps - 1));
+        branch[j] = (float)(sinc * window);
+        sum += branch[j];
+    }
+    // Normalize so the branch sums to 0.5 (unity DC gain with the centre tap)
+    for (int j = 0; j < kHalfbandBranchTaps; ++j) {
+        branch[j] = (float)(branch[j] * 0.5 / sum);
+    }
+}
+
+// Decimates by two. Emits one output for every second input sample,
+// starting with the first one pushed after reset().
+struct HalfbandDecimator {
+    float coeffs[kHalfbandBranchTaps];
+    float history[2 * kHalfbandTaps];
+    int pos;
+    int phase;
+
+    HalfbandDecimator() {
+        designHalfbandBranch(coeffs);
+        reset();
+    }
+
+    void reset() {
+        for (int i = 0; i < 2 * kHalfbandTaps; i++) history[i] = 0.0f;
+        pos = 0;
+        phase = 0;
+    }
+
+    bool process(float input, float& output) {
+        // Mirrored write keeps the newest kHalfbandTaps samples contiguous
+        if (--pos < 0) pos = kHalfbandTaps - 1;
+        history[pos] = input;
+        history[pos + kHalfbandTaps] = input;
+
+        bool ready = (phase == 0);
+        phase ^= 1;
+        if (!ready) return false;
+
+        const float* x = history + pos;
+        float acc = 0.5f * x[kHalfbandCenter];
+        for (int j = 0; j < kHalfbandBranchTaps; ++j) {
+            acc += coeffs[j] * x[2 * j];
+        }
+        output = acc;
+        return true;
+    }
+
+    // Same as pushing count zeros: clears the history and keeps the
+    // decimation phase. Returns how many outputs process() would have given.
+    int skip(int count) {
+        if (count <= 0) return 0;
+        for (int i = 0; i < 2 * kHalfbandTaps; i++) history[i] = 0.0f;
+        int outputs = (phase == 0) ? (count + 1) / 2 : count / 2;
+        phase ^= (count & 1);
+        return outputs;
+    }
+};
+
+// Interpolates by two. Each input produces two outputs: the even phase runs
+// the filter branch, the odd phase is the delayed centre tap.
+struct HalfbandInterpolator {
+    float coeffs[kHalfbandBranchTaps];
+    float history[2 * kHalfbandBranchTaps];
+    int pos;
+
+    HalfbandInterpolator() {
+        designHalfbandBranch(coeffs);
+        reset();
+    }
+
+    void reset() {
+        for (int i = 0; i < 2 * kHalfbandBranchTaps; i++) history[i] = 0.0f;
+        pos = 0;
+    }
+
+    void process(float input, float* output) {
+        if (--pos < 0) pos = kHalfbandBranchTaps - 1;
+        history[pos] = input;
+        history[pos + kHalfbandBranchTaps] = input;
+
+        const float* x = history + pos;
+        float acc = 0.0f;
+        for (int j = 0; j < kHalfbandBranchTaps; ++j) {
+            acc += coeffs[j] * x[j];
+        }
+        output[0] = 2.0f * acc;
+        output[1] = x[kHalfbandCenter / 2];
+    }
+};
+
+// Round-trip delay (decimate + interpolate) in full-rate samples
+inline int MultirateLatency(int factor) {
+    if (factor >= 4) return 2 * (kHalfbandCenter + 2 * kHalfbandCenter);
+    if (factor == 2) return 2 * kHalfbandCenter;
+    return 0;
+}
+
+// Full rate -> 1/factor rate (factor 1, 2 or 4) using cascaded half-band stages
+struct MultirateDownsampler {
+    HalfbandDecimator stages[2];
+    int factor;
+
+    MultirateDownsampler() : factor(1) {}
+
+    void setFactor(int f) {
+        factor = f;
+        reset();
+    }
+
+    void reset() {
+        stages[0].reset();
+        stages[1].reset();
+    }
+
+    // Returns true when a low-rate sample has been written to output
+    bool process(float input, float& output) {
+        if (factor == 1) {
+            output = input;
+            return true;
+        }
+        float mid;
+        if (!stages[0].process(input, mid)) return false;
+        if (factor == 2) {
+            output = mid;
+            return true;
+        }
+        return stages[1].process(mid, output);
+    }
+
+    // Advances over count silent inputs; returns the low-rate samples that
+    // process() would have emitted
+    int skip(int count) {
+        if (factor == 1) return count;
+        int mid = stages[0].skip(count);
+        if (factor == 2) return mid;
+        return stages[1].skip(mid);
+    }
+};
+
+// 1/factor rate -> full rate. push() one low-rate sample, then pop() factor
+// full-rate samples before the next push.
+struct MultirateUpsampler {
+    HalfbandInterpolator stages[2];
+    float pending[4];
+    int factor;
+    int count;
+    int readIndex;
+
+    MultirateUpsampler() : factor(1), count(0), readIndex(0) {}
+
+    void setFactor(int f) {
+        factor = f;
+        reset();
+    }
+
+    void reset() {
+        stages[0].reset();
+        stages[1].reset();
+        count = 0;
+        readIndex = 0;
+    }
+
+    void push(float input) {
+        if (factor == 1) {
+            pending[0] = input;
+        }
+        else if (factor == 2) {
+            stages[0].process(input, pending);
+        }
+        else {
+            float mid[2];
+            stages[1].process(input, mid);
+            stages[0].process(mid[0], pending);
+            stages[0].process(mid[1], pending + 2);
+        }
+        count = factor;
+        readIndex = 0;
+    }
+
+    float pop() {
+        return (readIndex < count) ? pending[readIndex++] : 0.0f;
+    }
+};
@@ -0,0 +1,926 @@
+#include "Offline.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "AudioFile.h"
+#include "EffectEngine.h"
+#include "Loudness.h"
+#include "Presets.h"
+#include "WorkStealingPool.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+
+// Frames per Process() call. Offline there is no device packet to follow,
+// so the engine runs per call (block size 0) on large chunks.
+const uint32_t kRenderFrames = 4096;
+
+double ElapsedSeconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::string FileName(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return (slash == std::string::npos) ? path : path.substr(slash + 1);
+}
+
+// State owned by one pool worker, reused from file to file
+struct Worker {
+    std::unique_ptr<EffectEngine> engine;
+    std::vector<float> in;
+    std::vector<float> out;
+};
+
+struct BatchJob {
+    std::string input;
+    std::string output;
+    uint64_t bytes;
+    double audioSeconds;
+    double renderSeconds;
+    bool ok;
+};
+
+// The worker's engine, fresh (as if just constructed) and set up for a file
+EffectEngine& PrepareEngine(Worker& worker, const EffectParams& preset, float sampleRate, int channels) {
+    if (!worker.engine) {
+        worker.engine.reset(new EffectEngine());
+        worker.engine->SetBlockSize(0);
+    }
+    EffectEngine& engine = *worker.engine;
+    engine.Reset();
+    engine.SetParams(preset);
+    engine.Prepare(sampleRate, kRenderFrames, channels);
+    worker.in.resize((size_t)kRenderFrames * channels);
+    worker.out.resize(worker.in.size());
+    return engine;
+}
+
+bool RenderFile(Worker& worker, const EffectParams& preset, BatchJob& job) {
+    WavReader reader;
+    if (!reader.Open(job.input.c_str())) {
+        fprintf(stderr, "Cannot read %s (not a supported WAV file?)\n", job.input.c_str());
+        return false;
+    }
+    const int channels = reader.Channels();
+    job.audioSeconds = reader.Frames() / (double)reader.SampleRate();
+
+    WavWriter writer;
+    if (!writer.Create(job.output.c_str(), reader.SampleRate(), channels)) {
+        fprintf(stderr, "Cannot write %s\n", job.output.c_str());
+        return false;
+    }
+    EffectEngine& engine = PrepareEngine(worker, preset, reader.SampleRate(), channels);
+
+    bool ok = true;
+    for (uint64_t frame = 0; ok && frame < reader.Frames(); frame += kRenderFrames) {
+        const uint32_t count = (uint32_t)std::min<uint64_t>(kRenderFrames, reader.Frames() - frame);
+        engine.Process(reader.View(frame, count, worker.in.data()), worker.out.data(), count);
+        ok = writer.Write(worker.out.data(), count);
+    }
+    if (!writer.Close() || !ok) {
+        fprintf(stderr, "Write failed: %s\n", job.output.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Segment splitting: the worker states that started from different
+// histories have to agree to -100 dBFS by the end of the warm-up
+const float kWarmupTolerance = 1e-5f;
+const float kErrorFloor = 1e-6f;  // -120 dBFS, see RunChunkingCheck
+const double kMaxWarmupSeconds = 30.0;
+const float kProbeFloor = 0.1f;  // level the probe's plucks decay to
+const double kWarmupMarginSeconds = 0.5;
+const double kSeamCrossfadeMs = 20.0;
+const double kSeamCheckSeconds = 1.0;  // rendered past each seam for the error estimate
+const double kMinSegmentSeconds = 10.0;
+const int kSegmentsPerThread = 4;
+
+// Deterministic white noise at the given peak level
+void FillNoise(float* out, size_t samples, float level, uint32_t& seed) {
+    for (size_t i = 0; i < samples; ++i) {
+        seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+        out[i] = (float)((int32_t)seed) / 2147483648.0f * level;
+    }
+}
+
+// Renders the same probe on two engines with different histories, one
+// after a full-scale noise burst and one after silence, and returns how far
+// apart their outputs are at each frame. The probe is noise plucked once a
+// second, so envelopes go through attack and release, decaying towards
+// floorLevel.
+std::vector<float> ProbeDifference(const EffectParams& preset, float rate, int channels, float floorLevel) {
+    Worker loud, quiet;
+    EffectEngine& a = PrepareEngine(loud, preset, rate, channels);
+    EffectEngine& b = PrepareEngine(quiet, preset, rate, channels);
+    std::vector<float> silence(loud.in.size(), 0.0f);
+    uint32_t seed = 0x2545F491u;
+    for (uint64_t frame = 0; frame < (uint64_t)rate; frame += kRenderFrames) {
+        const uint32_t count = (uint32_t)std::min<uint64_t>(kRenderFrames, (uint64_t)rate - frame);
+        FillNoise(loud.in.data(), (size_t)count * channels, 0.9f, seed);
+        a.Process(loud.in.data(), loud.out.data(), count);
+        b.Process(silence.data(), quiet.out.data(), count);
+    }
+    const uint64_t probeFrames = (uint64_t)(rate * kMaxWarmupSeconds);
+    const uint64_t pluckFrames = (uint64_t)rate;
+    const float decay = expf(-4.0f / rate);
+    float level = 0.0f;
+    std::vector<float> difference((size_t)probeFrames, 0.0f);
+    for (uint64_t frame = 0; frame < probeFrames; frame += kRenderFrames) {
+        const uint32_t count = (uint32_t)std::min<uint64_t>(kRenderFrames, probeFrames - frame);
+        FillNoise(loud.in.data(), (size_t)count * channels, 1.0f, seed);
+        for (uint32_t f = 0; f < count; ++f) {
+            level = ((frame + f) % pluckFrames == 0) ? 0.5f : std::max(level * decay, floorLevel);
+            for (int c = 0; c < channels; ++c) loud.in[f * channels + c] *= level;
+        }
+        a.Process(loud.in.data(), loud.out.data(), count);
+        b.Process(loud.in.data(), quiet.out.data(), count);
+        for (size_t i = 0; i < (size_t)count * channels; ++i) {
+            float& worst = difference[(size_t)(frame + i / channels)];
+            worst = std::max(worst, fabsf(loud.out[i] - quiet.out[i]));
+        }
+    }
+    return difference;
+}
+
+// How long the preset takes to forget its history (unless warmupSeconds
+// >= 0 gives it). With plucks that decay to silence, the warm-up is where
+// the two probe outputs stop differing. That covers every kind of state at
+// once: filter memories, compressor and wah envelopes, delay lines and the
+// reverb tail. Some memory is never lost, and silence can hide it:
+// near-silence lets state such as the wah's coefficient deadband fall back
+// into step, which real playing never does. So a second pair of engines
+// hears plucks that only decay to kProbeFloor, and the largest difference
+// of either pair after the warm-up goes to residual.
+uint64_t EstimateWarmupFrames(const EffectParams& preset, float rate, int channels, double warmupSeconds,
+    double& residual) {
+    const std::vector<float> plucked = ProbeDifference(preset, rate, channels, 0.0f);
+    const uint64_t probeFrames = plucked.size();
+    const uint64_t pluckFrames = (uint64_t)rate;
+    uint64_t settled = 0;
+    for (uint64_t frame = 0; frame < probeFrames; ++frame) {
+        if (plucked[(size_t)frame] > kWarmupTolerance) settled = frame + 1;
+    }
+    const uint64_t warmup = (warmupSeconds >= 0.0) ? (uint64_t)(warmupSeconds * rate) :
+        settled + (uint64_t)(rate * kWarmupMarginSeconds);
+    // From the end of a given warm-up, or where the probe settled (the margin
+    // is extra); over the last pluck if it never did
+    const uint64_t measured = (warmupSeconds >= 0.0) ? warmup : settled;
+    const size_t from = (size_t)std::min(measured, probeFrames - pluckFrames);
+    const std::vector<float> played = ProbeDifference(preset, rate, channels, kProbeFloor);
+    residual = std::max(*std::max_element(plucked.begin() + from, plucked.end()),
+        *std::max_element(played.begin() + from, played.end()));
+    if (residual > kWarmupTolerance) {
+        fprintf(stderr, "After a %.2f s warm-up the preset still remembers its history at %.1f dBFS; "
+            "expect errors at about that level\n", warmup / (double)rate, 20.0 * log10(residual));
+    }
+    return warmup;
+}
+
+struct Segment {
+    uint64_t begin;         // output frames this segment owns: [begin, end)
+    uint64_t end;
+    uint64_t warmupStart;   // where it starts listening to the input
+    uint64_t renderEnd;     // end plus the seam check into the next segment
+    std::vector<float> out; // frames [begin, renderEnd)
+    bool done;
+};
+
+// The engine first runs on silence up to warmupStart. Once their tails are
+// silent the effects are skipped, which only steps their LFOs exactly as
+// processing would, so tremolo, chorus and wah come in at the phase the
+// serial render has there. Then it hears the input from warmupStart on,
+// and its state converges over the warm-up, whose output is dropped.
+void RenderSegment(Worker& worker, const EffectParams& preset, const WavReader& reader, Segment& segment) {
+    const int channels = reader.Channels();
+    EffectEngine& engine = PrepareEngine(worker, preset, reader.SampleRate(), channels);
+    std::fill(worker.in.begin(), worker.in.end(), 0.0f);
+    for (uint64_t frame = 0; frame < segment.warmupStart; frame += kRenderFrames) {
+        const uint32_t count = (uint32_t)std::min<uint64_t>(kRenderFrames, segment.warmupStart - frame);
+        engine.Process(worker.in.data(), worker.out.data(), count);
+    }
+    for (uint64_t frame = segment.warmupStart; frame < segment.begin; frame += kRenderFrames) {
+        const uint32_t count = (uint32_t)std::min<uint64_t>(kRenderFrames, segment.begin - frame);
+        engine.Process(reader.View(frame, count, worker.in.data()), worker.out.data(), count);
+    }
+    segment.out.resize((size_t)(segment.renderEnd - segment.begin) * channels);
+    for (uint64_t frame = segment.begin; frame < segment.renderEnd; frame += kRenderFrames) {
+        const uint32_t count = (uint32_t)std::min<uint64_t>(kRenderFrames, segment.renderEnd - frame);
+        engine.Process(reader.View(frame, count, worker.in.data()),
+            &segment.out[(size_t)(frame - segment.begin) * channels], count);
+    }
+}
+
+// Renders the whole input on one engine and compares it with the file at
+// outPath; the largest sample difference goes to maxError
+bool CompareWithSerial(const EffectParams& preset, const WavReader& reader, const char* outPath,
+    double& maxError) {
+    WavReader written;
+    if (!written.Open(outPath) || written.Frames() != reader.Frames() ||
+        written.Channels() != reader.Channels()) {
+        fprintf(stderr, "Cannot read back %s\n", outPath);
+        return false;
+    }
+    Worker worker;
+    EffectEngine& engine = PrepareEngine(worker, preset, reader.SampleRate(), reader.Channels());
+    std::vector<float> check(worker.in.size());
+    maxError = 0.0;
+    for (uint64_t frame = 0; frame < reader.Frames(); frame += kRenderFrames) {
+        const uint32_t count = (uint32_t)std::min<uint64_t>(kRenderFrames, reader.Frames() - frame);
+        engine.Process(reader.View(frame, count, worker.in.data()), worker.out.data(), count);
+        const float* result = written.View(frame, count, check.data());
+        for (size_t i = 0; i < (size_t)count * reader.Channels(); ++i) {
+            maxError = std::max(maxError, (double)fabsf(result[i] - worker.out[i]));
+        }
+    }
+    return true;
+}
+
+std::string FormatLevel(double level) {
+    if (level <= 0.0) return "bit-exact";
+    char text[32];
+    snprintf(text, sizeof(text), "%.1f dBFS", 20.0 * log10(level));
+    return text;
+}
+
+// Pipe mode: frames per block read from stdin and handed to the engine
+const uint32_t kPipeBlockFrames = 16384;
+// Blocks the reader thread may have read ahead, plus the one in use
+const int kPipeBlocks = 4;
+
+// Reads stdin in whole blocks, optionally on its own thread a few blocks
+// ahead, so processing never waits on the pipe while input is available
+class BlockReader {
+public:
+    BlockReader(FILE* input, size_t blockBytes, bool threaded)
+        : input(input), produced(0), taken(0), released(0), finished(false), stopping(false) {
+        const int count = threaded ? kPipeBlocks : 1;
+        for (int i = 0; i < count; ++i) {
+            blocks.emplace_back(blockBytes);
+            sizes.push_back(0);
+        }
+        if (threaded) worker = std::thread(&BlockReader::Run, this);
+    }
+
+    // Waits for the reader thread, which can only stop between blocks: call
+    // once the input has ended, or accept that it reads one more block
+    ~BlockReader() {
+        if (!worker.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+    }
+
+    // The next block, valid until the following call; 0 bytes at the end
+    size_t Next(const uint8_t*& data) {
+        if (!worker.joinable()) {
+            sizes[0] = fread(blocks[0].data(), 1, blocks[0].size(), input);
+            data = blocks[0].data();
+            return sizes[0];
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        released = taken;  // the caller is done with the previous block
+        wake.notify_all();
+        wake.wait(lock, [this] { return produced > taken || finished; });
+        if (produced == taken) return 0;
+        const size_t index = (size_t)(taken++ % blocks.size());
+        data = blocks[index].data();
+        return sizes[index];
+    }
+
+private:
+    void Run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [this] { return produced - released < blocks.size() || stopping; });
+            if (stopping) break;
+            const size_t index = (size_t)(produced % blocks.size());
+            lock.unlock();
+            const size_t bytes = fread(blocks[index].data(), 1, blocks[index].size(), input);
+            lock.lock();
+            sizes[index] = bytes;
+            if (bytes > 0) ++produced;
+            if (bytes < blocks[index].size()) break;
+            wake.notify_all();
+        }
+        finished = true;
+        wake.notify_all();
+    }
+
+    FILE* input;
+    std::vector<std::vector<uint8_t>> blocks;
+    std::vector<size_t> sizes;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    uint64_t produced;  // blocks read
+    uint64_t taken;     // handed to the caller
+    uint64_t released;  // given back by the caller
+    bool finished;
+    bool stopping;
+};
+
+// Sweep: one combination of the grid
+struct SweepJob {
+    EffectParams params;
+    std::vector<size_t> choice;  // index into each axis's values
+    std::string output;
+    double lufs;
+    double peakDb;
+    bool ok;
+};
+
+// Renders the shared input with the job's parameters, measuring the output
+// as it goes. Reads input straight from the caller's buffer, no copy.
+bool RenderSweep(Worker& worker, const float* input, uint64_t frames, float sampleRate, int channels,
+    SweepJob& job) {
+    WavWriter writer;
+    if (!writer.Create(job.output.c_str(), sampleRate, channels)) {
+        fprintf(stderr, "Cannot write %s\n", job.output.c_str());
+        return false;
+    }
+    EffectEngine& engine = PrepareEngine(worker, job.params, sampleRate, channels);
+    LoudnessMeter meter;
+    meter.Prepare(sampleRate, channels);
+
+    bool ok = true;
+    for (uint64_t frame = 0; ok && frame < frames; frame += kRenderFrames) {
+        const uint32_t count = (uint32_t)std::min<uint64_t>(kRenderFrames, frames - frame);
+        engine.Process(input + frame * channels, worker.out.data(), count);
+        meter.Add(worker.out.data(), count);
+        ok = writer.Write(worker.out.data(), count);
+    }
+    if (!writer.Close() || !ok) {
+        fprintf(stderr, "Write failed: %s\n", job.output.c_str());
+        return false;
+    }
+    job.lufs = meter.IntegratedLufs();
+    job.peakDb = meter.PeakDb();
+    return true;
+}
+
+// Loudness or level for the summary; -inf (all gated, or silent) as text
+std::string FormatDb(double db) {
+    if (!std::isfinite(db)) return "-inf";
+    char text[32];
+    snprintf(text, sizeof(text), "%.2f", db);
+    return text;
+}
+
+} // namespace
+
+int RunBatchRender(const char* presetPath, const char* outDir, const std::vector<std::string>& inputs,
+    int threads) {
+    EffectParams preset;
+    if (presetPath && *presetPath && !LoadPresetFile(presetPath, preset)) return 2;
+
+    std::vector<BatchJob> jobs(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        BatchJob& job = jobs[i];
+        job.input = inputs[i];
+        job.output = std::string(outDir) + "/" + FileName(inputs[i]);
+        job.bytes = 0;
+        job.audioSeconds = 0.0;
+        job.renderSeconds = 0.0;
+        job.ok = false;
+        MappedFile file;
+        if (file.Open(job.input.c_str())) job.bytes = file.Size();
+    }
+    // Largest first, so no long file is left to start when the others finish
+    std::vector<BatchJob*> order;
+    for (BatchJob& job : jobs) order.push_back(&job);
+    std::stable_sort(order.begin(), order.end(),
+        [](const BatchJob* a, const BatchJob* b) { return a->bytes > b->bytes; });
+
+    WorkStealingPool pool(threads);
+    std::vector<Worker> workers(pool.Threads());
+    std::mutex printMutex;
+    printf("Rendering %zu files on %d threads\n", jobs.size(), pool.Threads());
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (BatchJob* job : order) {
+        pool.Submit([job, &workers, &preset, &printMutex](int worker) {
+            const std::chrono::steady_clock::time_point jobStart = std::chrono::steady_clock::now();
+            job->ok = RenderFile(workers[worker], preset, *job);
+            job->renderSeconds = ElapsedSeconds(jobStart);
+            std::lock_guard<std::mutex> lock(printMutex);
+            if (job->ok) {
+                printf("%-40s %9.1f s audio %8.2f s %8.1fx realtime\n", FileName(job->input).c_str(),
+                    job->audioSeconds, job->renderSeconds,
+                    job->audioSeconds / std::max(job->renderSeconds, 1e-9));
+            }
+            else {
+                printf("%-40s FAILED\n", FileName(job->input).c_str());
+            }
+        });
+    }
+    pool.Wait();
+    const double wallSeconds = std::max(ElapsedSeconds(start), 1e-9);
+
+    double audioSeconds = 0.0, busySeconds = 0.0;
+    int failures = 0;
+    for (const BatchJob& job : jobs) {
+        busySeconds += job.renderSeconds;
+        if (job.ok) audioSeconds += job.audioSeconds;
+        else ++failures;
+    }
+    const double realtime = audioSeconds / wallSeconds;
+    printf("\n%zu files, %.1f s of audio in %.2f s: %.1fx realtime, %.1fx realtime per core "
+        "(%d threads, %.0f%% busy)\n", jobs.size() - failures, audioSeconds, wallSeconds, realtime,
+        realtime / pool.Threads(), pool.Threads(), 100.0 * busySeconds / (wallSeconds * pool.Threads()));
+    if (failures) printf("%d files FAILED\n", failures);
+    return failures ? 1 : 0;
+}
+
+int RunBatchCommand(int argc, char* argv[]) {
+    int threads = 0;
+    int arg = 0;
+    if (arg + 1 < argc && strcmp(argv[arg], "--threads") == 0) {
+        threads = atoi(argv[arg + 1]);
+        arg += 2;
+    }
+    if (argc - arg < 3) {
+        fprintf(stderr, "Usage: --batch [--threads N] <preset> <outDir> <file.wav|@list>...\n");
+        return 2;
+    }
+    const char* presetPath = argv[arg];
+    const char* outDir = argv[arg + 1];
+    std::vector<std::string> inputs;
+    for (arg += 2; arg < argc; ++arg) {
+        if (argv[arg][0] != '@') {
+            inputs.push_back(argv[arg]);
+            continue;
+        }
+        FILE* list = fopen(argv[arg] + 1, "r");
+        if (!list) {
+            fprintf(stderr, "Cannot open %s\n", argv[arg] + 1);
+            return 2;
+        }
+        char line[4096];
+        while (fgets(line, sizeof(line), list)) {
+            size_t length = strcspn(line, "\r\n");
+            line[length] = '\0';
+            if (length) inputs.push_back(line);
+        }
+        fclose(list);
+    }
+    return RunBatchRender(presetPath, outDir, inputs, threads);
+}
+
+int RunSegmentRender(const char* presetPath, const char* inPath, const char* outPath, int threads,
+    double segmentSeconds, double warmupSeconds, bool verify) {
+    EffectParams preset;
+    if (presetPath && *presetPath && !LoadPresetFile(presetPath, preset)) return 2;
+    WavReader reader;
+    if (!reader.Open(inPath)) {
+        fprintf(stderr, "Cannot read %s (not a supported WAV file?)\n", inPath);
+        return 2;
+    }
+    const float rate = reader.SampleRate();
+    const int channels = reader.Channels();
+    const uint64_t frames = reader.Frames();
+    WorkStealingPool pool(threads);
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const bool estimated = warmupSeconds < 0.0;
+    double residual = 0.0;
+    const uint64_t warmup = EstimateWarmupFrames(preset, rate, channels, warmupSeconds, residual);
+    const uint64_t crossfade = std::max<uint64_t>(1, (uint64_t)(rate * kSeamCrossfadeMs / 1000.0));
+    const uint64_t seamCheck = std::max(crossfade, (uint64_t)(rate * kSeamCheckSeconds));
+    // A few segments per thread for the stealing to even out, but long
+    // enough that the warm-up is a small overhead
+    uint64_t segmentFrames = (uint64_t)(segmentSeconds * rate);
+    if (segmentSeconds <= 0.0) {
+        const uint64_t parts = (uint64_t)pool.Threads() * kSegmentsPerThread;
+        segmentFrames = std::max((frames + parts - 1) / parts,
+            std::max(8 * warmup, (uint64_t)(kMinSegmentSeconds * rate)));
+    }
+    segmentFrames = std::max(segmentFrames, crossfade);
+    const size_t count = (size_t)std::max<uint64_t>(1, (frames + segmentFrames - 1) / segmentFrames);
+    std::vector<Segment> segments(count);
+    for (size_t k = 0; k < count; ++k) {
+        Segment& segment = segments[k];
+        segment.begin = std::min(frames, k * segmentFrames);
+        segment.end = std::min(frames, segment.begin + segmentFrames);
+        segment.warmupStart = (segment.begin > warmup) ? segment.begin - warmup : 0;
+        segment.renderEnd = std::min(frames, segment.end + seamCheck);
+        segment.done = false;
+    }
+    printf("%s: %.1f s in %zu segments of %.1f s, %.2f s warm-up (%s), %.0f ms crossfades, %d threads\n",
+        FileName(inPath).c_str(), frames / (double)rate, count, segmentFrames / (double)rate,
+        warmup / (double)rate, estimated ? "estimated" : "given", kSeamCrossfadeMs, pool.Threads());
+
+    WavWriter writer;
+    if (!writer.Create(outPath, rate, channels)) {
+        fprintf(stderr, "Cannot write %s\n", outPath);
+        return 2;
+    }
+    std::vector<Worker> workers(pool.Threads());
+    std::mutex doneMutex;
+    std::condition_variable segmentDone;
+    for (Segment& segment : segments) {
+        Segment* job = &segment;
+        pool.Submit([job, &workers, &preset, &reader, &doneMutex, &segmentDone](int worker) {
+            RenderSegment(workers[worker], preset, reader, *job);
+            std::lock_guard<std::mutex> lock(doneMutex);
+            job->done = true;
+            segmentDone.notify_all();
+        });
+    }
+
+    // Stitch in order as the segments come in: each one fades in over the
+    // previous segment's render past its end. Both are renders of the same
+    // audio, so where they differ after a seam is how far the new segment
+    // still is from having converged, and that is the error estimate.
+    // Differences can show up well after the seam (a coefficient update that
+    // falls on another sample), so the comparison runs longer than the fade.
+    std::vector<float> previousTail;
+    double seamError = 0.0;
+    uint64_t worstSeam = 0;
+    bool ok = true;
+    for (Segment& segment : segments) {
+        {
+            std::unique_lock<std::mutex> lock(doneMutex);
+            segmentDone.wait(lock, [&segment] { return segment.done; });
+        }
+        float* out = segment.out.data();
+        const size_t overlap = previousTail.size() / channels;
+        const size_t fadeFrames = std::min<size_t>(overlap, crossfade);
+        for (size_t f = 0; f < overlap; ++f) {
+            const float fade = (f < fadeFrames) ? (float)((f + 0.5) / fadeFrames) : 1.0f;
+            for (int c = 0; c < channels; ++c) {
+                const float previous = previousTail[f * channels + c];
+                float& sample = out[f * channels + c];
+                const double difference = fabsf(sample - previous);
+                if (difference > seamError) {
+                    seamError = difference;
+                    worstSeam = segment.begin;
+                }
+                sample = previous + (sample - previous) * fade;
+            }
+        }
+        const size_t owned = (size_t)(segment.end - segment.begin);
+        ok = writer.Write(out, (uint32_t)owned) && ok;
+        previousTail.assign(segment.out.begin() + owned * channels, segment.out.end());
+        std::vector<float>().swap(segment.out);
+    }
+    pool.Wait();
+    ok = writer.Close() && ok;
+    const double wallSeconds = std::max(ElapsedSeconds(start), 1e-9);
+    if (!ok) {
+        fprintf(stderr, "Write failed: %s\n", outPath);
+        return 1;
+    }
+    const double realtime = frames / (double)rate / wallSeconds;
+    printf("Rendered in %.2f s: %.1fx realtime, %.1fx realtime per core\n", wallSeconds, realtime,
+        realtime / pool.Threads());
+    // At a seam the new segment is off by about the mismatch plus the error
+    // of the previous one, which has been warming up for longer. Memory that
+    // survives the warm-up can happen to agree at every seam and differ
+    // later, so the probe's residual stands in for it, doubled as well. How
+    // far that memory shows depends on the material, so this is an estimate,
+    // not a guarantee. The engine itself is only equivalent to within
+    // -120 dBFS anyway.
+    const double estimate = std::max(std::max(2.0 * seamError, 2.0 * residual), (double)kErrorFloor);
+    printf("Error estimate: %s (worst seam mismatch %s", FormatLevel(estimate).c_str(),
+        FormatLevel(seamError).c_str());
+    if (seamError > 0.0) printf(" at %.2f s", worstSeam / (double)rate);
+    printf(")\n");
+    if (!verify) return 0;
+
+    const std::chrono::steady_clock::time_point serialStart = std::chrono::steady_clock::now();
+    double maxError = 0.0;
+    if (!CompareWithSerial(preset, reader, outPath, maxError)) return 2;
+    const double serialSeconds = ElapsedSeconds(serialStart);
+    printf("Serial render: %.2f s (%.1fx the split render). Error against it: %s, %s the estimate\n",
+        serialSeconds, serialSeconds / wallSeconds, FormatLevel(maxError).c_str(),
+        maxError <= estimate ? "within" : "ABOVE");
+    return maxError <= estimate ? 0 : 1;
+}
+
+int RunSegmentCommand(int argc, char* argv[]) {
+    int threads = 0;
+    double segmentSeconds = 0.0, warmupSeconds = -1.0;
+    bool verify = false;
+    int arg = 0;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; ++arg) {
+        if (strcmp(argv[arg], "--verify") == 0) verify = true;
+        else if (arg + 1 < argc && strcmp(argv[arg], "--threads") == 0) threads = atoi(argv[++arg]);
+        else if (arg + 1 < argc && strcmp(argv[arg], "--segment") == 0) segmentSeconds = atof(argv[++arg]);
+        else if (arg + 1 < argc && strcmp(argv[arg], "--warmup") == 0) warmupSeconds = atof(argv[++arg]);
+        else break;
+    }
+    if (argc - arg != 3) {
+        fprintf(stderr, "Usage: --split [--threads N] [--segment S] [--warmup S] [--verify] "
+            "<preset> <in.wav> <out.wav>\n");
+        return 2;
+    }
+    return RunSegmentRender(argv[arg], argv[arg + 1], argv[arg + 2], threads, segmentSeconds, warmupSeconds,
+        verify);
+}
+
+int RunPipeRender(const EffectParams& preset, SampleFormat format, float sampleRate, int channels,
+    bool readerThread) {
+    if (format != SampleFormat::Float32 && format != SampleFormat::Int16) return 2;
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    // Both sides move whole blocks; stdio buffering would only add a copy
+    setvbuf(stdin, nullptr, _IONBF, 0);
+    setvbuf(stdout, nullptr, _IONBF, 0);
+
+    EffectEngine engine;
+    engine.SetBlockSize(0);
+    engine.SetParams(preset);
+    engine.Prepare(sampleRate, kPipeBlockFrames, channels);
+    const size_t samples = (size_t)kPipeBlockFrames * channels;
+    const size_t frameBytes = (size_t)SampleFormatBytes(format) * channels;
+    std::vector<float> in(samples), out(samples);
+    std::vector<uint8_t> encoded(format == SampleFormat::Float32 ? 0 : samples * SampleFormatBytes(format));
+    TpdfDither dither;
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint64_t frames = 0;
+    size_t leftover = 0;
+    BlockReader reader(stdin, kPipeBlockFrames * frameBytes, readerThread);
+    const uint8_t* data = nullptr;
+    for (size_t bytes; (bytes = reader.Next(data)) > 0;) {
+        const uint32_t count = (uint32_t)(bytes / frameBytes);
+        leftover = bytes % frameBytes;
+        const float* source = (const float*)data;
+        if (format != SampleFormat::Float32) {
+            ConvertToFloat(format, data, in.data(), (size_t)count * channels);
+            source = in.data();
+        }
+        engine.Process(source, out.data(), count);
+        const void* result = out.data();
+        if (format != SampleFormat::Float32) {
+            ConvertFromFloat(format, out.data(), encoded.data(), (size_t)count * channels, &dither);
+            result = encoded.data();
+        }
+        if (fwrite(result, frameBytes, count, stdout) != count) {
+            fprintf(stderr, "Writing to stdout failed\n");
+            return 1;
+        }
+        frames += count;
+    }
+    if (ferror(stdin)) {
+        fprintf(stderr, "Reading from stdin failed\n");
+        return 1;
+    }
+    if (leftover) fprintf(stderr, "Ignored %zu bytes of a partial frame at the end of the input\n", leftover);
+    const double seconds = std::max(ElapsedSeconds(start), 1e-9);
+    fprintf(stderr, "%llu frames (%.1f s) in %.2f s: %.1fx realtime\n", (unsigned long long)frames,
+        frames / (double)sampleRate, seconds, frames / (double)sampleRate / seconds);
+    return 0;
+}
+
+int RunPipeCommand(int argc, char* argv[]) {
+    EffectParams preset;
+    SampleFormat format = SampleFormat::Float32;
+    float sampleRate = 48000.0f;
+    int channels = 2;
+    bool readerThread = false;
+    for (int arg = 0; arg < argc; ++arg) {
+        const char* option = argv[arg];
+        const char* equals = strchr(option, '=');
+        if (strcmp(option, "--reader-thread") == 0) {
+            readerThread = true;
+        }
+        else if (arg + 1 < argc && strcmp(option, "--format") == 0) {
+            const char* name = argv[++arg];
+            if (strcmp(name, "f32") == 0) format = SampleFormat::Float32;
+            else if (strcmp(name, "s16") == 0) format = SampleFormat::Int16;
+            else format = SampleFormat::Unknown;
+        }
+        else if (arg + 1 < argc && strcmp(option, "--rate") == 0) {
+            sampleRate = (float)atof(argv[++arg]);
+        }
+        else if (arg + 1 < argc && strcmp(option, "--channels") == 0) {
+            channels = atoi(argv[++arg]);
+        }
+        else if (strncmp(option, "--", 2) != 0 && equals) {
+            // name=value on top of what came before
+            const std::string name(option, equals - option);
+            if (!SetPresetValue(preset, name.c_str(), equals + 1)) {
+                fprintf(stderr, "Cannot use '%s'\n", option);
+                return 2;
+            }
+        }
+        else if (strncmp(option, "--", 2) != 0) {
+            if (!LoadPresetFile(option, preset)) return 2;
+        }
+        else {
+            format = SampleFormat::Unknown;
+            break;
+        }
+    }
+    if (format == SampleFormat::Unknown || sampleRate < 8000.0f || sampleRate > 768000.0f ||
+        channels < 1 || channels > 32) {
+        fprintf(stderr, "Usage: --pipe [--format f32|s16] [--rate Hz] [--channels N] [--reader-thread] "
+            "[preset file | name=value]... < in.raw > out.raw\n");
+        return 2;
+    }
+    return RunPipeRender(preset, format, sampleRate, channels, readerThread);
+}
+
+int RunSweepRender(const char* presetPath, const char* inPath, const char* outDir,
+    const std::vector<SweepAxis>& axes, int threads) {
+    EffectParams preset;
+    if (presetPath && *presetPath && !LoadPresetFile(presetPath, preset)) return 2;
+    WavReader reader;
+    if (!reader.Open(inPath)) {
+        fprintf(stderr, "Cannot read %s (not a supported WAV file?)\n", inPath);
+        return 2;
+    }
+    const int channels = reader.Channels();
+    const float sampleRate = reader.SampleRate();
+    const uint64_t frames = reader.Frames();
+
+    // Every worker reads this one buffer: the mapping itself for float32,
+    // otherwise the file decoded once up front
+    std::vector<float> decoded;
+    const float* input = reader.FloatSamples();
+    if (!input) {
+        decoded.resize((size_t)frames * channels);
+        for (uint64_t frame = 0; frame < frames; frame += kRenderFrames) {
+            const uint32_t count = (uint32_t)std::min<uint64_t>(kRenderFrames, frames - frame);
+            reader.Read(frame, count, decoded.data() + frame * channels);
+        }
+        input = decoded.data();
+    }
+
+    // The grid, first axis slowest
+    std::string base = FileName(inPath);
+    const size_t dot = base.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) base.resize(dot);
+    size_t combinations = 1;
+    for (const SweepAxis& axis : axes) combinations *= axis.values.size();
+    std::vector<SweepJob> jobs(combinations);
+    for (size_t i = 0; i < combinations; ++i) {
+        SweepJob& job = jobs[i];
+        job.params = preset;
+        job.choice.resize(axes.size());
+        job.output = std::string(outDir) + "/" + base;
+        size_t rest = i;
+        for (size_t a = axes.size(); a-- > 0;) {
+            job.choice[a] = rest % axes[a].values.size();
+            rest /= axes[a].values.size();
+        }
+        for (size_t a = 0; a < axes.size(); ++a) {
+            const std::string& value = axes[a].values[job.choice[a]];
+            if (!SetPresetValue(job.params, axes[a].name.c_str(), value.c_str())) {
+                fprintf(stderr, "Cannot use %s=%s\n", axes[a].name.c_str(), value.c_str());
+                return 2;
+            }
+            job.output += "_" + axes[a].name + "-" + value;
+        }
+        job.output += ".wav";
+        job.lufs = job.peakDb = -HUGE_VAL;
+        job.ok = false;
+    }
+
+    WorkStealingPool pool(threads);
+    std::vector<Worker> workers(pool.Threads());
+    printf("Rendering %zu combinations of %s (%.1f s) on %d threads\n", jobs.size(), FileName(inPath).c_str(),
+        frames / (double)sampleRate, pool.Threads());
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (SweepJob& job : jobs) {
+        SweepJob* sweep = &job;
+        pool.Submit([sweep, input, frames, sampleRate, channels, &workers](int worker) {
+            sweep->ok = RenderSweep(workers[worker], input, frames, sampleRate, channels, *sweep);
+        });
+    }
+    // The input's own loudness, measured while the pool works
+    LoudnessMeter inputMeter;
+    inputMeter.Prepare(sampleRate, channels);
+    for (uint64_t frame = 0; frame < frames; frame += kRenderFrames) {
+        const uint32_t count = (uint32_t)std::min<uint64_t>(kRenderFrames, frames - frame);
+        inputMeter.Add(input + frame * channels, count);
+    }
+    const double inputLufs = inputMeter.IntegratedLufs();
+    pool.Wait();
+    const double wallSeconds = std::max(ElapsedSeconds(start), 1e-9);
+
+    // Summary in grid order, on stdout and as CSV
+    const std::string csvPath = std::string(outDir) + "/sweep.csv";
+    FILE* csv = fopen(csvPath.c_str(), "w");
+    if (!csv) fprintf(stderr, "Cannot write %s\n", csvPath.c_str());
+    printf("Input: %s LUFS, peak %s dBFS\n\n", FormatDb(inputLufs).c_str(),
+        FormatDb(inputMeter.PeakDb()).c_str());
+    std::vector<int> widths;
+    for (const SweepAxis& axis : axes) {
+        int width = (int)axis.name.size();
+        for (const std::string& value : axis.values) width = std::max(width, (int)value.size());
+        widths.push_back(width);
+        printf("%-*s  ", width, axis.name.c_str());
+        if (csv) fprintf(csv, "%s,", axis.name.c_str());
+    }
+    printf("%8s %9s %10s  file\n", "LUFS", "vs input", "peak dBFS");
+    if (csv) fprintf(csv, "lufs,lufs_vs_input,peak_dbfs,file\n");
+
+    int failures = 0;
+    for (const SweepJob& job : jobs) {
+        for (size_t a = 0; a < axes.size(); ++a) {
+            const std::string& value = axes[a].values[job.choice[a]];
+            printf("%-*s  ", widths[a], value.c_str());
+            if (csv) fprintf(csv, "%s,", value.c_str());
+        }
+        if (!job.ok) {
+            ++failures;
+            printf("FAILED\n");
+            if (csv) fprintf(csv, ",,,\n");
+            continue;
+        }
+        const std::string lufs = FormatDb(job.lufs);
+        const std::string delta = FormatDb(job.lufs - inputLufs);
+        const std::string peak = FormatDb(job.peakDb);
+        printf("%8s %9s %10s  %s\n", lufs.c_str(), delta.c_str(), peak.c_str(), FileName(job.output).c_str());
+        if (csv) fprintf(csv, "%s,%s,%s,%s\n", lufs.c_str(), delta.c_str(), peak.c_str(),
+            FileName(job.output).c_str());
+    }
+    if (csv && fclose(csv) != 0) fprintf(stderr, "Cannot write %s\n", csvPath.c_str());
+
+    const double audioSeconds = (jobs.size() - failures) * (frames / (double)sampleRate);
+    printf("\n%zu renders, %.1f s of audio in %.2f s: %.1fx realtime (%d threads)\n", jobs.size() - failures,
+        audioSeconds, wallSeconds, audioSeconds / wallSeconds, pool.Threads());
+    if (failures) printf("%d renders FAILED\n", failures);
+    return failures ? 1 : 0;
+}
+
+int RunSweepCommand(int argc, char* argv[]) {
+    int threads = 0;
+    int arg = 0;
+    if (arg + 1 < argc && strcmp(argv[arg], "--threads") == 0) {
+        threads = atoi(argv[arg + 1]);
+        arg += 2;
+    }
+    if (argc - arg < 4) {
+        fprintf(stderr, "Usage: --sweep [--threads N] <preset> <in.wav> <outDir> "
+            "<name=v1,v2,...|name=low:high:count>...\n");
+        return 2;
+    }
+    const char* presetPath = argv[arg];
+    const char* inPath = argv[arg + 1];
+    const char* outDir = argv[arg + 2];
+    std::vector<SweepAxis> axes;
+    for (arg += 3; arg < argc; ++arg) {
+        const char* spec = argv[arg];
+        const char* equals = strchr(spec, '=');
+        SweepAxis axis;
+        if (equals) axis.name.assign(spec, equals - spec);
+        double low = 0.0, high = 0.0;
+        int count = 0;
+        char extra = 0;
+        double current;
+        if (!equals || !GetPresetValue(EffectParams(), axis.name.c_str(), current)) {
+            fprintf(stderr, "Not a parameter: '%s'\n", spec);
+            return 2;
+        }
+        if (sscanf(equals + 1, "%lf:%lf:%d%c", &low, &high, &count, &extra) == 3) {
+            // Evenly spaced, both ends included
+            if (count < 1) count = 1;
+            for (int i = 0; i < count; ++i) {
+                char value[32];
+                snprintf(value, sizeof(value), "%g", (count == 1) ? low : low + (high - low) * i / (count - 1));
+                axis.values.push_back(value);
+            }
+        }
+        else {
+            std::string list = equals + 1;
+            size_t begin = 0;
+            for (;;) {
+                const size_t comma = list.find(',', begin);
+                axis.values.push_back(list.substr(begin, comma - begin));
+                if (comma == std::string::npos) break;
+                begin = comma + 1;
+            }
+        }
+        // Checked here rather than after a partial render
+        for (const std::string& value : axis.values) {
+            EffectParams check;
+            if (value.empty() || !SetPresetValue(check, axis.name.c_str(), value.c_str())) {
+                fprintf(stderr, "Cannot use %s=%s\n", axis.name.c_str(), value.c_str());
+                return 2;
+            }
+        }
+        axes.push_back(axis);
+    }
+    return RunSweepRender(presetPath, inPath, outDir, axes, threads);
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "EffectChain.h"
+#include "SampleFormat.h"
+
+// Offline rendering through EffectEngine, for re-amping recorded DI tracks.
+// Portable: no audio device involved. Headless on Linux, main.cpp with
+// everything but AudioProcessor.cpp and gui.cpp, e.g.
+//   g++ -O2 -std=c++14 -o guitarfx $(ls *.cpp | grep -v -e AudioProcessor -e gui) -lpthread -lrt
+
+// Renders every input WAV through the preset file (see Presets.h; an empty
+// path keeps the defaults) into outDir, which must exist, under the same
+// file name as float32 WAV of the same length. Files are rendered in
+// parallel on a WorkStealingPool, largest first, with one EffectEngine per
+// worker that is reset between files. threads 0 uses every hardware thread.
+//
+// Prints a line per file and the throughput: the aggregate realtime factor
+// and the realtime factor per core, which stays flat as long as scaling is
+// linear. Returns non-zero if any file failed.
+int RunBatchRender(const char* presetPath, const char* outDir, const std::vector<std::string>& inputs,
+    int threads);
+
+// Command-line front end: [--threads N] <preset> <outDir> <file.wav|@list>...
+// where @list names a text file with one input path per line
+int RunBatchCommand(int argc, char* argv[]);
+
+// One long file rendered in parallel: split into segments that render
+// concurrently, each with a warm-up on the input before it so the effect
+// state (filters, envelopes, delay lines, reverb) has converged to what the
+// serial render has there, then crossfaded together over 20 ms. The
+// warm-up is measured from the preset unless warmupSeconds >= 0; the
+// segment length is chosen from the thread count unless segmentSeconds > 0.
+//
+// Reports an error estimate from the seams: each segment renders a second
+// past its end, and the largest difference there from the next segment
+// shows how far that one still is from the serial render. Memory that no
+// warm-up removes (the wah's coefficient deadband) comes from the warm-up
+// probe instead, and shows differently on different material, so this is
+// not a guarantee. verify renders the file serially as well and measures
+// the actual error; the result is then non-zero if that is above the
+// estimate.
+int RunSegmentRender(const char* presetPath, const char* inPath, const char* outPath, int threads,
+    double segmentSeconds, double warmupSeconds, bool verify);
+
+// Command line: [--threads N] [--segment S] [--warmup S] [--verify] <preset> <in.wav> <out.wav>
+int RunSegmentCommand(int argc, char* argv[]);
+
+// Streams raw interleaved PCM (Float32 or Int16, native little-endian) from
+// stdin through the preset to stdout in the same format, until stdin ends.
+// Blocks of 16384 frames, unbuffered stdio on both sides; readerThread reads
+// stdin on a separate thread a few blocks ahead. Prints throughput to stderr.
+int RunPipeRender(const EffectParams& preset, SampleFormat format, float sampleRate, int channels,
+    bool readerThread);
+
+// Command line: [--format f32|s16] [--rate Hz] [--channels N] [--reader-thread]
+// [preset file | name=value]..., applied in order, e.g.
+//   sox di.wav -t f32 - | guitarfx --pipe overdriveEnabled=on overdriveDrive=6 |
+//       sox -t f32 -r 48000 -c 2 - out.wav
+int RunPipeCommand(int argc, char* argv[]);
+
+// One axis of a parameter sweep: an EffectParams field (see Presets.h) and
+// the values it takes, as text
+struct SweepAxis {
+    std::string name;
+    std::vector<std::string> values;
+};
+
+// Renders the input through the preset with every combination of the axes'
+// values, in parallel on a WorkStealingPool, into outDir (which must exist)
+// as <input>_<name>-<value>...wav, float32. The input is decoded once and
+// shared by every worker; float32 files are used in place in the mapping.
+//
+// Prints a table in grid order with the integrated loudness (BS.1770) of
+// each render, its difference from the input's and the sample peak, and
+// writes the same to outDir/sweep.csv. Returns non-zero if any render failed.
+int RunSweepRender(const char* presetPath, const char* inPath, const char* outDir,
+    const std::vector<SweepAxis>& axes, int threads);
+
+// Command line: [--threads N] <preset> <in.wav> <outDir> <axis>...
+// where each axis is name=v1,v2,... or name=low:high:count (evenly spaced), e.g.
+//   --sweep tone.txt di.wav out overdriveDrive=2:10:5 overdriveTone=0.3,0.7 reverbMix=0,0.25
+int RunSweepCommand(int argc, char* argv[]);
@@ -0,0 +1,150 @@
+#include "Presets.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <string>
+
+namespace {
+
+struct Field {
+    const char* name;
+    enum Type { Bool, Float, Divider } type;  // Divider: int, 1, 2 or 4
+    size_t offset;
+};
+
+#define PRESET_FIELD(name, type) { #name, Field::type, offsetof(EffectParams, name) }
+
+const Field kFields[] = {
+    PRESET_FIELD(tremoloEnabled, Bool),
+    PRESET_FIELD(tremoloRate, Float),
+    PRESET_FIELD(tremoloDepth, Float),
+    PRESET_FIELD(chorusEnabled, Bool),
+    PRESET_FIELD(chorusRate, Float),
+    PRESET_FIELD(chorusDepth, Float),
+    PRESET_FIELD(chorusFeedback, Float),
+    PRESET_FIELD(chorusWidth, Float),
+    PRESET_FIELD(chorusRateDivider, Divider),
+    PRESET_FIELD(overdriveEnabled, Bool),
+    PRESET_FIELD(overdriveDrive, Float),
+    PRESET_FIELD(overdriveThreshold, Float),
+    PRESET_FIELD(overdriveTone, Float),
+    PRESET_FIELD(overdriveMix, Float),
+    PRESET_FIELD(bluesEnabled, Bool),
+    PRESET_FIELD(bluesGain, Float),
+    PRESET_FIELD(bluesTone, Float),
+    PRESET_FIELD(bluesLevel, Float),
+    PRESET_FIELD(compEnabled, Bool),
+    PRESET_FIELD(compLevel, Float),
+    PRESET_FIELD(compTone, Float),
+    PRESET_FIELD(compAttackMs, Float),
+    PRESET_FIELD(compSustainMs, Float),
+    PRESET_FIELD(reverbEnabled, Bool),
+    PRESET_FIELD(reverbSize, Float),
+    PRESET_FIELD(reverbDamping, Float),
+    PRESET_FIELD(reverbWidth, Float),
+    PRESET_FIELD(reverbMix, Float),
+    PRESET_FIELD(reverbRateDivider, Divider),
+    PRESET_FIELD(warmEnabled, Bool),
+    PRESET_FIELD(warmAmount, Float),
+    PRESET_FIELD(warmTone, Float),
+    PRESET_FIELD(warmSaturation, Float),
+    PRESET_FIELD(wahEnabled, Bool),
+    PRESET_FIELD(wahFreq, Float),
+    PRESET_FIELD(wahQ, Float),
+    PRESET_FIELD(wahMix, Float),
+    PRESET_FIELD(wahLfoRate, Float),
+    PRESET_FIELD(wahLfoDepth, Float),
+};
+
+#undef PRESET_FIELD
+
+const Field* FindField(const char* name) {
+    for (const Field& field : kFields) {
+        if (strcmp(field.name, name) == 0) return &field;
+    }
+    return nullptr;
+}
+
+bool ParseBool(const char* value, bool& out) {
+    if (strcmp(value, "1") == 0 || strcmp(value, "true") == 0 || strcmp(value, "on") == 0) {
+        out = true;
+        return true;
+    }
+    if (strcmp(value, "0") == 0 || strcmp(value, "false") == 0 || strcmp(value, "off") == 0) {
+        out = false;
+        return true;
+    }
+    return false;
+}
+
+std::string Trim(const std::string& text) {
+    const char* space = " \t\r\n";
+    size_t begin = text.find_first_not_of(space);
+    if (begin == std::string::npos) return std::string();
+    size_t end = text.find_last_not_of(space);
+    return text.substr(begin, end - begin + 1);
+}
+
+} // namespace
+
+bool SetPresetValue(EffectParams& params, const char* name, const char* value) {
+    const Field* field = FindField(name);
+    if (!field || !*value) return false;
+    char* base = (char*)&params + field->offset;
+    char* end = nullptr;
+    switch (field->type) {
+    case Field::Bool:
+        return ParseBool(value, *(bool*)base);
+    case Field::Float: {
+        float number = strtof(value, &end);
+        if (*end) return false;
+        *(float*)base = number;
+        return true;
+    }
+    case Field::Divider: {
+        long number = strtol(value, &end, 10);
+        if (*end || (number != 1 && number != 2 && number != 4)) return false;
+        *(int*)base = (int)number;
+        return true;
+    }
+    }
+    return false;
+}
+
+bool GetPresetValue(const EffectParams& params, const char* name, double& value) {
+    const Field* field = FindField(name);
+    if (!field) return false;
+    const char* base = (const char*)&params + field->offset;
+    switch (field->type) {
+    case Field::Bool: value = *(const bool*)base ? 1.0 : 0.0; break;
+    case Field::Float: value = *(const float*)base; break;
+    case Field::Divider: value = *(const int*)base; break;
+    }
+    return true;
+}
+
+bool LoadPresetFile(const char* path, EffectParams& params) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Cannot open preset %s\n", path);
+        return false;
+    }
+    char buffer[256];
+    bool ok = true;
+    for (int line = 1; ok && fgets(buffer, sizeof(buffer), file); ++line) {
+        std::string text(buffer);
+        size_t comment = text.find('#');
+        if (comment != std::string::npos) text.erase(comment);
+        text = Trim(text);
+        if (text.empty()) continue;
+        size_t equals = text.find('=');
+        if (equals == std::string::npos ||
+            !SetPresetValue(params, Trim(text.substr(0, equals)).c_str(), Trim(text.substr(equals + 1)).c_str())) {
+            fprintf(stderr, "%s:%d: cannot use '%s'\n", path, line, text.c_str());
+            ok = false;
+        }
+    }
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "EffectChain.h"
+
+// Presets as text, for the offline tools: one "name = value" per line,
+// named after the EffectParams members ("overdriveDrive = 6.5",
+// "reverbEnabled = on"). '#' starts a comment. Fields a file doesn't
+// mention keep their current value.
+
+// Sets one field; false if the name is unknown or the value doesn't parse.
+// Booleans take 1/0, true/false or on/off.
+bool SetPresetValue(EffectParams& params, const char* name, const char* value);
+
+// Reads a field as a number (booleans as 0/1); false if the name is unknown
+bool GetPresetValue(const EffectParams& params, const char* name, double& value);
+
+// Applies a preset file on top of params. Prints the offending line to
+// stderr and returns false on any error.
+bool LoadPresetFile(const char* path, EffectParams& params);
@@ -0,0 +1,174 @@
+#include "RealtimeThread.h"
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <mmsystem.h>
+#include <avrt.h>
+#pragma comment(lib, "avrt.lib")
+#pragma comment(lib, "winmm.lib")
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Stack the audio thread may use, touched up front
+const size_t kStackPrefaultBytes = 64 * 1024;
+const size_t kFallbackPageSize = 4096;
+
+size_t PageSize() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize ? info.dwPageSize : kFallbackPageSize;
+#else
+    long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? (size_t)size : kFallbackPageSize;
+#endif
+}
+
+// How many locked ranges cover each page, by page number. A page is
+// unlocked only when the last range on it goes, so a buffer sharing a page
+// with one that was freed stays locked. Never destroyed: engines may be
+// released from static destructors.
+std::mutex& LockedPagesMutex() {
+    static std::mutex* mutex = new std::mutex();
+    return *mutex;
+}
+
+std::unordered_map<uintptr_t, uint32_t>& LockedPages() {
+    static std::unordered_map<uintptr_t, uint32_t>* pages = new std::unordered_map<uintptr_t, uint32_t>();
+    return *pages;
+}
+
+void CountLockedPages(const void* data, size_t bytes) {
+    const uintptr_t page = PageSize();
+    const uintptr_t first = (uintptr_t)data / page;
+    const uintptr_t last = ((uintptr_t)data + bytes - 1) / page;
+    std::lock_guard<std::mutex> lock(LockedPagesMutex());
+    for (uintptr_t p = first; p <= last; ++p) ++LockedPages()[p];
+}
+
+void PrefaultStack() {
+    volatile unsigned char stack[kStackPrefaultBytes];
+    for (size_t i = 0; i < kStackPrefaultBytes; i += kFallbackPageSize) stack[i] = 0;
+    (void)stack[0];
+}
+
+} // namespace
+
+bool LockProcessMemory() {
+#ifdef _WIN32
+    // Room for the effect chains, FIFOs and scratch buffers being locked
+    const SIZE_T minimum = 64 * 1024 * 1024;
+    const SIZE_T maximum = 256 * 1024 * 1024;
+    return SetProcessWorkingSetSize(GetCurrentProcess(), minimum, maximum) != 0;
+#else
+    return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+#endif
+}
+
+void PrefaultAndLock(void* data, size_t bytes) {
+    if (!data || bytes == 0) return;
+    // Rewrite one byte per page with its own value: faults the page in
+    // without changing the contents
+    volatile unsigned char* bytesPtr = (volatile unsigned char*)data;
+    const size_t page = PageSize();
+    for (size_t offset = 0; offset < bytes; offset += page) bytesPtr[offset] = bytesPtr[offset];
+    bytesPtr[bytes - 1] = bytesPtr[bytes - 1];
+#ifdef _WIN32
+    VirtualLock(data, bytes);
+#else
+    mlock(data, bytes);
+#endif
+    CountLockedPages(data, bytes);
+}
+
+void MemoryLocks::Lock(void* data, size_t bytes) {
+    if (!data || bytes == 0) return;
+    PrefaultAndLock(data, bytes);
+    ranges.push_back({ data, bytes });
+}
+
+void MemoryLocks::Release() {
+    if (ranges.empty()) return;
+    const uintptr_t page = PageSize();
+    std::lock_guard<std::mutex> lock(LockedPagesMutex());
+    std::unordered_map<uintptr_t, uint32_t>& pages = LockedPages();
+    for (const Range& range : ranges) {
+        const uintptr_t first = (uintptr_t)range.data / page;
+        const uintptr_t last = ((uintptr_t)range.data + range.bytes - 1) / page;
+        for (uintptr_t p = first; p <= last; ++p) {
+            std::unordered_map<uintptr_t, uint32_t>::iterator count = pages.find(p);
+            if (count == pages.end() || --count->second > 0) continue;
+            pages.erase(count);
+#ifdef _WIN32
+            VirtualUnlock((void*)(p * page), page);
+#else
+            munlock((void*)(p * page), page);
+#endif
+        }
+    }
+    ranges.clear();
+}
+
+RealtimeThreadScope::RealtimeThreadScope(const RealtimeOptions& options) :
+mmcssTask(nullptr), elevated(false), pinned(false), timerRaised(false) {
+#ifdef _WIN32
+    timerRaised = timeBeginPeriod(1) == TIMERR_NOERROR;
+    if (options.raisePriority) {
+        DWORD taskIndex = 0;
+        HANDLE task = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex);
+        if (task) {
+            AvSetMmThreadPriority(task, AVRT_PRIORITY_HIGH);
+            mmcssTask = task;
+            elevated = true;
+        }
+        else {
+            // No MMCSS service: the highest normal priority is the next best thing
+            elevated = SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+        }
+    }
+    if (options.cpu >= 0 && options.cpu < 64) {
+        pinned = SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << options.cpu) != 0;
+    }
+#else
+    if (options.raisePriority) {
+        // Below the kernel's own RT threads; needs CAP_SYS_NICE or an rtprio limit
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = 70;
+        elevated = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+    }
+#ifdef __linux__
+    if (options.cpu >= 0 && options.cpu < CPU_SETSIZE) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(options.cpu, &set);
+        pinned = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+#endif
+#endif
+    PrefaultStack();
+}
+
+RealtimeThreadScope::~RealtimeThreadScope() {
+#ifdef _WIN32
+    if (mmcssTask) AvRevertMmThreadCharacteristics((HANDLE)mmcssTask);
+    else if (elevated) SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL);
+    if (timerRaised) timeEndPeriod(1);
+#else
+    if (elevated) {
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+    }
+#endif
+}
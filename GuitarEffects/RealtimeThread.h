@@ -0,0 +1,76 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// Real-time setup for the audio thread and the memory it works on.
+//
+// Memory: LockProcessMemory() once at startup, then lock each buffer the
+// audio thread will use, from the control thread while preparing. Every page
+// is then resident and stays so; the audio thread never takes a page fault
+// on first touch or after the working set was trimmed.
+
+// mlockall() on Linux. Windows has no equivalent; this raises the working
+// set limits instead, so that the per-buffer VirtualLock calls have room.
+bool LockProcessMemory();
+
+// Writes to every page of the range (faulting it in on this thread) and
+// locks it in RAM, for good: only for memory that lives until exit. Locking
+// failures are ignored: pre-faulting alone still helps, and memory locking
+// is a best-effort privilege on both systems.
+void PrefaultAndLock(void* data, size_t bytes);
+
+// The ranges one object pre-faulted and locked, unlocked again by Release()
+// (before the object reallocates them) and on destruction, so engines and
+// chains built over and over don't leave locked pages behind in the heap.
+// Declare it after the buffers it covers. Locks are counted per page, so a
+// page shared with a buffer that is still in use stays locked. Control
+// thread only: Release() takes a mutex.
+class MemoryLocks {
+public:
+    MemoryLocks() {}
+    // A copy owns different allocations, none of them locked yet
+    MemoryLocks(const MemoryLocks&) {}
+    MemoryLocks& operator=(const MemoryLocks&) { Release(); return *this; }
+    ~MemoryLocks() { Release(); }
+
+    void Lock(void* data, size_t bytes);
+    // The vector's elements; capacity past size() is left alone
+    template<typename T>
+    void Lock(std::vector<T>& buffer) {
+        Lock(buffer.data(), buffer.size() * sizeof(T));
+    }
+    void Release();
+
+private:
+    struct Range {
+        void* data;
+        size_t bytes;
+    };
+    std::vector<Range> ranges;
+};
+
+struct RealtimeOptions {
+    bool raisePriority = true;  // MMCSS "Pro Audio" on Windows, SCHED_FIFO on Linux
+    int cpu = -1;               // core to pin the thread to, -1 to leave it free
+};
+
+// Created at the top of the audio thread: raises its scheduling class,
+// optionally pins it, sets a 1 ms timer resolution (Windows) for the
+// polling loop's Sleep(1), and pre-faults its stack. Undone on destruction.
+class RealtimeThreadScope {
+public:
+    explicit RealtimeThreadScope(const RealtimeOptions& options);
+    ~RealtimeThreadScope();
+
+    RealtimeThreadScope(const RealtimeThreadScope&) = delete;
+    RealtimeThreadScope& operator=(const RealtimeThreadScope&) = delete;
+
+    bool Elevated() const { return elevated; }
+    bool Pinned() const { return pinned; }
+
+private:
+    void* mmcssTask;
+    bool elevated;
+    bool pinned;
+    bool timerRaised;
+};
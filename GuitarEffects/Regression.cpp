@@ -0,0 +1,461 @@
+#include "Regression.h"
+#include "EffectChain.h"
+#include "EffectEngine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+#include <string>
+
+namespace {
+
+const float kRate = 48000.0f;
+const int kChannels = 2;
+const uint32_t kFrames = 16384;      // ~0.34 s per signal
+const uint32_t kBlockFrames = 256;   // what the engine's FIFO feeds the chain
+const double kPi = 3.14159265358979323846;
+
+enum class Kernel { Tremolo, Chorus, BluesDriver, Overdrive, Compressor, Reverb, Warm, Wah, WahSplit };
+
+// How far a kernel's output may drift from its reference. Linear, stateless
+// kernels should match to float rounding; long feedback paths (reverb,
+// chorus) and resonant filters (wah, Q 10) amplify rounding changes, and the
+// clippers turn small input differences near the knee into larger ones. The
+// chorus also moves a fractional delay tap, so contracted multiply-adds
+// shift its interpolation: ~80 dB on the sparse impulse signal.
+struct Tolerance {
+    double minSnrDb;
+    double maxError;
+};
+
+Tolerance ToleranceFor(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::Tremolo: return { 100.0, 1e-5 };
+    case Kernel::Warm: return { 90.0, 1e-4 };
+    case Kernel::Compressor: return { 90.0, 1e-4 };
+    case Kernel::Overdrive: return { 80.0, 5e-4 };
+    case Kernel::BluesDriver: return { 80.0, 5e-4 };
+    case Kernel::Chorus: return { 70.0, 5e-4 };
+    case Kernel::Reverb: return { 80.0, 5e-4 };
+    default: return { 70.0, 1e-3 };  // wah
+    }
+}
+
+struct Setting {
+    const char* name;
+    Kernel kernel;
+    void (*apply)(EffectParams& params);
+};
+
+const Setting kSettings[] = {
+    { "tremolo_default", Kernel::Tremolo, [](EffectParams& p) { p.tremoloEnabled = true; } },
+    { "tremolo_deep", Kernel::Tremolo, [](EffectParams& p) {
+        p.tremoloEnabled = true; p.tremoloRate = 12.0f; p.tremoloDepth = 1.0f; } },
+    { "chorus_default", Kernel::Chorus, [](EffectParams& p) { p.chorusEnabled = true; } },
+    { "chorus_wide", Kernel::Chorus, [](EffectParams& p) {
+        p.chorusEnabled = true; p.chorusRate = 3.0f; p.chorusDepth = 0.03f;
+        p.chorusFeedback = 0.6f; p.chorusWidth = 1.0f; } },
+    { "chorus_half_rate", Kernel::Chorus, [](EffectParams& p) {
+        p.chorusEnabled = true; p.chorusRateDivider = 2; } },
+    { "blues_default", Kernel::BluesDriver, [](EffectParams& p) { p.bluesEnabled = true; } },
+    { "blues_hot", Kernel::BluesDriver, [](EffectParams& p) {
+        p.bluesEnabled = true; p.bluesGain = 4.0f; p.bluesTone = 0.2f; p.bluesLevel = 1.0f; } },
+    { "overdrive_default", Kernel::Overdrive, [](EffectParams& p) { p.overdriveEnabled = true; } },
+    { "overdrive_heavy", Kernel::Overdrive, [](EffectParams& p) {
+        p.overdriveEnabled = true; p.overdriveDrive = 8.0f; p.overdriveThreshold = 0.1f;
+        p.overdriveTone = 0.8f; p.overdriveMix = 1.0f; } },
+    { "compressor_default", Kernel::Compressor, [](EffectParams& p) { p.compEnabled = true; } },
+    { "compressor_fast", Kernel::Compressor, [](EffectParams& p) {
+        p.compEnabled = true; p.compAttackMs = 1.0f; p.compSustainMs = 50.0f;
+        p.compLevel = 1.5f; p.compTone = 0.8f; } },
+    { "reverb_default", Kernel::Reverb, [](EffectParams& p) { p.reverbEnabled = true; } },
+    { "reverb_large", Kernel::Reverb, [](EffectParams& p) {
+        p.reverbEnabled = true; p.reverbSize = 0.9f; p.reverbDamping = 0.2f; p.reverbMix = 0.6f; } },
+    { "reverb_half_rate", Kernel::Reverb, [](EffectParams& p) {
+        p.reverbEnabled = true; p.reverbRateDivider = 2; } },
+    { "reverb_quarter_rate", Kernel::Reverb, [](EffectParams& p) {
+        p.reverbEnabled = true; p.reverbRateDivider = 4; } },
+    { "reverb_full_room", Kernel::Reverb, [](EffectParams& p) {
+        p.reverbEnabled = true; p.reverbSize = 1.0f; p.reverbDamping = 0.0f; p.reverbRateDivider = 2; } },
+    { "warm_default", Kernel::Warm, [](EffectParams& p) { p.warmEnabled = true; } },
+    { "warm_saturated", Kernel::Warm, [](EffectParams& p) {
+        p.warmEnabled = true; p.warmAmount = 1.0f; p.warmTone = 0.2f; p.warmSaturation = 0.9f; } },
+    { "wah_fixed", Kernel::Wah, [](EffectParams& p) { p.wahEnabled = true; } },
+    { "wah_auto", Kernel::Wah, [](EffectParams& p) {
+        p.wahEnabled = true; p.wahLfoRate = 2.0f; p.wahLfoDepth = 0.8f; p.wahMix = 0.7f; } },
+    { "wah_split", Kernel::WahSplit, [](EffectParams& p) {
+        p.wahEnabled = true; p.wahFreq = 1200.0f; p.wahQ = 5.0f; } },
+};
+
+const char* const kSignalNames[] = { "sweep", "impulses", "pluck", "noise" };
+const int kSignalCount = 4;
+
+// Fixed seeds and formulas: the same signal on every run and platform (to
+// within libm rounding of the sweep, far below any tolerance)
+std::vector<float> MakeSignal(int signal) {
+    std::vector<float> out((size_t)kFrames * kChannels, 0.0f);
+    if (signal == 0) {
+        // Exponential sweep 20 Hz - 20 kHz at -6 dBFS, right channel inverted
+        const double k = log(20000.0 / 20.0);
+        for (uint32_t f = 0; f < kFrames; ++f) {
+            double t = (double)f / kFrames;
+            double phase = 2.0 * kPi * 20.0 * (kFrames / kRate) / k * (exp(t * k) - 1.0);
+            float s = 0.5f * (float)sin(phase);
+            out[f * 2] = s;
+            out[f * 2 + 1] = -s;
+        }
+    }
+    else if (signal == 1) {
+        // Full-scale impulse every 4096 frames, channels offset
+        for (uint32_t f = 0; f < kFrames; f += 4096) {
+            out[f * 2] = 1.0f;
+            if (f + 1000 < kFrames) out[(f + 1000) * 2 + 1] = -1.0f;
+        }
+    }
+    else if (signal == 2) {
+        // Karplus-Strong plucks: A2 then E3, on a fixed noise burst
+        uint32_t seed = 12345;
+        const int periods[] = { 436, 291 };
+        for (int note = 0; note < 2; ++note) {
+            std::vector<float> line(periods[note]);
+            for (float& v : line) {
+                seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+                v = (float)((int32_t)seed) / 2147483648.0f * 0.7f;
+            }
+            const uint32_t start = note * (kFrames / 2);
+            size_t pos = 0;
+            for (uint32_t f = start; f < kFrames; ++f) {
+                size_t next = (pos + 1) % line.size();
+                float s = line[pos];
+                line[pos] = 0.996f * 0.5f * (line[pos] + line[next]);
+                pos = next;
+                out[f * 2] += s;
+                out[f * 2 + 1] += s;
+            }
+        }
+    }
+    else {
+        // White noise at -12 dBFS, independent channels
+        uint32_t seed = 0x9E3779B9u;
+        for (float& v : out) {
+            seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+            v = (float)((int32_t)seed) / 2147483648.0f * 0.25f;
+        }
+    }
+    return out;
+}
+
+std::vector<float> Render(const Setting& setting, const std::vector<float>& input) {
+    EffectChain chain;
+    setting.apply(chain.params);
+    chain.Prepare(kRate, kBlockFrames, kChannels);
+    std::vector<float> out(input.size());
+    std::vector<float> left(kBlockFrames), right(kBlockFrames);
+    for (uint32_t offset = 0; offset < kFrames; offset += kBlockFrames) {
+        const float* in = &input[(size_t)offset * kChannels];
+        float* dst = &out[(size_t)offset * kChannels];
+        switch (setting.kernel) {
+        case Kernel::Tremolo: chain.ApplyTremolo(in, dst, kBlockFrames); break;
+        case Kernel::Chorus: chain.ApplyChorus(in, dst, kBlockFrames); break;
+        case Kernel::BluesDriver: chain.ApplyBluesDriver(in, dst, kBlockFrames); break;
+        case Kernel::Overdrive: chain.ApplyOverdrive(in, dst, kBlockFrames); break;
+        case Kernel::Compressor: chain.ApplyCompressor(in, dst, kBlockFrames); break;
+        case Kernel::Reverb: chain.ApplyReverb(in, dst, kBlockFrames); break;
+        case Kernel::Warm: chain.ApplyWarm(in, dst, kBlockFrames); break;
+        case Kernel::Wah: chain.ApplyWah(in, dst, kBlockFrames); break;
+        case Kernel::WahSplit:
+            for (uint32_t f = 0; f < kBlockFrames; ++f) {
+                left[f] = in[f * 2];
+                right[f] = in[f * 2 + 1];
+            }
+            chain.processWah(left.data(), right.data(), (int)kBlockFrames);
+            for (uint32_t f = 0; f < kBlockFrames; ++f) {
+                dst[f * 2] = left[f];
+                dst[f * 2 + 1] = right[f];
+            }
+            break;
+        }
+    }
+    return out;
+}
+
+// Chunking check: the engine must give the same output however the input
+// is split into packets. Differences are only allowed below the silence
+// threshold, where a skipped effect passes its input through.
+const uint32_t kPacketFrames = 480;     // a typical 10 ms WASAPI period
+const uint32_t kMaxChunkFrames = 1024;
+const double kChunkingMaxError = 1e-6;
+// The reverb at full room size, undamped, rings for about 30 s after a
+// second of full-scale noise before it drops below the silence threshold
+const double kChunkingGapSeconds = 32.0;
+
+// Pluck, a silent gap longer than any effect tail (so the silence skip
+// engages and releases, the reverb's included), then the impulses and the
+// sweep
+std::vector<float> MakeChunkingSignal() {
+    std::vector<float> out;
+    const int order[] = { 2, -1, 1, 0 };
+    for (int signal : order) {
+        if (signal < 0) {
+            out.resize(out.size() + (size_t)(kChunkingGapSeconds * kRate) * kChannels, 0.0f);
+            continue;
+        }
+        std::vector<float> part = MakeSignal(signal);
+        out.insert(out.end(), part.begin(), part.end());
+    }
+    return out;
+}
+
+// randomSeed 0: fixed kPacketFrames packets; otherwise 1..kMaxChunkFrames
+std::vector<float> RenderEngine(const Setting& setting, uint32_t blockSize, const std::vector<float>& input,
+    uint32_t randomSeed) {
+    EffectEngine engine;
+    engine.SetBlockSize(blockSize);
+    engine.Prepare(kRate, kMaxChunkFrames, kChannels);
+    EffectParams params = engine.Params();
+    setting.apply(params);
+    engine.SetParams(params);
+    const uint32_t frames = (uint32_t)(input.size() / kChannels);
+    std::vector<float> out(input.size());
+    uint32_t seed = randomSeed;
+    for (uint32_t offset = 0; offset < frames;) {
+        uint32_t chunk = kPacketFrames;
+        if (randomSeed) {
+            seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+            chunk = 1 + seed % kMaxChunkFrames;
+        }
+        if (chunk > frames - offset) chunk = frames - offset;
+        engine.Process(&input[(size_t)offset * kChannels], &out[(size_t)offset * kChannels], chunk);
+        offset += chunk;
+    }
+    return out;
+}
+
+// Compact references, committed with the source: per case a hash of the
+// exact output, its RMS and peak, and an RMS envelope over kEnvelopeWindows
+// equal windows. Every bound checked against them follows from the full
+// comparison's limits (|RMS(a) - RMS(b)| <= RMS(a - b), and the same for
+// peaks), so a result that would pass against the full reference passes
+// here too.
+const char* const kSummaryFile = "summary.txt";
+const int kEnvelopeWindows = 64;
+// Covers the printed precision of the summary values
+const double kSummarySlack = 1e-7;
+
+struct Summary {
+    uint64_t hash;
+    double rms;
+    double peak;
+    double envelope[kEnvelopeWindows];
+};
+
+// FNV-1a over the float bits
+uint64_t HashSamples(const std::vector<float>& data) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    const unsigned char* bytes = (const unsigned char*)data.data();
+    for (size_t i = 0; i < data.size() * sizeof(float); ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+Summary Summarize(const std::vector<float>& data) {
+    Summary summary;
+    summary.hash = HashSamples(data);
+    summary.peak = 0.0;
+    double total = 0.0;
+    const size_t window = data.size() / kEnvelopeWindows;
+    for (int w = 0; w < kEnvelopeWindows; ++w) {
+        double energy = 0.0;
+        for (size_t i = w * window; i < (w + 1) * window; ++i) {
+            energy += (double)data[i] * data[i];
+            if (fabs(data[i]) > summary.peak) summary.peak = fabs(data[i]);
+        }
+        summary.envelope[w] = sqrt(energy / window);
+        total += energy;
+    }
+    summary.rms = sqrt(total / data.size());
+    return summary;
+}
+
+// name hash rms peak envelope..., one case per line; '#' lines are comments
+std::map<std::string, Summary> ReadSummaries(const std::string& path) {
+    std::map<std::string, Summary> summaries;
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) return summaries;
+    char line[4096];
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#') continue;
+        char name[128];
+        unsigned long long hash;
+        Summary summary;
+        int used = 0;
+        if (sscanf(line, "%127s %llx %lf %lf%n", name, &hash, &summary.rms, &summary.peak, &used) != 4) continue;
+        summary.hash = hash;
+        const char* rest = line + used;
+        int w = 0;
+        for (; w < kEnvelopeWindows; ++w) {
+            if (sscanf(rest, "%lf%n", &summary.envelope[w], &used) != 1) break;
+            rest += used;
+        }
+        if (w == kEnvelopeWindows) summaries[name] = summary;
+    }
+    fclose(file);
+    return summaries;
+}
+
+bool ReadReference(const std::string& path, std::vector<float>& out) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    size_t read = fread(out.data(), sizeof(float), out.size(), file);
+    bool atEnd = fgetc(file) == EOF;
+    fclose(file);
+    return read == out.size() && atEnd;
+}
+
+bool WriteReference(const std::string& path, const std::vector<float>& data) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    size_t written = fwrite(data.data(), sizeof(float), data.size(), file);
+    return fclose(file) == 0 && written == data.size();
+}
+
+} // namespace
+
+int RunGoldenRegression(const char* directory, bool update) {
+    std::vector<float> signals[kSignalCount];
+    for (int s = 0; s < kSignalCount; ++s) signals[s] = MakeSignal(s);
+
+    const std::string summaryPath = std::string(directory) + "/" + kSummaryFile;
+    const std::map<std::string, Summary> summaries = ReadSummaries(summaryPath);
+    FILE* summaryFile = nullptr;
+    if (update) {
+        summaryFile = fopen(summaryPath.c_str(), "w");
+        if (!summaryFile) {
+            printf("Cannot write %s\n", summaryPath.c_str());
+            return 1;
+        }
+        fprintf(summaryFile, "# Golden-output summaries (see Regression.cpp): name, FNV-1a hash of the float32\n"
+            "# output, RMS, peak, then the RMS of each of %d equal windows\n", kEnvelopeWindows);
+    }
+
+    int failures = 0, cases = 0;
+    if (!update) printf("%-40s %10s %12s\n", "case", "SNR dB", "max error");
+    for (const Setting& setting : kSettings) {
+        const Tolerance tolerance = ToleranceFor(setting.kernel);
+        for (int s = 0; s < kSignalCount; ++s) {
+            const std::string name = std::string(setting.name) + "_" + kSignalNames[s];
+            const std::string path = std::string(directory) + "/" + name + ".f32";
+            std::vector<float> out = Render(setting, signals[s]);
+            ++cases;
+            if (update) {
+                const Summary summary = Summarize(out);
+                fprintf(summaryFile, "%s %016llx %.9g %.9g", name.c_str(), (unsigned long long)summary.hash,
+                    summary.rms, summary.peak);
+                for (double value : summary.envelope) fprintf(summaryFile, " %.9g", value);
+                fputc('\n', summaryFile);
+                if (!WriteReference(path, out)) {
+                    printf("%-40s could not write %s\n", name.c_str(), path.c_str());
+                    ++failures;
+                }
+                continue;
+            }
+            std::vector<float> reference(out.size());
+            if (!ReadReference(path, reference)) {
+                // No full reference: check against the committed summary
+                std::map<std::string, Summary>::const_iterator found = summaries.find(name);
+                if (found == summaries.end()) {
+                    printf("%-40s %23s FAIL (no reference)\n", name.c_str(), "");
+                    ++failures;
+                    continue;
+                }
+                const Summary& expected = found->second;
+                const Summary actual = Summarize(out);
+                bool finite = true;
+                for (float v : out) finite = finite && std::isfinite(v);
+                if (finite && actual.hash == expected.hash) {
+                    printf("%-40s %10s %12s ok (summary)\n", name.c_str(), "exact", "0");
+                    continue;
+                }
+                // Largest deviation seen: a lower bound on the actual max error
+                double deviation = fabs(actual.peak - expected.peak);
+                for (int w = 0; w < kEnvelopeWindows; ++w) {
+                    deviation = std::max(deviation, fabs(actual.envelope[w] - expected.envelope[w]));
+                }
+                const double rmsLimit = expected.rms * pow(10.0, -tolerance.minSnrDb / 20.0);
+                bool pass = finite && deviation <= tolerance.maxError + kSummarySlack &&
+                    fabs(actual.rms - expected.rms) <= rmsLimit + kSummarySlack;
+                if (!pass) ++failures;
+                printf("%-40s %10s %12.3g %s (summary)\n", name.c_str(), "-", deviation, pass ? "ok" : "FAIL");
+                continue;
+            }
+            double signal = 0.0, noise = 0.0, maxError = 0.0;
+            bool finite = true;
+            for (size_t i = 0; i < out.size(); ++i) {
+                if (!std::isfinite(out[i])) finite = false;
+                double error = fabs((double)out[i] - reference[i]);
+                signal += (double)reference[i] * reference[i];
+                noise += error * error;
+                if (error > maxError) maxError = error;
+            }
+            // Bit-exact (or silent both ways) counts as infinite SNR
+            double snr = (noise == 0.0) ? INFINITY : 10.0 * log10((signal > 0.0 ? signal : 1e-30) / noise);
+            bool pass = finite && snr >= tolerance.minSnrDb && maxError <= tolerance.maxError;
+            if (!pass) ++failures;
+            printf("%-40s %10.1f %12.3g %s\n", name.c_str(), snr, maxError, pass ? "ok" : "FAIL");
+        }
+    }
+    if (update) {
+        if (fclose(summaryFile) != 0) {
+            printf("Cannot write %s\n", summaryPath.c_str());
+            ++failures;
+        }
+        printf("Wrote %d references and %s to %s (%d failed)\n", cases - failures, kSummaryFile, directory,
+            failures);
+    }
+    else {
+        printf("%d of %d cases within tolerance\n", cases - failures, cases);
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+int RunChunkingCheck() {
+    const std::vector<float> input = MakeChunkingSignal();
+    const uint32_t blockSizes[] = { 0, 64 };
+    int failures = 0, cases = 0;
+    printf("%-40s %12s\n", "case", "max error");
+    for (const Setting& setting : kSettings) {
+        if (setting.kernel == Kernel::WahSplit) continue;  // same engine path as wah_fixed
+        for (uint32_t blockSize : blockSizes) {
+            const std::vector<float> reference = RenderEngine(setting, blockSize, input, 0);
+            const std::vector<float> chunked = RenderEngine(setting, blockSize, input, 0x2545F491u + cases);
+            double maxError = 0.0;
+            bool finite = true;
+            for (size_t i = 0; i < reference.size(); ++i) {
+                if (!std::isfinite(chunked[i])) finite = false;
+                double error = fabs((double)chunked[i] - reference[i]);
+                if (error > maxError) maxError = error;
+            }
+            bool pass = finite && maxError <= kChunkingMaxError;
+            if (!pass) ++failures;
+            ++cases;
+            char name[64];
+            snprintf(name, sizeof(name), "%s/block%u", setting.name, blockSize);
+            printf("%-40s %12.3g %s\n", name, maxError, pass ? "ok" : "FAIL");
+        }
+    }
+    printf("%d of %d cases independent of chunking\n", cases - failures, cases);
+    return failures == 0 ? 0 : 1;
+}
+
+#ifdef REGRESSION_STANDALONE
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--chunking") == 0) return RunChunkingCheck();
+    const char* directory = (argc > 1) ? argv[1] : "golden";
+    bool update = argc > 2 && strcmp(argv[2], "--update") == 0;
+    return RunGoldenRegression(directory, update);
+}
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+// Golden-output regression for the effect kernels: renders deterministic
+// test signals (log sweep, impulses, plucked strings, noise) through every
+// Apply* kernel and processWah at several settings and compares each result
+// with a stored reference, within per-effect SNR and max-error limits. Run
+// it before accepting any optimisation that could change the sound.
+//
+// directory (which must exist) holds the references. summary.txt is
+// committed (golden/ next to this file): per case a hash of the exact
+// output, its RMS, peak and a 64-window RMS envelope, checked against
+// bounds that follow from the same limits. A fresh checkout is checked
+// against those. update = true rewrites summary.txt from the accepted build
+// and also writes full references, raw little-endian float32, one per
+// case (not committed; about 9 MB). Where a case's full reference exists,
+// it is compared sample by sample instead.
+//
+// Portable: only the effect code is involved. Headless on Linux, e.g.
+//   g++ -O2 -std=c++14 -DREGRESSION_STANDALONE -o regression Regression.cpp
+//       EffectEngine.cpp SessionRecording.cpp EffectChain.cpp EffectGraph.cpp
+//       RealtimeThread.cpp Trace.cpp -lpthread
+//   ./regression golden [--update]
+// Returns non-zero if any case fails or has no reference of either kind.
+int RunGoldenRegression(const char* directory, bool update);
+
+// Block-size invariance: renders one long signal (with a silent gap, so the
+// silence skip engages) through EffectEngine at every setting, once in
+// 480-frame packets and once in random packets of 1-1024 frames, at the
+// per-packet and the default fixed block size. The outputs must agree to
+// within the -120 dBFS silence threshold. Standalone: ./regression --chunking
+int RunChunkingCheck();
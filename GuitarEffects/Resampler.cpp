@@ -0,0 +1,175 @@
+#include "Resampler.h"
+#include "RealtimeThread.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RESAMPLER_SSE2 1
+#endif
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+struct QualitySettings {
+    int taps;
+    int phases;
+    double beta;      // Kaiser window shape
+    double rolloff;   // passband edge as a fraction of the lower Nyquist
+};
+
+QualitySettings SettingsFor(Resampler::Quality quality) {
+    switch (quality) {
+    case Resampler::Quality::Low: return { 16, 64, 5.7, 0.85 };
+    case Resampler::Quality::High: return { 64, 512, 10.0, 0.95 };
+    default: return { 32, 256, 7.9, 0.91 };
+    }
+}
+
+// Zeroth-order modified Bessel function, by its power series
+double BesselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+} // namespace
+
+Resampler::Resampler() : inputRate(48000.0), outputRate(48000.0), channels(0), taps(0),
+phases(0), step(1.0), ratioAdjust(1.0), capacity(0), filled(0), time(0.0) {
+}
+
+void Resampler::Prepare(double inRate, double outRate, int numChannels, Quality quality,
+    uint32_t maxInputFrames) {
+    memoryLocks.Release();
+    const QualitySettings settings = SettingsFor(quality);
+    inputRate = inRate;
+    outputRate = outRate;
+    channels = numChannels;
+    taps = settings.taps;
+    phases = settings.phases;
+    step = inRate / outRate;
+    ratioAdjust = 1.0;
+
+    // Cutoff in cycles per input sample: below the lower of the two Nyquists
+    const double cutoff = 0.5 * fmin(1.0, outRate / inRate) * settings.rolloff;
+    const double half = taps / 2.0;
+    const double norm = BesselI0(settings.beta);
+    table.assign((size_t)(phases + 1) * taps, 0.0f);
+    for (int p = 0; p <= phases; ++p) {
+        // Row p is for an output frac = p / phases past tap (taps / 2 - 1)
+        float* row = &table[(size_t)p * taps];
+        double sum = 0.0;
+        for (int j = 0; j < taps; ++j) {
+            double d = j - (half - 1.0) - (double)p / phases;
+            double x = 2.0 * cutoff * d;
+            double sinc = (fabs(x) < 1e-9) ? 1.0 : sin(kPi * x) / (kPi * x);
+            double r = d / half;
+            double window = (fabs(r) >= 1.0) ? 0.0 : BesselI0(settings.beta * sqrt(1.0 - r * r)) / norm;
+            row[j] = (float)(2.0 * cutoff * sinc * window);
+            sum += row[j];
+        }
+        // Unity DC gain for every phase
+        for (int j = 0; j < taps; ++j) row[j] = (float)(row[j] / sum);
+    }
+
+    // Room for one call's input on top of a filter's worth of history, twice
+    // over so output limited by maxOutputFrames can't starve the next call
+    capacity = 2 * maxInputFrames + (uint32_t)taps;
+    history.assign((size_t)capacity * channels, 0.0f);
+    memoryLocks.Lock(table);
+    memoryLocks.Lock(history);
+    Reset();
+}
+
+// Half a filter of zeros up front puts output frame 0 at input time 0; the
+// look-ahead of taps / 2 input frames is what LatencyFrames() reports
+void Resampler::Reset() {
+    std::fill(history.begin(), history.end(), 0.0f);
+    filled = (uint32_t)(taps / 2 - 1);
+    time = 0.0;
+}
+
+void Resampler::SetRatioAdjust(double adjust) {
+    ratioAdjust = adjust;
+}
+
+uint32_t Resampler::MaxOutputFrames(uint32_t inputFrames) const {
+    // 1% headroom covers any drift adjustment
+    return (uint32_t)ceil(inputFrames / (step * 0.99)) + 2;
+}
+
+double Resampler::LatencyFrames() const {
+    return (taps / 2.0) * outputRate / inputRate;
+}
+
+double Resampler::LatencyMs() const {
+    return LatencyFrames() * 1000.0 / outputRate;
+}
+
+float Resampler::Dot(const float* coeffs, const float* samples) const {
+#ifdef RESAMPLER_SSE2
+    __m128 acc = _mm_setzero_ps();
+    for (int j = 0; j < taps; j += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(coeffs + j), _mm_loadu_ps(samples + j)));
+    }
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+#else
+    float sum = 0.0f;
+    for (int j = 0; j < taps; ++j) sum += coeffs[j] * samples[j];
+    return sum;
+#endif
+}
+
+uint32_t Resampler::Process(const float* in, uint32_t inputFrames, float* out, uint32_t maxOutputFrames) {
+    if (channels <= 0) return 0;
+
+    // Append, de-interleaved; anything beyond capacity is dropped
+    uint32_t frames = (inputFrames < capacity - filled) ? inputFrames : capacity - filled;
+    for (int c = 0; c < channels; ++c) {
+        float* dst = &history[(size_t)c * capacity + filled];
+        for (uint32_t f = 0; f < frames; ++f) dst[f] = in[(size_t)f * channels + c];
+    }
+    filled += frames;
+
+    const double advance = step * ratioAdjust;
+    uint32_t produced = 0;
+    while (produced < maxOutputFrames) {
+        uint32_t start = (uint32_t)time;
+        if (start + (uint32_t)taps > filled) break;
+        double position = (time - start) * phases;
+        int phase = (int)position;
+        float mix = (float)(position - phase);
+        const float* row0 = &table[(size_t)phase * taps];
+        const float* row1 = row0 + taps;
+        for (int c = 0; c < channels; ++c) {
+            const float* x = &history[(size_t)c * capacity + start];
+            float a = Dot(row0, x);
+            float b = Dot(row1, x);
+            out[(size_t)produced * channels + c] = a + (b - a) * mix;
+        }
+        ++produced;
+        time += advance;
+    }
+
+    // Drop input the read position has moved past
+    uint32_t consumed = (uint32_t)time;
+    if (consumed > filled) consumed = filled;
+    if (consumed > 0) {
+        for (int c = 0; c < channels; ++c) {
+            float* base = &history[(size_t)c * capacity];
+            memmove(base, base + consumed, (filled - consumed) * sizeof(float));
+        }
+        filled -= consumed;
+        time -= consumed;
+    }
+    return produced;
+}
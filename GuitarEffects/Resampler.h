@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "RealtimeThread.h"
+
+// Streaming sample-rate converter: a Kaiser-windowed sinc evaluated from a
+// polyphase table, with linear interpolation between neighbouring phases so
+// any ratio works (and can be nudged at run time for clock drift).
+//
+// Prepare() allocates; Process() doesn't, as long as each call passes no
+// more than maxInputFrames.
+class Resampler {
+public:
+    enum class Quality {
+        Low,     // 16 taps, ~60 dB stopband
+        Medium,  // 32 taps, ~80 dB
+        High     // 64 taps, ~100 dB
+    };
+
+    Resampler();
+
+    void Prepare(double inputRate, double outputRate, int channels, Quality quality,
+        uint32_t maxInputFrames);
+    void Reset();
+
+    // Scales the conversion step: > 1 consumes input faster (less output per
+    // input frame). Used to track a drifting clock; 1 is the nominal ratio.
+    void SetRatioAdjust(double adjust);
+    double GetRatioAdjust() const { return ratioAdjust; }
+
+    // Consumes all of in (interleaved) and writes the output frames that are
+    // complete, at most maxOutputFrames. Returns the number written.
+    uint32_t Process(const float* in, uint32_t inputFrames, float* out, uint32_t maxOutputFrames);
+
+    // Output frames a call with inputFrames can produce (with ratio headroom)
+    uint32_t MaxOutputFrames(uint32_t inputFrames) const;
+
+    // Group delay in output frames, and the same in milliseconds
+    double LatencyFrames() const;
+    double LatencyMs() const;
+
+    int Channels() const { return channels; }
+    int Taps() const { return taps; }
+
+private:
+    float Dot(const float* coeffs, const float* samples) const;
+
+    double inputRate;
+    double outputRate;
+    int channels;
+    int taps;                   // filter length in input samples, multiple of 4
+    int phases;                 // table rows per input sample
+    std::vector<float> table;   // (phases + 1) rows of taps coefficients
+    double step;                // input samples per output sample at nominal ratio
+    double ratioAdjust;
+
+    // Per-channel input history, planar; time is the fractional read position
+    std::vector<float> history;
+    uint32_t capacity;
+    uint32_t filled;
+    double time;
+    MemoryLocks memoryLocks;    // table and history
+};
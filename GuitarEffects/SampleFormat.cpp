@@ -0,0 +1,261 @@
+#include "SampleFormat.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SAMPLEFORMAT_SSE2 1
+#endif
+
+namespace {
+
+const float kScale16 = 32768.0f;
+const float kScale24 = 8388608.0f;
+const float kScale32 = 2147483648.0f;
+// Largest float below 2^31; 2^31 itself would overflow the conversion
+const float kMax32 = 2147483520.0f;
+
+// Dither is generated in chunks so the vector loops can add it directly.
+// Both paths draw it in sample order, so SIMD and scalar output match.
+const size_t kDitherChunk = 64;
+
+inline float Clamp(float value, float lo, float hi) {
+    return value < lo ? lo : (value > hi ? hi : value);
+}
+
+// Round to nearest, like _mm_cvtps_epi32 under the default rounding mode
+inline int32_t Quantize(float value, float lo, float hi) {
+    return (int32_t)lrintf(Clamp(value, lo, hi));
+}
+
+void FillDither(TpdfDither* dither, float* buffer, size_t count) {
+    if (dither) {
+        for (size_t i = 0; i < count; ++i) buffer[i] = dither->Next();
+    }
+    else {
+        memset(buffer, 0, count * sizeof(float));
+    }
+}
+
+void Int16ToFloat(const int16_t* in, float* out, size_t n) {
+    size_t i = 0;
+#ifdef SAMPLEFORMAT_SSE2
+    const __m128 scale = _mm_set1_ps(1.0f / kScale16);
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+        // Sign-extend by placing each sample in the high half, then shifting down
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#endif
+    for (; i < n; ++i) out[i] = in[i] * (1.0f / kScale16);
+}
+
+void Int32ToFloat(const int32_t* in, float* out, size_t n) {
+    size_t i = 0;
+#ifdef SAMPLEFORMAT_SSE2
+    const __m128 scale = _mm_set1_ps(1.0f / kScale32);
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+#endif
+    for (; i < n; ++i) out[i] = (float)in[i] * (1.0f / kScale32);
+}
+
+// Packed 24-bit has no cheap SSE2 shuffle. Instead each sample is one
+// unaligned 32-bit load that picks up the next sample's first byte, shifted
+// out again; the last sample is assembled byte by byte so nothing is read
+// past the end. Little-endian, like every target of this code.
+void Int24ToFloat(const uint8_t* in, float* out, size_t n) {
+    size_t i = 0;
+    for (; i + 1 < n; ++i, in += 3) {
+        uint32_t word;
+        memcpy(&word, in, sizeof(word));
+        out[i] = (float)(int32_t)(word << 8) * (1.0f / kScale32);
+    }
+    for (; i < n; ++i, in += 3) {
+        int32_t v = (int32_t)(((uint32_t)in[0] << 8) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 24));
+        out[i] = (float)v * (1.0f / kScale32);
+    }
+}
+
+void FloatToInt16(const float* in, int16_t* out, size_t n, TpdfDither* dither) {
+    float noise[kDitherChunk];
+    for (size_t base = 0; base < n; base += kDitherChunk) {
+        size_t count = (n - base < kDitherChunk) ? n - base : kDitherChunk;
+        FillDither(dither, noise, count);
+        const float* src = in + base;
+        int16_t* dst = out + base;
+        size_t i = 0;
+#ifdef SAMPLEFORMAT_SSE2
+        const __m128 scale = _mm_set1_ps(kScale16);
+        const __m128 lo = _mm_set1_ps(-kScale16);
+        const __m128 hi = _mm_set1_ps(kScale16 - 1.0f);
+        for (; i + 8 <= count; i += 8) {
+            __m128 a = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), _mm_loadu_ps(noise + i));
+            __m128 b = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), _mm_loadu_ps(noise + i + 4));
+            a = _mm_min_ps(_mm_max_ps(a, lo), hi);
+            b = _mm_min_ps(_mm_max_ps(b, lo), hi);
+            __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+            _mm_storeu_si128((__m128i*)(dst + i), packed);
+        }
+#endif
+        for (; i < count; ++i) {
+            dst[i] = (int16_t)Quantize(src[i] * kScale16 + noise[i], -kScale16, kScale16 - 1.0f);
+        }
+    }
+}
+
+// 24 valid bits; shift is 8 for the left-justified 32-bit container
+void FloatToInt24In32(const float* in, int32_t* out, size_t n, TpdfDither* dither) {
+    float noise[kDitherChunk];
+    for (size_t base = 0; base < n; base += kDitherChunk) {
+        size_t count = (n - base < kDitherChunk) ? n - base : kDitherChunk;
+        FillDither(dither, noise, count);
+        const float* src = in + base;
+        int32_t* dst = out + base;
+        size_t i = 0;
+#ifdef SAMPLEFORMAT_SSE2
+        const __m128 scale = _mm_set1_ps(kScale24);
+        const __m128 lo = _mm_set1_ps(-kScale24);
+        const __m128 hi = _mm_set1_ps(kScale24 - 1.0f);
+        for (; i + 4 <= count; i += 4) {
+            __m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), _mm_loadu_ps(noise + i));
+            v = _mm_min_ps(_mm_max_ps(v, lo), hi);
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_slli_epi32(_mm_cvtps_epi32(v), 8));
+        }
+#endif
+        for (; i < count; ++i) {
+            dst[i] = (int32_t)((uint32_t)Quantize(src[i] * kScale24 + noise[i], -kScale24, kScale24 - 1.0f) << 8);
+        }
+    }
+}
+
+void FloatToInt24(const float* in, uint8_t* out, size_t n, TpdfDither* dither) {
+    float noise[kDitherChunk];
+    for (size_t base = 0; base < n; base += kDitherChunk) {
+        size_t count = (n - base < kDitherChunk) ? n - base : kDitherChunk;
+        FillDither(dither, noise, count);
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t v = (uint32_t)Quantize(in[base + i] * kScale24 + noise[i], -kScale24, kScale24 - 1.0f);
+            uint8_t* dst = out + (base + i) * 3;
+            dst[0] = (uint8_t)v;
+            dst[1] = (uint8_t)(v >> 8);
+            dst[2] = (uint8_t)(v >> 16);
+        }
+    }
+}
+
+// Dither would sit below float resolution at 32 bits, so there is none
+void FloatToInt32(const float* in, int32_t* out, size_t n) {
+    size_t i = 0;
+#ifdef SAMPLEFORMAT_SSE2
+    const __m128 scale = _mm_set1_ps(kScale32);
+    const __m128 lo = _mm_set1_ps(-kScale32);
+    const __m128 hi = _mm_set1_ps(kMax32);
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(in + i), scale);
+        v = _mm_min_ps(_mm_max_ps(v, lo), hi);
+        _mm_storeu_si128((__m128i*)(out + i), _mm_cvtps_epi32(v));
+    }
+#endif
+    for (; i < n; ++i) out[i] = Quantize(in[i] * kScale32, -kScale32, kMax32);
+}
+
+} // namespace
+
+SampleFormat ResolveSampleFormat(bool isFloat, bool isPcm, int containerBits, int validBits) {
+    if (validBits <= 0 || validBits > containerBits) validBits = containerBits;
+    if (isFloat) {
+        return containerBits == 32 ? SampleFormat::Float32 : SampleFormat::Unknown;
+    }
+    if (!isPcm) return SampleFormat::Unknown;
+    switch (containerBits) {
+    case 16: return SampleFormat::Int16;
+    case 24: return SampleFormat::Int24;
+    // 20/24 valid bits in a 32-bit container are left-justified
+    case 32: return validBits <= 24 ? SampleFormat::Int24In32 : SampleFormat::Int32;
+    default: return SampleFormat::Unknown;
+    }
+}
+
+const char* SampleFormatName(SampleFormat format) {
+    switch (format) {
+    case SampleFormat::Float32: return "float32";
+    case SampleFormat::Int16: return "int16";
+    case SampleFormat::Int24: return "int24";
+    case SampleFormat::Int24In32: return "int24in32";
+    case SampleFormat::Int32: return "int32";
+    default: return "unknown";
+    }
+}
+
+int SampleFormatBytes(SampleFormat format) {
+    switch (format) {
+    case SampleFormat::Int16: return 2;
+    case SampleFormat::Int24: return 3;
+    case SampleFormat::Float32:
+    case SampleFormat::Int24In32:
+    case SampleFormat::Int32: return 4;
+    default: return 0;
+    }
+}
+
+void ConvertToFloat(SampleFormat format, const void* in, float* out, size_t numSamples) {
+    switch (format) {
+    case SampleFormat::Float32:
+        if (in != out) memcpy(out, in, numSamples * sizeof(float));
+        break;
+    case SampleFormat::Int16:
+        Int16ToFloat((const int16_t*)in, out, numSamples);
+        break;
+    case SampleFormat::Int24:
+        Int24ToFloat((const uint8_t*)in, out, numSamples);
+        break;
+    // The unused low byte of a left-justified container is zero
+    case SampleFormat::Int24In32:
+    case SampleFormat::Int32:
+        Int32ToFloat((const int32_t*)in, out, numSamples);
+        break;
+    default:
+        memset(out, 0, numSamples * sizeof(float));
+        break;
+    }
+}
+
+void ConvertFromFloat(SampleFormat format, const float* in, void* out, size_t numSamples,
+    TpdfDither* dither) {
+    switch (format) {
+    case SampleFormat::Float32:
+        if (in != out) memcpy(out, in, numSamples * sizeof(float));
+        break;
+    case SampleFormat::Int16:
+        FloatToInt16(in, (int16_t*)out, numSamples, dither);
+        break;
+    case SampleFormat::Int24:
+        FloatToInt24(in, (uint8_t*)out, numSamples, dither);
+        break;
+    case SampleFormat::Int24In32:
+        FloatToInt24In32(in, (int32_t*)out, numSamples, dither);
+        break;
+    case SampleFormat::Int32:
+        FloatToInt32(in, (int32_t*)out, numSamples);
+        break;
+    default:
+        break;
+    }
+}
+
+void RemapChannels(const float* in, int inChannels, float* out, int outChannels, size_t numFrames) {
+    if (inChannels <= 0 || outChannels <= 0) return;
+    for (size_t f = 0; f < numFrames; ++f) {
+        const float* src = in + f * inChannels;
+        float* dst = out + f * outChannels;
+        for (int c = 0; c < outChannels; ++c) {
+            dst[c] = src[c < inChannels ? c : inChannels - 1];
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Sample layouts a device buffer can use. The effects always run on 32-bit
+// float; everything else goes through ConvertToFloat / ConvertFromFloat.
+enum class SampleFormat {
+    Unknown,
+    Float32,
+    Int16,
+    Int24,      // packed, 3 bytes per sample
+    Int24In32,  // 24 valid bits, left-justified in a 32-bit container
+    Int32
+};
+
+// Resolves a wave format description (wFormatTag, or the SubFormat of a
+// WAVEFORMATEXTENSIBLE, plus container and valid bits) to a SampleFormat.
+// isFloat/isPcm come from the tag or subformat GUID.
+SampleFormat ResolveSampleFormat(bool isFloat, bool isPcm, int containerBits, int validBits);
+
+const char* SampleFormatName(SampleFormat format);
+int SampleFormatBytes(SampleFormat format);
+
+// Triangular (TPDF) dither: the difference of two uniform values, one LSB
+// peak each, added before quantizing to integer. Both come from the two
+// halves of one xorshift word. Keeps its own generator so each output
+// stream gets independent noise.
+class TpdfDither {
+public:
+    explicit TpdfDither(uint32_t seed = 0x9E3779B9u) : state(seed ? seed : 1) {}
+
+    // Next dither value in LSBs, in (-1, 1)
+    float Next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (float)((int32_t)(state & 0xFFFF) - (int32_t)(state >> 16)) * (1.0f / 65536.0f);
+    }
+
+private:
+    uint32_t state;
+};
+
+// Interleaved conversions over numSamples samples (frames * channels).
+// Float data is nominally in [-1, 1); conversion to integer clips, and adds
+// TPDF dither for 16- and 24-bit formats when dither is given.
+void ConvertToFloat(SampleFormat format, const void* in, float* out, size_t numSamples);
+void ConvertFromFloat(SampleFormat format, const float* in, void* out, size_t numSamples,
+    TpdfDither* dither = nullptr);
+
+// Channel count adaptation between capture and render: extra output
+// channels repeat the last input channel, surplus input channels are dropped.
+void RemapChannels(const float* in, int inChannels, float* out, int outChannels, size_t numFrames);
@@ -0,0 +1,449 @@
+#include "SessionRecording.h"
+#include "EffectEngine.h"
+#include "RealtimeThread.h"
+#include "Trace.h"
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+namespace {
+
+// Graph records: an EffectGraphDesc holds each effect at most once
+const uint32_t kMaxGraphWords = 4 + (int)EffectId::Count * 8;
+
+struct PacketPayload {
+    uint32_t frames;
+    float gain;
+};
+
+struct PresetPayload {
+    float crossfadeMs;
+    float sampleRate;
+    int32_t channels;
+    EffectParams params;
+};
+
+struct SettingsPayload {
+    uint32_t blockSize;
+    float tailThreshold;
+};
+
+bool ParseGraph(const uint32_t* words, size_t count, EffectGraphDesc& desc) {
+    size_t at = 0;
+    auto next = [&](uint32_t& value) {
+        if (at >= count) return false;
+        value = words[at++];
+        return true;
+    };
+    uint32_t steps = 0;
+    if (!next(steps)) return false;
+    desc.steps.clear();
+    for (uint32_t s = 0; s < steps; ++s) {
+        EffectGraphDesc::Step step;
+        uint32_t parallel = 0, effect = 0, branches = 0;
+        if (!next(parallel) || !next(effect) || !next(branches)) return false;
+        step.parallel = parallel != 0;
+        step.effect = (EffectId)effect;
+        for (uint32_t b = 0; b < branches; ++b) {
+            EffectGraphDesc::Branch branch;
+            uint32_t gain = 0, effects = 0;
+            if (!next(gain) || !next(effects)) return false;
+            memcpy(&branch.gain, &gain, sizeof(float));
+            for (uint32_t e = 0; e < effects; ++e) {
+                if (!next(effect)) return false;
+                branch.effects.push_back((EffectId)effect);
+            }
+            step.branches.push_back(branch);
+        }
+        desc.steps.push_back(step);
+    }
+    return desc.IsValid();
+}
+
+// Largest payload a sound record can have: a full packet at the recording's
+// block size, or the biggest control record (a graph of every effect, each in
+// its own branch, needs well under this)
+uint64_t MaxRecordBytes(uint32_t maxBlockFrames, int channels) {
+    const uint64_t packet = sizeof(PacketPayload) + (uint64_t)maxBlockFrames * channels * sizeof(float);
+    const uint64_t graph = (1 + 6 * (uint64_t)EffectId::Count) * sizeof(uint32_t);
+    return std::max(packet, std::max<uint64_t>(sizeof(PresetPayload), graph));
+}
+
+double ElapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+// FNV-1a over the sample bit patterns
+uint64_t HashSamples(const float* samples, size_t count) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t bits;
+        memcpy(&bits, &samples[i], sizeof(bits));
+        hash ^= bits;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+SessionRecorder::SessionRecorder() : head(0), tail(0), overflowed(false), file(nullptr), stopping(false) {
+}
+
+SessionRecorder::~SessionRecorder() {
+    Stop();
+}
+
+bool SessionRecorder::Start(const char* path, float sampleRate, int channels, uint32_t maxBlockFrames) {
+    Stop();
+    file = fopen(path, "wb");
+    if (!file) return false;
+    setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    SessionFileHeader header;
+    header.magic = kSessionMagic;
+    header.version = kSessionVersion;
+    header.paramsSize = sizeof(EffectParams);
+    header.channels = channels;
+    header.sampleRate = sampleRate;
+    header.maxBlockFrames = maxBlockFrames;
+    fwrite(&header, sizeof(header), 1, file);
+
+    if (ring.empty()) {
+        ring.assign(kRingBytes, 0);
+        memoryLocks.Lock(ring);
+    }
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+    overflowed.store(false, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = false;
+    }
+    worker = std::thread(&SessionRecorder::Run, this);
+    return true;
+}
+
+// Call once the audio thread is no longer recording
+void SessionRecorder::Stop() {
+    if (!file) return;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+
+    SessionRecordHeader end;
+    end.type = SessionRecordType::End;
+    end.bytes = sizeof(uint32_t);
+    end.frame = 0;
+    end.timeNs = TraceNowNs();
+    const uint32_t complete = Overflowed() ? 0 : 1;
+    fwrite(&end, sizeof(end), 1, file);
+    fwrite(&complete, sizeof(complete), 1, file);
+    fclose(file);
+    file = nullptr;
+}
+
+void SessionRecorder::CopyIn(uint64_t position, const void* data, size_t bytes) {
+    const size_t offset = (size_t)(position & (kRingBytes - 1));
+    const size_t first = (bytes < kRingBytes - offset) ? bytes : kRingBytes - offset;
+    memcpy(&ring[offset], data, first);
+    if (bytes > first) memcpy(&ring[0], (const uint8_t*)data + first, bytes - first);
+}
+
+bool SessionRecorder::Append(SessionRecordType type, uint64_t frame,
+    const void* a, uint32_t aBytes, const void* b, uint32_t bBytes) {
+    if (overflowed.load(std::memory_order_relaxed)) return false;
+    SessionRecordHeader header;
+    header.type = type;
+    header.bytes = aBytes + bBytes;
+    header.frame = frame;
+    header.timeNs = TraceNowNs();
+    const uint64_t position = head.load(std::memory_order_relaxed);
+    const size_t total = sizeof(header) + header.bytes;
+    if (position + total - tail.load(std::memory_order_acquire) > kRingBytes) {
+        overflowed.store(true, std::memory_order_relaxed);
+        return false;
+    }
+    CopyIn(position, &header, sizeof(header));
+    CopyIn(position + sizeof(header), a, aBytes);
+    if (bBytes) CopyIn(position + sizeof(header) + aBytes, b, bBytes);
+    head.store(position + total, std::memory_order_release);
+    return true;
+}
+
+void SessionRecorder::RecordPacket(uint64_t frame, const float* in, uint32_t frames, int channels, float gain) {
+    PacketPayload packet = { frames, gain };
+    Append(SessionRecordType::Packet, frame, &packet, sizeof(packet),
+        in, (uint32_t)((size_t)frames * channels * sizeof(float)));
+}
+
+void SessionRecorder::RecordOutput(uint64_t frame, uint64_t hash) {
+    Append(SessionRecordType::Output, frame, &hash, sizeof(hash));
+}
+
+void SessionRecorder::RecordParams(uint64_t frame, const EffectParams& params) {
+    Append(SessionRecordType::Params, frame, &params, sizeof(params));
+}
+
+void SessionRecorder::RecordPreset(uint64_t frame, const EffectParams& params, float crossfadeMs,
+    float sampleRate, int channels) {
+    PresetPayload preset;
+    preset.crossfadeMs = crossfadeMs;
+    preset.sampleRate = sampleRate;
+    preset.channels = channels;
+    preset.params = params;
+    Append(SessionRecordType::Preset, frame, &preset, sizeof(preset));
+}
+
+// Flattened into a fixed array: the audio thread can't allocate
+void SessionRecorder::RecordGraph(uint64_t frame, const EffectGraphDesc& desc) {
+    uint32_t words[kMaxGraphWords];
+    uint32_t count = 0;
+    auto put = [&](uint32_t value) {
+        if (count < kMaxGraphWords) words[count] = value;
+        ++count;
+    };
+    put((uint32_t)desc.steps.size());
+    for (const EffectGraphDesc::Step& step : desc.steps) {
+        put(step.parallel ? 1 : 0);
+        put((uint32_t)step.effect);
+        put((uint32_t)step.branches.size());
+        for (const EffectGraphDesc::Branch& branch : step.branches) {
+            uint32_t gain;
+            memcpy(&gain, &branch.gain, sizeof(gain));
+            put(gain);
+            put((uint32_t)branch.effects.size());
+            for (EffectId effect : branch.effects) put((uint32_t)effect);
+        }
+    }
+    if (count > kMaxGraphWords) {
+        // Not a valid graph (IsValid() allows each effect once); stop rather
+        // than record something that won't replay
+        overflowed.store(true, std::memory_order_relaxed);
+        return;
+    }
+    Append(SessionRecordType::Graph, frame, words, count * sizeof(uint32_t));
+}
+
+void SessionRecorder::RecordSettings(uint64_t frame, uint32_t blockSize, float tailThreshold) {
+    SettingsPayload settings = { blockSize, tailThreshold };
+    Append(SessionRecordType::Settings, frame, &settings, sizeof(settings));
+}
+
+void SessionRecorder::Drain() {
+    const uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t position = tail.load(std::memory_order_relaxed);
+    while (position < end) {
+        const size_t offset = (size_t)(position & (kRingBytes - 1));
+        size_t bytes = (size_t)(end - position);
+        if (bytes > kRingBytes - offset) bytes = kRingBytes - offset;
+        fwrite(&ring[offset], 1, bytes, file);
+        position += bytes;
+        tail.store(position, std::memory_order_release);
+    }
+}
+
+void SessionRecorder::Run() {
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    while (!stopping) {
+        // The audio thread never signals (that could block it); poll instead
+        wake.wait_for(lock, std::chrono::milliseconds(kDrainIntervalMs));
+        lock.unlock();
+        Drain();
+        lock.lock();
+    }
+    lock.unlock();
+    Drain();
+}
+
+int RunSessionReplay(const char* path, unsigned repeat, const char* outPath) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return 2;
+    }
+    SessionFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != kSessionMagic ||
+        header.version != kSessionVersion || header.paramsSize != sizeof(EffectParams) ||
+        header.channels <= 0 || header.maxBlockFrames == 0) {
+        fprintf(stderr, "%s is not a session recording from this build\n", path);
+        fclose(file);
+        return 2;
+    }
+    FILE* out = nullptr;
+    if (outPath && !(out = fopen(outPath, "wb"))) {
+        fprintf(stderr, "Cannot write %s\n", outPath);
+        fclose(file);
+        return 2;
+    }
+    if (repeat == 0) repeat = 1;
+
+    std::vector<uint8_t> payload;
+    std::vector<float> output;
+    int result = 0;
+    for (unsigned pass = 0; pass < repeat; ++pass) {
+        fseek(file, sizeof(header), SEEK_SET);
+        EffectEngine engine;
+        engine.Prepare(header.sampleRate, header.maxBlockFrames, header.channels);
+        float rate = header.sampleRate;
+        int channels = header.channels;
+
+        uint64_t packets = 0, frames = 0, events = 0, mismatches = 0, firstMismatch = 0;
+        uint64_t lastHash = 0, worstPacket = 0, worstFrame = 0;
+        double totalUs = 0.0, worstUs = 0.0, worstBudgetUs = 0.0;
+        bool ended = false, complete = false, truncated = false;
+        SessionRecordHeader record;
+        while (fread(&record, sizeof(record), 1, file) == 1) {
+            // Sizes are checked before anything is copied out of the payload
+            if (record.bytes > MaxRecordBytes(header.maxBlockFrames, channels)) {
+                truncated = true;
+                break;
+            }
+            payload.resize(record.bytes);
+            if (record.bytes && fread(payload.data(), 1, record.bytes, file) != record.bytes) {
+                truncated = true;
+                break;
+            }
+            switch (record.type) {
+            case SessionRecordType::Packet: {
+                PacketPayload packet;
+                if (record.bytes < sizeof(packet)) {
+                    truncated = true;
+                    break;
+                }
+                memcpy(&packet, payload.data(), sizeof(packet));
+                const size_t samples = (size_t)packet.frames * channels;
+                if (record.bytes != sizeof(packet) + samples * sizeof(float)) {
+                    truncated = true;
+                    break;
+                }
+                output.resize(samples);
+                const float* in = (const float*)(payload.data() + sizeof(packet));
+                const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                engine.Process(in, output.data(), packet.frames, packet.gain);
+                const double us = ElapsedUs(start);
+                totalUs += us;
+                if (us > worstUs) {
+                    worstUs = us;
+                    worstPacket = packets;
+                    worstFrame = record.frame;
+                    worstBudgetUs = packet.frames * 1e6 / rate;
+                }
+                lastHash = HashSamples(output.data(), samples);
+                if (out && pass == 0) fwrite(output.data(), sizeof(float), samples, out);
+                ++packets;
+                frames += packet.frames;
+                break;
+            }
+            case SessionRecordType::Output: {
+                uint64_t hash;
+                if (record.bytes != sizeof(hash)) {
+                    truncated = true;
+                    break;
+                }
+                memcpy(&hash, payload.data(), sizeof(hash));
+                if (hash != lastHash && mismatches++ == 0) firstMismatch = packets - 1;
+                break;
+            }
+            case SessionRecordType::Params: {
+                EffectParams params;
+                if (record.bytes != sizeof(params)) {
+                    truncated = true;
+                    break;
+                }
+                memcpy(&params, payload.data(), sizeof(params));
+                engine.SetParams(params);
+                ++events;
+                break;
+            }
+            case SessionRecordType::Preset: {
+                PresetPayload preset;
+                if (record.bytes != sizeof(preset)) {
+                    truncated = true;
+                    break;
+                }
+                memcpy(&preset, payload.data(), sizeof(preset));
+                if (preset.channels <= 0) {
+                    truncated = true;
+                    break;
+                }
+                engine.SetCrossfadeMs(preset.crossfadeMs);
+                if (preset.sampleRate != rate || preset.channels != channels) {
+                    // Format change: Prepare() switches to a chain built from Params()
+                    engine.SetParams(preset.params);
+                    engine.Prepare(preset.sampleRate, header.maxBlockFrames, preset.channels);
+                    rate = preset.sampleRate;
+                    channels = preset.channels;
+                }
+                else {
+                    engine.SwitchPreset(preset.params);
+                }
+                ++events;
+                break;
+            }
+            case SessionRecordType::Graph: {
+                EffectGraphDesc desc;
+                if (!ParseGraph((const uint32_t*)payload.data(), record.bytes / sizeof(uint32_t), desc)) {
+                    truncated = true;
+                    break;
+                }
+                engine.SetGraph(desc);
+                ++events;
+                break;
+            }
+            case SessionRecordType::Settings: {
+                SettingsPayload settings;
+                if (record.bytes != sizeof(settings)) {
+                    truncated = true;
+                    break;
+                }
+                memcpy(&settings, payload.data(), sizeof(settings));
+                engine.SetBlockSize(settings.blockSize);
+                engine.SetTailThreshold(settings.tailThreshold);
+                ++events;
+                break;
+            }
+            case SessionRecordType::End: {
+                uint32_t flag = 0;
+                if (record.bytes >= sizeof(flag)) memcpy(&flag, payload.data(), sizeof(flag));
+                complete = flag != 0;
+                ended = true;
+                break;
+            }
+            default:
+                truncated = true;
+                break;
+            }
+            if (ended || truncated) break;
+        }
+
+        const double seconds = frames / (double)rate;
+        printf("pass %u: %llu packets, %.1f s of audio, %llu control events, %.1f ms processing (%.0fx realtime)\n",
+            pass + 1, (unsigned long long)packets, seconds, (unsigned long long)events, totalUs / 1000.0,
+            totalUs > 0.0 ? seconds * 1e6 / totalUs : 0.0);
+        if (packets > 0) {
+            printf("  packet time: mean %.1f us, worst %.1f us at packet %llu (frame %llu), budget %.1f us\n",
+                totalUs / packets, worstUs, (unsigned long long)worstPacket,
+                (unsigned long long)worstFrame, worstBudgetUs);
+        }
+        if (mismatches > 0) {
+            printf("  NOT bit-exact: %llu packets differ, first at packet %llu\n",
+                (unsigned long long)mismatches, (unsigned long long)firstMismatch);
+            result = 1;
+        }
+        else {
+            printf("  bit-exact: every packet matches the recorded output\n");
+        }
+        if (truncated || !ended) {
+            printf("  recording ends early (file truncated or damaged)\n");
+        }
+        else if (!complete) {
+            printf("  recording stopped early: the disk fell behind the audio thread\n");
+        }
+    }
+    fclose(file);
+    if (out) fclose(out);
+    return result;
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include "EffectChain.h"
+#include "EffectGraph.h"
+
+// Capture and replay of live sessions, so a glitch or CPU spike seen on
+// stage can be reproduced offline under a profiler.
+//
+// EffectEngine records what its audio thread actually consumed, packet by
+// packet: the input samples and gain, every preset swap and graph it picked
+// up, parameter writes (from the GUI, controller actions or the console, as
+// seen at the start of each packet), and block size changes. Each packet is
+// followed by a hash of its output. A recording starts on a freshly reset
+// engine (see EffectEngine::Reset), so replaying the records into a new
+// engine reproduces the session bit for bit, and the hashes prove it.
+//
+// The file is this build's native structs, little-endian: replay it with the
+// same build. Records are a SessionRecordHeader followed by its payload.
+
+const uint32_t kSessionMagic = 0x52584647;  // "GFXR"
+const uint32_t kSessionVersion = 1;
+
+struct SessionFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t paramsSize;        // sizeof(EffectParams) of the recording build
+    int32_t channels;
+    float sampleRate;
+    uint32_t maxBlockFrames;
+};
+
+enum class SessionRecordType : uint32_t {
+    Packet = 1,     // uint32 frames, float gain, frames * channels float input
+    Output,         // uint64 FNV-1a hash of the packet's output samples
+    Params,         // EffectParams written into the running chain
+    Preset,         // float crossfadeMs, float sampleRate, int32 channels, EffectParams
+    Graph,          // uint32 steps, then per step: uint32 parallel, effect, branch count,
+                    // and per branch: float gain, uint32 count, count uint32 effects
+    Settings,       // uint32 block size, float linear tail threshold
+    End             // uint32 complete (0: the ring overflowed and recording stopped)
+};
+
+struct SessionRecordHeader {
+    SessionRecordType type;
+    uint32_t bytes;             // payload size
+    uint64_t frame;             // engine frames processed before this record
+    uint64_t timeNs;            // TraceNowNs() when it was recorded
+};
+
+uint64_t HashSamples(const float* samples, size_t count);
+
+// Writes a session file. The audio thread appends records to a byte ring
+// without locks, allocation or waiting; a background thread drains it to
+// disk. If the disk falls behind far enough to fill the ring, recording
+// stops at that record, so everything in the file still replays exactly.
+class SessionRecorder {
+public:
+    SessionRecorder();
+    ~SessionRecorder();
+
+    // Control thread
+    bool Start(const char* path, float sampleRate, int channels, uint32_t maxBlockFrames);
+    void Stop();
+    bool IsRecording() const { return file != nullptr; }
+    bool Overflowed() const { return overflowed.load(std::memory_order_relaxed); }
+
+    // Audio thread
+    void RecordPacket(uint64_t frame, const float* in, uint32_t frames, int channels, float gain);
+    void RecordOutput(uint64_t frame, uint64_t hash);
+    void RecordParams(uint64_t frame, const EffectParams& params);
+    void RecordPreset(uint64_t frame, const EffectParams& params, float crossfadeMs, float sampleRate, int channels);
+    void RecordGraph(uint64_t frame, const EffectGraphDesc& desc);
+    void RecordSettings(uint64_t frame, uint32_t blockSize, float tailThreshold);
+
+private:
+    SessionRecorder(const SessionRecorder&) = delete;
+    SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+    // ~20 s of stereo float at 48 kHz
+    static const size_t kRingBytes = 8 << 20;  // power of two
+    static const int kDrainIntervalMs = 20;
+
+    // All parts or nothing
+    bool Append(SessionRecordType type, uint64_t frame,
+        const void* a, uint32_t aBytes, const void* b = nullptr, uint32_t bBytes = 0);
+    void CopyIn(uint64_t position, const void* data, size_t bytes);
+    void Drain();
+    void Run();
+
+    std::vector<uint8_t> ring;
+    std::atomic<uint64_t> head;     // bytes ever written (audio thread)
+    std::atomic<uint64_t> tail;     // bytes ever drained (writer thread)
+    std::atomic<bool> overflowed;
+
+    FILE* file;
+    std::thread worker;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool stopping;
+    MemoryLocks memoryLocks;    // ring
+};
+
+// Replays a session file into a fresh engine as fast as possible, repeat
+// times, checking every packet's output hash and timing every packet.
+// Writes the output of the first pass as raw float32 to outPath if given.
+// Returns 0 if the replay was bit-exact.
+int RunSessionReplay(const char* path, unsigned repeat, const char* outPath);
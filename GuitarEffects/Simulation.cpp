@@ -0,0 +1,138 @@
+#include "Simulation.h"
+#include "DriftCompensator.h"
+#include "EffectEngine.h"
+#include "LatencyProbe.h"
+#include <cstdlib>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const double kRate = 48000.0;
+const int kChannels = 2;
+const unsigned kPacketFrames = 480;       // 10 ms capture packets
+const unsigned kRenderBufferFrames = 4800;
+const unsigned kTargetFrames = 960;       // 20 ms
+// Fine enough that the measured depth isn't quantized to a step's worth of
+// frames, which a fast loop would chase; devices report padding from their
+// play position, not in such coarse steps
+const double kStepSeconds = 0.0001;
+// Locked: depth within 0.5 ms of the target, and staying there
+const double kLockFrames = 24.0;
+const double kMaxLockSeconds = 10.0;
+
+} // namespace
+
+int RunDriftSimulation(double skewPpm, double seconds) {
+    DriftCompensator bridge;
+    bridge.Prepare(kRate, kRate, kChannels, Resampler::Quality::Medium, kPacketFrames, kTargetFrames);
+    std::vector<float> packet(kPacketFrames * kChannels);
+    std::vector<float> render(kRenderBufferFrames * kChannels);
+
+    printf("Simulating %.0f ppm capture clock skew for %.0f s\n", skewPpm, seconds);
+    printf("  time   buffered  target   ratio ppm  underruns  device dry\n");
+    const double captureRate = kRate * (1.0 + skewPpm * 1e-6);
+    double captureDue = 0.0, renderDue = 0.0;
+    unsigned padding = 0;       // frames queued in the simulated render device
+    unsigned dryFrames = 0;     // frames the render device had to make up
+    double phase = 0.0;
+    const int steps = (int)(seconds / kStepSeconds);
+    double lockedAt = 0.0;      // last time the depth was off target
+    double ratioSum = 0.0;      // averaged from then on
+    int ratioCount = 0;
+    for (int step = 1; step <= steps; ++step) {
+        // Capture delivers whole packets on its own clock
+        captureDue += captureRate * kStepSeconds;
+        while (captureDue >= kPacketFrames) {
+            captureDue -= kPacketFrames;
+            for (unsigned f = 0; f < kPacketFrames; ++f) {
+                float sample = 0.5f * (float)sin(phase);
+                phase += 2.0 * 3.14159265358979323846 * 440.0 / kRate;
+                packet[f * kChannels] = packet[f * kChannels + 1] = sample;
+            }
+            bridge.Write(packet.data(), kPacketFrames, padding);
+        }
+
+        // Render gets topped up like AudioLoop does, then plays at the nominal rate
+        unsigned space = kRenderBufferFrames - padding;
+        unsigned frames = bridge.Available() < space ? bridge.Available() : space;
+        bridge.Read(render.data(), frames);
+        padding += frames;
+        renderDue += kRate * kStepSeconds;
+        unsigned played = (unsigned)renderDue;
+        renderDue -= played;
+        if (played > padding) {
+            dryFrames += played - padding;
+            played = padding;
+        }
+        padding -= played;
+
+        const DriftStats now = bridge.GetStats();
+        if (fabs(now.bufferedFrames - now.targetFrames) >= kLockFrames) {
+            lockedAt = step * kStepSeconds;
+            ratioSum = 0.0;
+            ratioCount = 0;
+        }
+        else {
+            ratioSum += now.ratioPpm;
+            ++ratioCount;
+        }
+        if (step % (int)(5.0 / kStepSeconds) == 0) {
+            DriftStats stats = bridge.GetStats();
+            printf("  %4.0fs  %8.1f  %6.0f  %10.1f  %9llu  %10u\n", step * kStepSeconds,
+                stats.bufferedFrames, stats.targetFrames, stats.ratioPpm,
+                (unsigned long long)stats.underruns, dryFrames);
+        }
+    }
+
+    // The ratio is averaged over the whole locked stretch: the measured depth
+    // beats slowly between packet and render timing, and a short window
+    // would catch part of that cycle
+    double ratio = ratioCount ? ratioSum / ratioCount : 0.0;
+    bool locked = ratioCount > 0 && lockedAt <= kMaxLockSeconds;
+    bool settled = locked && fabs(ratio - skewPpm) < 0.1 * fabs(skewPpm) + 20.0;
+    printf("%s: locked after %.1f s (limit %.0f s), average correction %.1f ppm for %.0f ppm skew, "
+        "%u dry frames\n", (settled && dryFrames == 0) ? "PASS" : "FAIL", lockedAt, kMaxLockSeconds,
+        ratio, skewPpm, dryFrames);
+    return (settled && dryFrames == 0) ? 0 : 1;
+}
+
+int RunLatencySimulation(unsigned deviceDelayFrames, unsigned blockSize) {
+    EffectEngine engine;
+    engine.Prepare((float)kRate, kPacketFrames, kChannels);
+    engine.SetBlockSize(blockSize);
+    const unsigned expected = deviceDelayFrames + engine.LatencyFrames();
+    printf("Simulating a loopback cable: %u frames of device delay, block size %u\n",
+        deviceDelayFrames, engine.GetBlockSize());
+    printf("  reported: %u frames (%u device + %u engine)\n", expected, deviceDelayFrames,
+        engine.LatencyFrames());
+
+    LatencyProbe probe(14, (unsigned)kRate);
+    probe.Arm();
+    std::vector<float> played;      // mono, everything sent to the output
+    std::vector<float> packet(kPacketFrames * kChannels);
+    srand(7);
+    for (size_t start = 0; !probe.Done(); start += kPacketFrames) {
+        // Input hears the output deviceDelayFrames later, at half level, over -60 dB noise
+        for (unsigned f = 0; f < kPacketFrames; ++f) {
+            size_t n = start + f;
+            float loop = (n >= deviceDelayFrames && n - deviceDelayFrames < played.size())
+                ? 0.5f * played[n - deviceDelayFrames] : 0.0f;
+            float noise = 0.001f * ((float)rand() / RAND_MAX * 2.0f - 1.0f);
+            packet[f * kChannels] = packet[f * kChannels + 1] = loop + noise;
+        }
+        // Same order as AudioLoop: effects, then the probe records their output
+        engine.Process(packet.data(), packet.data(), kPacketFrames);
+        probe.Process(packet.data(), packet.data(), kPacketFrames, kChannels);
+        for (unsigned f = 0; f < kPacketFrames; ++f) played.push_back(packet[f * kChannels]);
+        if (start > 10 * (size_t)kRate) break;
+    }
+
+    LatencyMeasurement measured = probe.Analyze(kRate);
+    printf("  measured: %u frames (%.2f ms), confidence %.1f\n",
+        measured.frames, measured.ms, measured.confidence);
+    bool pass = measured.valid && measured.frames == expected;
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// Headless stand-ins for the audio devices, for exercising the realtime
+// plumbing without hardware. Run from the console (see main.cpp).
+
+// Capture and render devices on clocks skewPpm apart, bridged by a
+// DriftCompensator. Prints fill/ratio telemetry and returns non-zero if the
+// render side ever ran dry, or the buffer didn't lock onto its target within
+// 10 s and stay there with the ratio matching the skew.
+int RunDriftSimulation(double skewPpm, double seconds);
+
+// Loopback stand-in for a cable from output to input: a fixed device delay
+// with noise, around an EffectEngine. Measures the round trip with a
+// LatencyProbe and checks it against what the latency API reports.
+int RunLatencySimulation(unsigned deviceDelayFrames, unsigned blockSize);
@@ -0,0 +1,208 @@
+#include "StatsSegment.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Attempts before a reader gives up on a writer that keeps interrupting it
+const int kReadRetries = 1000;
+// How long the monitor waits for the engine to create the segment
+const int kMonitorWaitSeconds = 10;
+
+const char* const kEffectNames[kLiveStatsEffects] = {
+    "tremolo", "chorus", "blues", "overdrive", "compressor", "reverb", "warm", "wah"
+};
+
+double ToDb(float level) {
+    return 20.0 * log10(level > 1e-9f ? level : 1e-9f);
+}
+
+// "Local\name" on Windows (session namespace, no privilege needed),
+// "/name" for shm_open
+void SystemName(const char* name, char* out, size_t size) {
+#ifdef _WIN32
+    snprintf(out, size, "Local\\%s", name);
+#else
+    snprintf(out, size, "/%s", name);
+#endif
+}
+
+} // namespace
+
+StatsPublisher::StatsPublisher() : layout(nullptr), handle(nullptr) {
+    segmentName[0] = '\0';
+}
+
+StatsPublisher::~StatsPublisher() {
+    Close();
+}
+
+bool StatsPublisher::Open(const char* name) {
+    Close();
+    SystemName(name, segmentName, sizeof(segmentName));
+    const size_t bytes = sizeof(StatsSegmentLayout);
+    void* view = nullptr;
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)bytes, segmentName);
+    if (!mapping) return false;
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        // Another instance is publishing under this name
+        CloseHandle(mapping);
+        return false;
+    }
+    view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+    handle = mapping;
+#else
+    int fd = shm_open(segmentName, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, (off_t)bytes) != 0) {
+        close(fd);
+        return false;
+    }
+    view = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+#endif
+    // The header is written with the sequence odd, so a reader attaching
+    // now waits for the first complete snapshot
+    layout = (StatsSegmentLayout*)view;
+    layout->sequence.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memset(&layout->stats, 0, sizeof(layout->stats));
+    layout->magic = kLiveStatsMagic;
+    layout->version = kLiveStatsVersion;
+    layout->size = sizeof(LiveStats);
+    layout->sequence.store(2, std::memory_order_release);
+    return true;
+}
+
+void StatsPublisher::Close() {
+    if (!layout) return;
+#ifdef _WIN32
+    UnmapViewOfFile(layout);
+    CloseHandle((HANDLE)handle);
+#else
+    munmap(layout, sizeof(StatsSegmentLayout));
+    shm_unlink(segmentName);
+#endif
+    layout = nullptr;
+    handle = nullptr;
+}
+
+// Seqlock write: odd sequence, fence, data, then the next even sequence
+void StatsPublisher::Publish(const LiveStats& stats) {
+    if (!layout) return;
+    const uint32_t sequence = layout->sequence.load(std::memory_order_relaxed);
+    layout->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&layout->stats, &stats, sizeof(stats));
+    layout->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+StatsReader::StatsReader() : layout(nullptr), handle(nullptr) {
+}
+
+StatsReader::~StatsReader() {
+    Close();
+}
+
+bool StatsReader::Open(const char* name) {
+    Close();
+    char systemName[64];
+    SystemName(name, systemName, sizeof(systemName));
+    const size_t bytes = sizeof(StatsSegmentLayout);
+    void* view = nullptr;
+#ifdef _WIN32
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, systemName);
+    if (!mapping) return false;
+    view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, bytes);
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+    handle = mapping;
+#else
+    int fd = shm_open(systemName, O_RDONLY, 0);
+    if (fd < 0) return false;
+    view = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+#endif
+    layout = (const StatsSegmentLayout*)view;
+    return true;
+}
+
+void StatsReader::Close() {
+    if (!layout) return;
+#ifdef _WIN32
+    UnmapViewOfFile(layout);
+    CloseHandle((HANDLE)handle);
+#else
+    munmap((void*)layout, sizeof(StatsSegmentLayout));
+#endif
+    layout = nullptr;
+    handle = nullptr;
+}
+
+bool StatsReader::Read(LiveStats& out) const {
+    if (!layout) return false;
+    for (int attempt = 0; attempt < kReadRetries; ++attempt) {
+        if (attempt > 0) std::this_thread::yield();
+        const uint32_t before = layout->sequence.load(std::memory_order_acquire);
+        if (before & 1) continue;
+        if (layout->magic != kLiveStatsMagic || layout->version != kLiveStatsVersion ||
+            layout->size != sizeof(LiveStats)) {
+            return false;
+        }
+        memcpy(&out, &layout->stats, sizeof(out));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (layout->sequence.load(std::memory_order_relaxed) == before) return true;
+    }
+    return false;
+}
+
+int RunStatsMonitor(unsigned intervalMs, unsigned count) {
+    StatsReader reader;
+    for (int waited = 0; !reader.Open(kStatsSegmentName); ++waited) {
+        if (waited == kMonitorWaitSeconds) {
+            fprintf(stderr, "No stats segment '%s'; is the engine running?\n", kStatsSegmentName);
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    for (unsigned printed = 0; count == 0 || printed < count; ++printed) {
+        if (printed > 0) std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+        LiveStats stats;
+        if (!reader.Read(stats)) {
+            fprintf(stderr, "Stats segment unreadable (other version, or writer stuck)\n");
+            return 1;
+        }
+        printf("%s cpu %5.1f%% | misses %llu | xruns %llu | in %6.1f/%6.1f dBFS | out %6.1f/%6.1f dBFS"
+            " | latency %.1f ms | fifo %.0f/%.0f |",
+            stats.running ? "run " : "stop", stats.cpuLoad * 100.0,
+            (unsigned long long)stats.deadlineMisses, (unsigned long long)stats.xruns,
+            ToDb(stats.inputPeak), ToDb(stats.inputRms), ToDb(stats.outputPeak), ToDb(stats.outputRms),
+            stats.latencyMs, stats.fifoFillFrames, stats.fifoTargetFrames);
+        for (int i = 0; i < kLiveStatsEffects; ++i) {
+            if (stats.effectLoad[i] > 0.0) printf(" %s %.1f%%", kEffectNames[i], stats.effectLoad[i] * 100.0);
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include "EffectGraph.h"
+
+// Live engine statistics in a named shared-memory segment, so monitoring
+// tools can watch an unattended rig without the GUI. The audio thread
+// publishes a snapshot every few hundred milliseconds; readers in other
+// processes map the segment read-only and copy it out under a seqlock.
+//
+// The layout is an interface to other programs: fields are fixed-size,
+// and any change to LiveStats must bump kLiveStatsVersion.
+
+const char* const kStatsSegmentName = "GuitarEffectsStats";
+const uint32_t kLiveStatsMagic = 0x53584647;  // "GFXS"
+const uint32_t kLiveStatsVersion = 1;
+const int kLiveStatsEffects = 8;              // EffectId order
+// Fixed here because it is part of the layout; EffectChain::TakeEffectTimes
+// fills arrays of this size with EffectId::Count entries
+static_assert(kLiveStatsEffects == (int)EffectId::Count,
+    "a new effect changes the LiveStats layout: bump kLiveStatsVersion and kLiveStatsEffects");
+
+struct LiveStats {
+    uint64_t updates;           // snapshots published since the stream started
+    uint64_t timeNs;            // publisher's monotonic clock at publication
+    double sampleRate;
+    uint32_t channels;
+    uint32_t running;           // 1 while the audio loop runs
+    double cpuLoad;             // share of the last window spent processing packets
+    double effectLoad[kLiveStatsEffects];  // same, per effect
+    uint64_t deadlineMisses;    // packets that took longer to process than they last
+    uint64_t xruns;             // capture discontinuities, render starvation, bridge under/overruns
+    float inputPeak;            // linear full scale, over the last window
+    float inputRms;
+    float outputPeak;
+    float outputRms;
+    double latencyMs;           // expected input-to-output latency at stream start
+    double fifoFillFrames;      // drift bridge depth, or queued render frames when not bridged
+    double fifoTargetFrames;
+};
+
+// What the segment holds. sequence is odd while a snapshot is being written.
+struct StatsSegmentLayout {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;              // sizeof(LiveStats) the writer was built with
+    std::atomic<uint32_t> sequence;
+    LiveStats stats;
+};
+
+// Creates the segment (/dev/shm on Linux, a pagefile-backed file mapping on
+// Windows) and writes snapshots into it. Publish() is wait-free: fit for
+// the audio thread. Open() fails if the segment already exists, so a second
+// instance doesn't overwrite the first one's statistics (a crashed publisher
+// on Linux leaves /dev/shm/<name> behind, to be removed by hand).
+class StatsPublisher {
+public:
+    StatsPublisher();
+    ~StatsPublisher();
+
+    bool Open(const char* name);
+    void Close();
+    bool IsOpen() const { return layout != nullptr; }
+
+    void Publish(const LiveStats& stats);
+
+private:
+    StatsPublisher(const StatsPublisher&) = delete;
+    StatsPublisher& operator=(const StatsPublisher&) = delete;
+
+    StatsSegmentLayout* layout;
+    void* handle;
+    char segmentName[64];
+};
+
+// Maps an existing segment. Read() retries while a snapshot is being
+// written and fails on a version or size mismatch.
+class StatsReader {
+public:
+    StatsReader();
+    ~StatsReader();
+
+    bool Open(const char* name);
+    void Close();
+    bool Read(LiveStats& out) const;
+
+private:
+    StatsReader(const StatsReader&) = delete;
+    StatsReader& operator=(const StatsReader&) = delete;
+
+    const StatsSegmentLayout* layout;
+    void* handle;
+};
+
+// Reader CLI: prints the segment every intervalMs, count times (0: until
+// the process is killed). Returns nonzero if the segment never showed up.
+int RunStatsMonitor(unsigned intervalMs, unsigned count);
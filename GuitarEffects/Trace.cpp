@@ -0,0 +1,182 @@
+#include "Trace.h"
+#include "RealtimeThread.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    uint64_t startNs;
+    uint64_t durationNs;
+    int64_t arg;
+    char phase;  // 'X' complete, 'i' instant
+};
+
+// One per thread that traced. Rings are never freed: a thread that exits
+// hands its ring to the next thread registering under the same name, so
+// restarting the audio thread doesn't grow the list. Unnamed rings go to any
+// later unnamed thread, history cleared, so short-lived pool workers reuse
+// the rings of the ones before them.
+struct ThreadTrace {
+    const char* name;
+    uint32_t threadId;
+    bool inUse;                      // guarded by registryMutex
+    std::atomic<uint64_t> written;   // events ever recorded; the writer's index
+    TraceEvent events[kTraceEventsPerThread];
+    ThreadTrace* next;
+};
+
+std::mutex registryMutex;
+ThreadTrace* registry = nullptr;
+std::atomic<bool> traceEnabled(true);
+
+const std::chrono::steady_clock::time_point traceOrigin = std::chrono::steady_clock::now();
+
+uint32_t CurrentThreadId() {
+#ifdef _WIN32
+    return GetCurrentThreadId();
+#else
+    return (uint32_t)(uintptr_t)pthread_self();
+#endif
+}
+
+ThreadTrace* Acquire(const char* name) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    ThreadTrace* trace = nullptr;
+    for (ThreadTrace* t = registry; t; t = t->next) {
+        if (t->inUse) continue;
+        if (name && t->name && strcmp(t->name, name) == 0) {
+            trace = t;
+            break;
+        }
+        if (!name && !t->name) {
+            // Another thread's events; they'd show under this one's id
+            t->written.store(0, std::memory_order_relaxed);
+            trace = t;
+            break;
+        }
+    }
+    if (!trace) {
+        trace = new ThreadTrace();
+        trace->written.store(0, std::memory_order_relaxed);
+        PrefaultAndLock(trace, sizeof(ThreadTrace));
+        trace->next = registry;
+        registry = trace;
+    }
+    trace->name = name;
+    trace->threadId = CurrentThreadId();
+    trace->inUse = true;
+    return trace;
+}
+
+// Gives the ring back when the thread exits
+struct ThreadSlot {
+    ThreadTrace* trace = nullptr;
+    ~ThreadSlot() {
+        if (!trace) return;
+        std::lock_guard<std::mutex> lock(registryMutex);
+        trace->inUse = false;
+    }
+};
+
+thread_local ThreadSlot threadSlot;
+
+void Record(const char* name, uint64_t startNs, uint64_t durationNs, int64_t arg, char phase) {
+    if (!traceEnabled.load(std::memory_order_relaxed)) return;
+    ThreadTrace* trace = threadSlot.trace;
+    if (!trace) trace = threadSlot.trace = Acquire(nullptr);
+    const uint64_t index = trace->written.load(std::memory_order_relaxed);
+    // Pairs with the acquire fence in WriteChromeTrace: a dump that copies
+    // any of this event then also sees written at index, so it drops the
+    // event being overwritten (index - kTraceEventsPerThread)
+    std::atomic_thread_fence(std::memory_order_release);
+    TraceEvent& event = trace->events[index & (kTraceEventsPerThread - 1)];
+    event.name = name;
+    event.startNs = startNs;
+    event.durationNs = durationNs;
+    event.arg = arg;
+    event.phase = phase;
+    trace->written.store(index + 1, std::memory_order_release);
+}
+
+} // namespace
+
+void TraceRegisterThread(const char* name) {
+    if (threadSlot.trace) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        threadSlot.trace->name = name;
+        return;
+    }
+    threadSlot.trace = Acquire(name);
+}
+
+void SetTraceEnabled(bool enabled) {
+    traceEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool IsTraceEnabled() {
+    return traceEnabled.load(std::memory_order_relaxed);
+}
+
+uint64_t TraceNowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - traceOrigin).count();
+}
+
+void TraceComplete(const char* name, uint64_t startNs, uint64_t endNs, int64_t arg) {
+    Record(name, startNs, endNs - startNs, arg, 'X');
+}
+
+void TraceInstant(const char* name, int64_t arg) {
+    Record(name, TraceNowNs(), 0, arg, 'i');
+}
+
+bool WriteChromeTrace(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) return false;
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+    bool first = true;
+    std::vector<TraceEvent> copy(kTraceEventsPerThread);
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (ThreadTrace* t = registry; t; t = t->next) {
+        fprintf(file, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",\n", t->threadId, t->name ? t->name : "thread");
+        first = false;
+
+        // Copy, then keep only what the writer can't have touched meanwhile:
+        // while recording event w it overwrites event w - kTraceEventsPerThread
+        const uint64_t end = t->written.load(std::memory_order_acquire);
+        const uint64_t begin = (end > kTraceEventsPerThread) ? end - kTraceEventsPerThread : 0;
+        for (uint64_t i = begin; i < end; ++i) {
+            copy[i - begin] = t->events[i & (kTraceEventsPerThread - 1)];
+        }
+        // Keeps the re-read of written after the copy (see Record)
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t now = t->written.load(std::memory_order_relaxed);
+        const uint64_t safe = (now >= kTraceEventsPerThread) ? now - kTraceEventsPerThread + 1 : 0;
+        for (uint64_t i = std::max(begin, safe); i < end; ++i) {
+            const TraceEvent& e = copy[i - begin];
+            if (e.phase == 'X') {
+                fprintf(file, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"name\":\"%s\",\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"v\":%lld}}",
+                    t->threadId, e.name, e.startNs / 1000.0, e.durationNs / 1000.0, (long long)e.arg);
+            }
+            else {
+                fprintf(file, ",\n{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"name\":\"%s\",\"ts\":%.3f,\"args\":{\"v\":%lld}}",
+                    t->threadId, e.name, e.startNs / 1000.0, (long long)e.arg);
+            }
+        }
+    }
+    fputs("\n]}\n", file);
+    return fclose(file) == 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Flight recorder of what each thread was doing, for looking at glitches
+// after the fact in chrome://tracing or ui.perfetto.dev.
+//
+// Each thread writes its own fixed ring (the last kTraceEventsPerThread
+// events), so recording is a clock read and a few stores, with no locks
+// or shared cache lines between threads. Cheap enough to stay on in release
+// builds; define TRACE_DISABLED to compile the trace points out, or switch
+// recording off at run time with SetTraceEnabled(false).
+//
+// Names must be string literals (or otherwise outlive the process).
+
+const uint32_t kTraceEventsPerThread = 16384;  // power of two
+
+// Names the calling thread in the dump and sets up its ring. Call once at
+// the top of a thread; an unregistered thread gets a ring on its first
+// trace point, named by its id: one an exited unregistered thread left, or
+// a newly allocated one.
+void TraceRegisterThread(const char* name);
+
+void SetTraceEnabled(bool enabled);
+bool IsTraceEnabled();
+
+// Writes every thread's ring as Chrome trace event JSON (which Perfetto
+// opens as well). Safe while the threads keep tracing; events overwritten
+// during the copy are left out. Returns false if the file couldn't be written.
+bool WriteChromeTrace(const char* path);
+
+// Recording, used through the macros below
+uint64_t TraceNowNs();
+void TraceComplete(const char* name, uint64_t startNs, uint64_t endNs, int64_t arg);
+void TraceInstant(const char* name, int64_t arg);
+
+// Times its enclosing scope as one complete ("X") event
+class TraceScope {
+public:
+    explicit TraceScope(const char* eventName, int64_t eventArg = 0) :
+        name(eventName), arg(eventArg), start(TraceNowNs()) {}
+    ~TraceScope() { TraceComplete(name, start, TraceNowNs(), arg); }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    int64_t arg;
+    uint64_t start;
+};
+
+#ifndef TRACE_DISABLED
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(...) TraceScope TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)
+#define TRACE_INSTANT(name, arg) TraceInstant(name, arg)
+#else
+#define TRACE_SCOPE(...) ((void)0)
+#define TRACE_INSTANT(name, arg) ((void)0)
+#endif
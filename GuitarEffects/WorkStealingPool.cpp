@@ -0,0 +1,83 @@
+#include "WorkStealingPool.h"
+
+namespace {
+
+// Which pool worker the calling thread is, if any
+thread_local const WorkStealingPool* currentPool = nullptr;
+thread_local int currentWorker = -1;
+
+} // namespace
+
+WorkStealingPool::WorkStealingPool(int threads) : nextQueue(0), queued(0), unfinished(0), stopping(false) {
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+    for (int i = 0; i < threads; ++i) queues.emplace_back(new Queue());
+    for (int i = 0; i < threads; ++i) workers.emplace_back(&WorkStealingPool::Run, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    Wait();
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+void WorkStealingPool::Submit(Task task) {
+    const int own = (currentPool == this) ? currentWorker : -1;
+    const int index = (own >= 0) ? own : (int)(nextQueue++ % queues.size());
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        ++unfinished;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    {
+        // Counted under stateMutex so a worker can't check, miss it and sleep
+        std::lock_guard<std::mutex> lock(stateMutex);
+        ++queued;
+    }
+    taskReady.notify_one();
+}
+
+void WorkStealingPool::Wait() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    allDone.wait(lock, [this] { return unfinished == 0; });
+}
+
+// Own deque first, then the others in turn
+bool WorkStealingPool::TakeTask(int worker, Task& task) {
+    const int count = (int)queues.size();
+    for (int i = 0; i < count; ++i) {
+        const int index = (worker + i) % count;
+        Queue& queue = *queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        --queued;
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::Run(int worker) {
+    currentPool = this;
+    currentWorker = worker;
+    for (;;) {
+        Task task;
+        if (!TakeTask(worker, task)) {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            taskReady.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping && queued == 0) return;
+            continue;
+        }
+        task(worker);
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (--unfinished == 0) allDone.notify_all();
+    }
+}
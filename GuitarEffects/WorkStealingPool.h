@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Thread pool for the offline renderers. Each worker has its own task
+// deque and, when it runs dry, steals from the others. Every deque is
+// served oldest first, so tasks start roughly in submission order and a
+// caller can submit the longest ones first. Tasks are coarse (a file, a
+// segment, a preset variation), so a mutex per deque is plenty.
+//
+// A task gets the index of the worker running it, for per-worker state
+// such as one EffectEngine per worker.
+class WorkStealingPool {
+public:
+    typedef std::function<void(int worker)> Task;
+
+    // threads 0: one per hardware thread
+    explicit WorkStealingPool(int threads = 0);
+    ~WorkStealingPool();
+
+    int Threads() const { return (int)workers.size(); }
+
+    // From outside the pool tasks are dealt round-robin; a task that submits
+    // more puts them on its own worker's deque
+    void Submit(Task task);
+    // Returns once every submitted task has finished
+    void Wait();
+
+private:
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool TakeTask(int worker, Task& task);
+    void Run(int worker);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<unsigned> nextQueue;
+    std::atomic<size_t> queued;     // submitted, not yet taken
+    size_t unfinished;              // submitted, not yet done; guarded by stateMutex
+    bool stopping;
+    std::mutex stateMutex;
+    std::condition_variable taskReady;
+    std::condition_variable allDone;
+};
@@ -8,7 +8,10 @@
 #include <atomic>
 #include <iostream>
 #include <sstream>
+#include <cstring>
 #include "AudioProcessor.h"
+#include "Logger.h"
+#include "Trace.h"
 #include <Xinput.h>
 #pragma comment(lib, "Xinput9_1_0.lib")
 #pragma comment(lib, "comctl32.lib")
@@ -17,13 +20,14 @@
 // Effect/action names for keybinds (toggles and special actions only)
 const char* actions[] = {
     "Tremolo Toggle", "Chorus Toggle", "Overdrive Toggle", "Reverb Toggle",
-    "Warm Toggle", "Blues Toggle", "Wah Toggle", "Compressor Toggle", "Reset All"
+    "Warm Toggle", "Blues Toggle", "Wah Toggle", "Compressor Toggle", "Reset All",
+    "Store Preset", "Next Preset"
 };
 const int NUM_ACTIONS = sizeof(actions) / sizeof(actions[0]);
 
 // Default key bindings (VK_*)
 int defaultKeys[NUM_ACTIONS] = {
-    'T', 'C', 'O', 'V', 'W', 'B', 'Y', 'P', 'R'
+    'T', 'C', 'O', 'V', 'W', 'B', 'Y', 'P', 'R', 'S', 'N'
 };
 
 // XInput button definitions
@@ -94,6 +98,13 @@ float currentWahMix = 1.0f;
 float currentWahLFORate = 0.0f;
 float currentWahLFODepth = 0.0f;
 
+// Preset slots: "Store Preset" fills them in turn, "Next Preset" cycles through the stored ones
+const int NUM_PRESET_SLOTS = 4;
+EffectParams presetSlots[NUM_PRESET_SLOTS];
+bool presetStored[NUM_PRESET_SLOTS] = {};
+int nextStoreSlot = 0;
+int currentPresetSlot = -1;
+
 // Slider IDs
 enum {
     SLIDER_TREMOLO_RATE = 3000,
@@ -147,6 +158,81 @@ HWND createSlider(HWND parent, int id, int x, int y, int min, int max, int pos)
     return h;
 }
 
+// Move all sliders to the current* values
+void syncSliders(HWND hwnd) {
+    SendMessageW(GetDlgItem(hwnd, SLIDER_TREMOLO_RATE), TBM_SETPOS, TRUE, (int)(currentRate));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_TREMOLO_DEPTH), TBM_SETPOS, TRUE, (int)(currentDepth * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_CHORUS_RATE), TBM_SETPOS, TRUE, (int)(currentChorusRate * 10));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_CHORUS_DEPTH), TBM_SETPOS, TRUE, (int)(currentChorusDepth * 1000));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_CHORUS_FEEDBACK), TBM_SETPOS, TRUE, (int)(currentChorusFeedback * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_CHORUS_WIDTH), TBM_SETPOS, TRUE, (int)(currentChorusWidth * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_MAIN_VOLUME), TBM_SETPOS, TRUE, (int)(currentMainVolume * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_OVERDRIVE_DRIVE), TBM_SETPOS, TRUE, (int)(currentOverdriveDrive));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_OVERDRIVE_THRESHOLD), TBM_SETPOS, TRUE, (int)(currentOverdriveThreshold * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_OVERDRIVE_TONE), TBM_SETPOS, TRUE, (int)(currentOverdriveTone * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_OVERDRIVE_MIX), TBM_SETPOS, TRUE, (int)(currentOverdriveMix * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_REVERB_SIZE), TBM_SETPOS, TRUE, (int)(currentReverbSize * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_REVERB_DAMPING), TBM_SETPOS, TRUE, (int)(currentReverbDamping * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_REVERB_WIDTH), TBM_SETPOS, TRUE, (int)(currentReverbWidth * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_REVERB_MIX), TBM_SETPOS, TRUE, (int)(currentReverbMix * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_WARM_AMOUNT), TBM_SETPOS, TRUE, (int)(currentWarmAmount * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_WARM_TONE), TBM_SETPOS, TRUE, (int)(currentWarmTone * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_WARM_SATURATION), TBM_SETPOS, TRUE, (int)(currentWarmSaturation * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_BLUES_GAIN), TBM_SETPOS, TRUE, (int)(currentBluesGain));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_BLUES_TONE), TBM_SETPOS, TRUE, (int)(currentBluesTone * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_BLUES_LEVEL), TBM_SETPOS, TRUE, (int)(currentBluesLevel * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_COMP_LEVEL), TBM_SETPOS, TRUE, (int)(currentCompLevel * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_COMP_TONE), TBM_SETPOS, TRUE, (int)(currentCompTone * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_COMP_ATTACK), TBM_SETPOS, TRUE, (int)(currentCompAttack));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_COMP_SUSTAIN), TBM_SETPOS, TRUE, (int)(currentCompSustain));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_WAH_FREQUENCY), TBM_SETPOS, TRUE, (int)(currentWahFrequency));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_WAH_RESONANCE), TBM_SETPOS, TRUE, (int)(currentWahResonance));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_WAH_MIX), TBM_SETPOS, TRUE, (int)(currentWahMix * 100));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_WAH_LFO_RATE), TBM_SETPOS, TRUE, (int)(currentWahLFORate));
+    SendMessageW(GetDlgItem(hwnd, SLIDER_WAH_LFO_DEPTH), TBM_SETPOS, TRUE, (int)(currentWahLFODepth * 100));
+}
+
+// Mirror a preset in the toggle and slider state
+void loadPresetState(const EffectParams& p) {
+    tremoloState = p.tremoloEnabled;
+    chorusState = p.chorusEnabled;
+    overdriveState = p.overdriveEnabled;
+    reverbState = p.reverbEnabled;
+    warmState = p.warmEnabled;
+    bluesState = p.bluesEnabled;
+    compState = p.compEnabled;
+    wahState = p.wahEnabled;
+    currentRate = p.tremoloRate;
+    currentDepth = p.tremoloDepth;
+    currentChorusRate = p.chorusRate;
+    currentChorusDepth = p.chorusDepth;
+    currentChorusFeedback = p.chorusFeedback;
+    currentChorusWidth = p.chorusWidth;
+    currentOverdriveDrive = p.overdriveDrive;
+    currentOverdriveThreshold = p.overdriveThreshold;
+    currentOverdriveTone = p.overdriveTone;
+    currentOverdriveMix = p.overdriveMix;
+    currentReverbSize = p.reverbSize;
+    currentReverbDamping = p.reverbDamping;
+    currentReverbWidth = p.reverbWidth;
+    currentReverbMix = p.reverbMix;
+    currentWarmAmount = p.warmAmount;
+    currentWarmTone = p.warmTone;
+    currentWarmSaturation = p.warmSaturation;
+    currentBluesGain = p.bluesGain;
+    currentBluesTone = p.bluesTone;
+    currentBluesLevel = p.bluesLevel;
+    currentCompLevel = p.compLevel;
+    currentCompTone = p.compTone;
+    currentCompAttack = p.compAttackMs;
+    currentCompSustain = p.compSustainMs;
+    currentWahFrequency = p.wahFreq;
+    currentWahResonance = p.wahQ;
+    currentWahMix = p.wahMix;
+    currentWahLFORate = p.wahLfoRate;
+    currentWahLFODepth = p.wahLfoDepth;
+}
+
 // Change handleAction to accept HWND hwnd
 void handleAction(int action, HWND hwnd = nullptr) {
     switch (action) {
@@ -190,6 +276,8 @@ void handleAction(int action, HWND hwnd = nullptr) {
         reverbState = false;
         warmState = false;
         bluesState = false;
+        compState = false;
+        wahState = false;
         currentRate = 5.0f;
         currentDepth = 0.5f;
         currentChorusRate = 1.5f;
@@ -221,37 +309,24 @@ void handleAction(int action, HWND hwnd = nullptr) {
         currentWahLFORate = 0.0f;
         currentWahLFODepth = 0.0f;
         // Update all sliders to reflect reset values if hwnd is provided
-        if (hwnd) {
-            SendMessageW(GetDlgItem(hwnd, SLIDER_TREMOLO_RATE), TBM_SETPOS, TRUE, (int)(currentRate));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_TREMOLO_DEPTH), TBM_SETPOS, TRUE, (int)(currentDepth * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_CHORUS_RATE), TBM_SETPOS, TRUE, (int)(currentChorusRate * 10));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_CHORUS_DEPTH), TBM_SETPOS, TRUE, (int)(currentChorusDepth * 1000));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_CHORUS_FEEDBACK), TBM_SETPOS, TRUE, (int)(currentChorusFeedback * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_CHORUS_WIDTH), TBM_SETPOS, TRUE, (int)(currentChorusWidth * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_MAIN_VOLUME), TBM_SETPOS, TRUE, (int)(currentMainVolume * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_OVERDRIVE_DRIVE), TBM_SETPOS, TRUE, (int)(currentOverdriveDrive));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_OVERDRIVE_THRESHOLD), TBM_SETPOS, TRUE, (int)(currentOverdriveThreshold * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_OVERDRIVE_TONE), TBM_SETPOS, TRUE, (int)(currentOverdriveTone * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_OVERDRIVE_MIX), TBM_SETPOS, TRUE, (int)(currentOverdriveMix * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_REVERB_SIZE), TBM_SETPOS, TRUE, (int)(currentReverbSize * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_REVERB_DAMPING), TBM_SETPOS, TRUE, (int)(currentReverbDamping * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_REVERB_WIDTH), TBM_SETPOS, TRUE, (int)(currentReverbWidth * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_REVERB_MIX), TBM_SETPOS, TRUE, (int)(currentReverbMix * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_WARM_AMOUNT), TBM_SETPOS, TRUE, (int)(currentWarmAmount * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_WARM_TONE), TBM_SETPOS, TRUE, (int)(currentWarmTone * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_WARM_SATURATION), TBM_SETPOS, TRUE, (int)(currentWarmSaturation * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_BLUES_GAIN), TBM_SETPOS, TRUE, (int)(currentBluesGain));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_BLUES_TONE), TBM_SETPOS, TRUE, (int)(currentBluesTone * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_BLUES_LEVEL), TBM_SETPOS, TRUE, (int)(currentBluesLevel * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_COMP_LEVEL), TBM_SETPOS, TRUE, (int)(currentCompLevel * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_COMP_TONE), TBM_SETPOS, TRUE, (int)(currentCompTone * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_COMP_ATTACK), TBM_SETPOS, TRUE, (int)(currentCompAttack));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_COMP_SUSTAIN), TBM_SETPOS, TRUE, (int)(currentCompSustain));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_WAH_FREQUENCY), TBM_SETPOS, TRUE, (int)(currentWahFrequency));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_WAH_RESONANCE), TBM_SETPOS, TRUE, (int)(currentWahResonance));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_WAH_MIX), TBM_SETPOS, TRUE, (int)(currentWahMix * 100));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_WAH_LFO_RATE), TBM_SETPOS, TRUE, (int)(currentWahLFORate));
-            SendMessageW(GetDlgItem(hwnd, SLIDER_WAH_LFO_DEPTH), TBM_SETPOS, TRUE, (int)(currentWahLFODepth * 100));
+        if (hwnd) syncSliders(hwnd);
+        break;
+    case 9: // Store Preset
+        presetSlots[nextStoreSlot] = processor->CapturePreset();
+        presetStored[nextStoreSlot] = true;
+        currentPresetSlot = nextStoreSlot;
+        nextStoreSlot = (nextStoreSlot + 1) % NUM_PRESET_SLOTS;
+        break;
+    case 10: // Next Preset
+        for (int i = 1; i <= NUM_PRESET_SLOTS; ++i) {
+            int slot = (currentPresetSlot + i + NUM_PRESET_SLOTS) % NUM_PRESET_SLOTS;
+            if (presetStored[slot]) {
+                currentPresetSlot = slot;
+                processor->ApplyPreset(presetSlots[slot]);
+                loadPresetState(presetSlots[slot]);
+                if (hwnd) syncSliders(hwnd);
+                break;
+            }
         }
         break;
     }
@@ -517,6 +592,13 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     }
 
     case WM_KEYDOWN: {
+        if (wParam == VK_F12) {
+            // Snapshot of what every thread did lately, for chrome://tracing or Perfetto
+            if (!WriteChromeTrace("GuitarEffects.trace.json")) {
+                MessageBoxW(hwnd, L"Failed to write GuitarEffects.trace.json", L"Error", MB_OK);
+            }
+            return 0;
+        }
         // Handle direct keyboard input for actions (when not rebinding)
         if (rebindingAction < 0) {
             for (int i = 0; i < NUM_ACTIONS; ++i) {
@@ -840,9 +922,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                     static ULONGLONG lastRebindDebug = 0;
                     ULONGLONG currentTime = GetTickCount64();
                     if (currentTime - lastRebindDebug > 500) {
-                        wchar_t debug[100];
-                        swprintf(debug, 100, L"Rebinding %d: Controller %d buttons=0x%04X", rebindingAction, controllerId, state.Gamepad.wButtons);
-                        OutputDebugStringW(debug);
+                        LOG_DEBUG(LogEvent::InputRebindState, rebindingAction, controllerId, state.Gamepad.wButtons);
                         lastRebindDebug = currentTime;
                     }
 
@@ -850,10 +930,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                     WORD pressed = changed & state.Gamepad.wButtons;
 
                     if (pressed) {
-                        wchar_t debug[100];
-                        ULONGLONG now = GetTickCount64();
-                        swprintf(debug, 100, L"Button pressed during rebind: 0x%04X", pressed);
-                        OutputDebugStringW(debug);
+                        LOG_DEBUG(LogEvent::InputRebindPressed, pressed);
 
                         // Find the first pressed button and store its mask
                         WORD buttonMask = 0;
@@ -865,10 +942,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                         }
 
                         if (buttonMask) {
-                            wchar_t debug2[100];
-                            ULONGLONG now2 = GetTickCount64();
-                            swprintf(debug2, 100, L"Storing button mask: 0x%04X for action %d", buttonMask, rebindingAction);
-                            OutputDebugStringW(debug2);
+                            LOG_DEBUG(LogEvent::InputRebindStored, buttonMask, rebindingAction);
 
                             keyBindings[rebindingAction] = { InputType::Joystick, (int)buttonMask };
                             SetWindowTextW(editBoxes[rebindingAction], bindingToString(keyBindings[rebindingAction]).c_str());
@@ -892,6 +966,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         }
         else if (wParam == 2) {
             // Continuous joystick polling for actions
+            TRACE_SCOPE("InputPoll");
             static bool debugOnce = false;
 
             // Check multiple controllers (0-3)
@@ -901,9 +976,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 
                 if (XInputGetState(controllerId, &state) == ERROR_SUCCESS) {
                     if (!debugOnce) {
-                        wchar_t debug[100];
-                        swprintf(debug, 100, L"Controller %d connected, buttons: 0x%04X", controllerId, state.Gamepad.wButtons);
-                        OutputDebugStringW(debug);
+                        LOG_INFO(LogEvent::InputControllerConnected, controllerId, state.Gamepad.wButtons);
                         debugOnce = true;
                     }
 
@@ -917,19 +990,14 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                             static ULONGLONG lastDebugTime = 0;
                             ULONGLONG currentTime = GetTickCount64();
                             if (currentTime - lastDebugTime > 1000) { // Debug every second
-                                wchar_t debug[150];
-                                swprintf(debug, 150, L"Action %d: mask=0x%04X, current=0x%04X, pressed=%d, actionPressed=%d",
-                                    i, buttonMask, state.Gamepad.wButtons, currentlyPressed ? 1 : 0, g_actionPressed[i] ? 1 : 0);
-                                OutputDebugStringW(debug);
+                                LOG_DEBUG(LogEvent::InputActionState, i, buttonMask, state.Gamepad.wButtons,
+                                    currentlyPressed ? 1 : 0, g_actionPressed[i] ? 1 : 0);
                                 lastDebugTime = currentTime;
                             }
 
                             // Only trigger on button press (not held)
                             if (currentlyPressed && !g_actionPressed[i]) {
-                                // Debug output
-                                wchar_t debug[100];
-                                swprintf(debug, 100, L"Triggered action %d with button mask 0x%04X", i, buttonMask);
-                                OutputDebugStringW(debug);
+                                LOG_DEBUG(LogEvent::InputActionTriggered, i, buttonMask);
 
                                 handleAction(i, hwnd);
                                 g_actionPressed[i] = true;
@@ -967,13 +1035,15 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     return 0;
 }
 
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int nCmdShow) {
     // Initialize common controls (must be done before creating combobox)
     INITCOMMONCONTROLSEX icex;
     icex.dwSize = sizeof(icex);
     icex.dwICC = ICC_STANDARD_CLASSES | ICC_WIN95_CLASSES;
     InitCommonControlsEx(&icex);
 
+    Logger::Get().Start();
+    TraceRegisterThread("GUI");
     processor = new AudioProcessor();
     if (FAILED(processor->Initialize())) {
         MessageBoxW(NULL, L"Failed to initialize audio processor", L"Error", MB_OK);
@@ -984,6 +1054,11 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
         MessageBoxW(NULL, L"No audio capture devices found", L"Error", MB_OK);
         return 1;
     }
+    // "--record <file>": capture the session for offline replay
+    const char* recordOption = "--record ";
+    if (lpCmdLine && strncmp(lpCmdLine, recordOption, strlen(recordOption)) == 0) {
+        processor->SetSessionRecording(lpCmdLine + strlen(recordOption));
+    }
     processor->StartProcessing(devices[0].id);
 
     WNDCLASSW wc = { 0 };
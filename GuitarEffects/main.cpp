@@ -1,13 +1,87 @@
-﻿#include "AudioProcessor.h"
-#include <iostream>
+﻿#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#ifdef _WIN32
 #include <conio.h>
+#include "AudioProcessor.h"
+#endif
+#include "Benchmark.h"
+#include "Simulation.h"
+#include "Regression.h"
+#include "Logger.h"
+#include "Trace.h"
+#include "StatsSegment.h"
+#include "SessionRecording.h"
+#include "Offline.h"
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return RunBenchmarks();
+    }
+    if (argc > 1 && strcmp(argv[1], "--simulate-drift") == 0) {
+        double ppm = (argc > 2) ? atof(argv[2]) : 300.0;
+        double seconds = (argc > 3) ? atof(argv[3]) : 120.0;
+        return RunDriftSimulation(ppm, seconds);
+    }
+    if (argc > 1 && strcmp(argv[1], "--simulate-latency") == 0) {
+        unsigned deviceFrames = (argc > 2) ? (unsigned)atoi(argv[2]) : 1440;
+        unsigned blockSize = (argc > 3) ? (unsigned)atoi(argv[3]) : 64;
+        return RunLatencySimulation(deviceFrames, blockSize);
+    }
+    if (argc > 1 && strcmp(argv[1], "--golden") == 0) {
+        const char* directory = (argc > 2) ? argv[2] : "golden";
+        bool update = argc > 3 && strcmp(argv[3], "--update") == 0;
+        return RunGoldenRegression(directory, update);
+    }
+    if (argc > 1 && strcmp(argv[1], "--check-chunking") == 0) {
+        return RunChunkingCheck();
+    }
+    if (argc > 1 && strcmp(argv[1], "--stats") == 0) {
+        // Monitor of a running instance, through its shared-memory stats
+        unsigned intervalMs = (argc > 2) ? (unsigned)atoi(argv[2]) : 1000;
+        unsigned count = (argc > 3) ? (unsigned)atoi(argv[3]) : 0;
+        return RunStatsMonitor(intervalMs, count);
+    }
+    if (argc > 2 && strcmp(argv[1], "--replay") == 0) {
+        // Offline re-run of a session captured with --record
+        unsigned repeat = (argc > 3) ? (unsigned)atoi(argv[3]) : 1;
+        const char* outPath = (argc > 4) ? argv[4] : nullptr;
+        return RunSessionReplay(argv[2], repeat, outPath);
+    }
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0) {
+        // Re-amp WAV files through a preset on every core
+        return RunBatchCommand(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "--split") == 0) {
+        // One long file rendered in parallel segments
+        return RunSegmentCommand(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "--pipe") == 0) {
+        // Raw PCM from stdin to stdout, for sox/ffmpeg pipelines
+        return RunPipeCommand(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp(argv[1], "--sweep") == 0) {
+        // Every combination of a parameter grid, with a loudness summary
+        return RunSweepCommand(argc - 2, argv + 2);
+    }
+#ifndef _WIN32
+    // Live processing is WASAPI; elsewhere only the offline modes exist
+    fprintf(stderr, "Live processing needs Windows. Available here: --pipe, --batch, --sweep, --split, --replay, "
+        "--golden, --check-chunking, --bench, --simulate-drift, --simulate-latency, --stats\n");
+    return 2;
+#else
+    Logger::Get().Start();
+    TraceRegisterThread("Console");
     AudioProcessor processor;
     if (FAILED(processor.Initialize())) {
         std::cout << "Failed to initialize audio processor" << std::endl;
         return 1;
     }
+    if (argc > 2 && strcmp(argv[1], "--record") == 0) {
+        processor.SetSessionRecording(argv[2]);
+        std::cout << "Recording the session to " << argv[2] << " (replay with --replay)" << std::endl;
+    }
     std::cout << "Enumerating audio capture devices..." << std::endl << std::endl;
     std::vector<AudioDevice> devices = processor.EnumerateDevices();
     if (devices.empty()) {
@@ -27,7 +101,10 @@ int main() {
     std::cout << "Starting audio processing... Press 'q' to quit, 't' to toggle tremolo" << std::endl;
     std::cout << "Tremolo controls: '1' decrease rate, '2' increase rate, '3' decrease depth, '4' increase depth" << std::endl;
     std::cout << "Chorus controls: 'c' to toggle, '}'/'{' to decrease/increase rate, '/'/'?' to decrease/increase depth" << std::endl;
-    std::cout << "Press 'r' to reset all effects and looper to default." << std::endl;
+    std::cout << "Press 'r' to reset all effects and looper to default, 'd' for clock drift stats." << std::endl;
+    std::cout << "Press 'l' for the latency breakdown, 'm' to measure it (loop the output back into the input first)." << std::endl;
+    std::cout << "Press 'L' to cycle the target latency (3/5/10/20 ms); this restarts the audio streams." << std::endl;
+    std::cout << "Press 'T' to dump recent thread activity to GuitarEffects.trace.json (chrome://tracing, Perfetto)." << std::endl;
     processor.StartProcessing(devices[selection - 1].id);
     bool tremoloState = false;
     float currentRate = 5.0f;
@@ -45,9 +122,8 @@ int main() {
         char cmd = _getch();
         switch (cmd) {
         case 'q':
-            processor.Stop();
             std::cout << "Stopping..." << std::endl;
-            Sleep(1000);
+            processor.Stop();
             return 0;
         case 't':
             tremoloState = !tremoloState;
@@ -108,6 +184,57 @@ int main() {
             processor.SetMainVolume(currentMainVolume);
             std::cout << "\rMain volume: " << currentMainVolume << "      " << std::flush;
             break;
+        case 'd': {
+            DriftStats drift = processor.GetDriftStats();
+            std::cout << "\rBuffered: " << drift.bufferedFrames << "/" << drift.targetFrames
+                << " frames, ratio " << drift.ratioPpm << " ppm, underruns " << drift.underruns
+                << ", overruns " << drift.overruns << "      " << std::endl;
+            break;
+        }
+        case 'l': {
+            LatencyReport latency = processor.GetLatencyReport();
+            std::cout << "\rLatency: " << latency.totalMs << " ms (capture " << latency.captureMs
+                << ", effects " << latency.effectsMs << ", block " << latency.blockMs
+                << ", bridge " << latency.bridgeMs << ", render " << latency.renderMs << ")" << std::endl;
+            std::cout << "Target " << latency.requestedMs << " ms, render depth achieved "
+                << latency.depthMs << " ms" << std::endl;
+            break;
+        }
+        case 'L': {
+            const float targets[] = { 3.0f, 5.0f, 10.0f, 20.0f };
+            float next = targets[0];
+            for (float target : targets) {
+                if (target > processor.GetTargetLatencyMs()) {
+                    next = target;
+                    break;
+                }
+            }
+            processor.SetTargetLatencyMs(next);
+            processor.StartProcessing(devices[selection - 1].id);
+            LatencyReport latency = processor.GetLatencyReport();
+            std::cout << "Target latency " << next << " ms, render depth achieved " << latency.depthMs
+                << " ms, total " << latency.totalMs << " ms" << std::endl;
+            break;
+        }
+        case 'm': {
+            std::cout << "Measuring round-trip latency..." << std::endl;
+            LatencyMeasurement measured = processor.MeasureLatency();
+            if (measured.valid) {
+                std::cout << "Measured: " << measured.ms << " ms (" << measured.frames << " frames)" << std::endl;
+            }
+            else {
+                std::cout << "No clear return signal; is the output looped back into the input?" << std::endl;
+            }
+            break;
+        }
+        case 'T':
+            if (WriteChromeTrace("GuitarEffects.trace.json")) {
+                std::cout << "Trace written to GuitarEffects.trace.json" << std::endl;
+            }
+            else {
+                std::cout << "Failed to write GuitarEffects.trace.json" << std::endl;
+            }
+            break;
         case 'r':
             processor.Reset();
             tremoloState = false;
@@ -121,4 +248,5 @@ int main() {
         }
     }
     return 0;
+#endif
 }
\ No newline at end of file